@@ -296,8 +296,7 @@ typedef enum {
 
 	// allow multiline strings using escaped newlines
 	// example
-	// "property": "this is a multiline \
-	// string"
+	// "property": "this is a multiline \<newline>string"
 	JSON_READER_ESCAPED_MULTILINE_STRINGS = ( 1 << 8 ),
 
 	// allow c++0x style raw string literals
@@ -0,0 +1,349 @@
+// asynchronous asset loading
+// requests are queued as background jobs of the JobSystem, file reads, json parsing, image
+// decoding and voxel meshing run on worker threads into memory owned by the request
+// finished requests are pushed into a completion queue that the main thread processes at the
+// beginning of every frame, that's where textures and meshes are uploaded and the results are
+// copied into the allocator that was passed when requesting
+// the platform services that jobs use (readFileToBuffer, loadImageToMemory) need to be thread safe
+// jobs live in game memory and run game code, the platform layer calls waitForBackgroundJobs
+// before it unloads the game dll or restores game memory, results that weren't processed yet
+// are picked up by processAssetCompletions of the reloaded dll
+// requests need to be made on the main thread
+// usage:
+//     requestTileSet( loader, allocator, "Data/voxels/default_tileset.json", &tileSet );
+//     requestTexture( loader, "Data/Images/particles.png", &texture );
+//     waitForAssets( loader );  // or keep going, results arrive in processAssetCompletions
+
+#define MAX_ASSET_REQUESTS ( 32 )
+
+enum class AssetType : int8 { Texture, VoxelCollection, TileSet };
+
+struct AssetRequest {
+	AssetType type;
+	bool used;
+	bool success;  // written by the job
+	FilenameString filename;
+	StackAllocator* target;  // allocator of the requester, results are copied into it
+	void* out;               // TextureId, VoxelCollection or TileSet depending on type
+
+	StackAllocator allocator;  // results of the job, reserved the first time the slot is used
+	Job job;
+	JobCounter counter;
+
+	// results
+	ImageData image;
+	StringView textureFilename;
+	VoxelCollection voxels;
+	Array< Mesh > meshes;
+};
+
+struct AssetLoader {
+	PlatformServices* platform;
+	size_t reserveSize;  // address space reserved for every request
+	int32 pendingCount;  // requests that weren't processed by processAssetCompletions yet
+	AssetRequest requests[MAX_ASSET_REQUESTS];
+
+	// indices + 1 of completed requests, 0 if the entry is empty
+	// every request completes once and a request is only reused after its completion was
+	// processed, so writers can never overtake the reader
+	std::atomic< int32 > completions[MAX_ASSET_REQUESTS];
+	std::atomic< int32 > completionsWrite;
+	int32 completionsRead;
+};
+
+// platform needs to outlive the loader, memory of requests is reserved lazily
+void initAssetLoader( AssetLoader* loader, PlatformServices* platform, size_t reserveSize )
+{
+	assert( loader );
+	assert( platform );
+	loader->platform     = platform;
+	loader->reserveSize  = reserveSize;
+	loader->pendingCount = 0;
+	for( auto& request : loader->requests ) {
+		request.used            = false;
+		request.allocator       = {};
+		request.counter.pending = 0;
+	}
+	for( auto& completion : loader->completions ) {
+		completion = 0;
+	}
+	loader->completionsWrite = 0;
+	loader->completionsRead  = 0;
+}
+
+static void pushAssetCompletion( AssetLoader* loader, AssetRequest* request )
+{
+	auto index = (int32)( request - loader->requests );
+	auto write = loader->completionsWrite.fetch_add( 1, std::memory_order_relaxed );
+	loader->completions[write % MAX_ASSET_REQUESTS].store( index + 1, std::memory_order_release );
+}
+
+// jobs, these run on worker threads and may only touch the memory of their request
+
+static bool loadTextureAsset( AssetLoader* loader, AssetRequest* request )
+{
+	request->image = loader->platform->loadImageToMemory( request->filename );
+	return (bool)request->image;
+}
+
+static bool loadVoxelCollectionAsset( AssetLoader* loader, AssetRequest* request )
+{
+	auto allocator = &request->allocator;
+	auto scratch   = getThreadScratch();
+	if( !scratch ) {
+		return false;
+	}
+	TEMPORARY_MEMORY_BLOCK( scratch ) {
+		auto file = readFile( scratch, request->filename );
+		auto doc  = makeJsonDocument( scratch, file );
+		if( !doc || !doc.root.getObject() ) {
+			return false;
+		}
+		auto root = doc.root.getObject();
+
+		// the texture is decoded here and uploaded when the request is processed
+		request->textureFilename = makeString( allocator, root["texture"].getString() );
+		request->image = loader->platform->loadImageToMemory( request->textureFilename );
+		if( !request->image ) {
+			return false;
+		}
+		vec2 textureSize = {(float)request->image.width, (float)request->image.height};
+		parseVoxelCollection( allocator, root, {}, textureSize, &request->voxels );
+		request->voxels.filename = makeString( allocator, request->filename );
+
+		auto voxels = &request->voxels;
+		auto grids  = makeArray( scratch, VoxelGrid, voxels->frames.size() );
+		if( !loadVoxelGridsFromFile( voxels->voxelsFilename, grids ) ) {
+			return false;
+		}
+		request->meshes = makeArray( allocator, Mesh, grids.size() );
+		if( !generateVoxelCollectionMeshes( loader->platform->jobs, allocator, voxels, grids,
+		                                    request->meshes ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void runAssetJob( void* data, int32 first, int32 last )
+{
+	auto loader  = (AssetLoader*)data;
+	auto request = &loader->requests[first];
+	switch( request->type ) {
+		case AssetType::Texture: {
+			request->success = loadTextureAsset( loader, request );
+			break;
+		}
+		case AssetType::VoxelCollection:
+		case AssetType::TileSet: {
+			request->success = loadVoxelCollectionAsset( loader, request );
+			break;
+		}
+		InvalidDefaultCase;
+	}
+	pushAssetCompletion( loader, request );
+}
+
+static AssetRequest* addAssetRequest( AssetLoader* loader, AssetType type, StringView filename,
+                                      StackAllocator* target, void* out )
+{
+	assert( loader );
+	assert( out );
+	// the counter of a processed request is decremented after its completion was pushed
+	AssetRequest* request = nullptr;
+	for( auto& entry : loader->requests ) {
+		if( !entry.used && entry.counter.pending.load( std::memory_order_acquire ) == 0 ) {
+			request = &entry;
+			break;
+		}
+	}
+	if( !request ) {
+		LOG( ERROR, "Too many asset requests, {} is not loaded asynchronously", filename );
+		return nullptr;
+	}
+	if( type != AssetType::Texture && !request->allocator.ptr ) {
+		auto virtualMemory = &loader->platform->virtualMemory;
+		if( !virtualMemory->reserve ) {
+			LOG( ERROR, "Asset requests need virtual memory" );
+			return nullptr;
+		}
+		request->allocator = makeGrowableStackAllocator( virtualMemory, loader->reserveSize );
+		if( !request->allocator.ptr ) {
+			OutOfMemory();
+			return nullptr;
+		}
+	}
+
+	request->type     = type;
+	request->used     = true;
+	request->success  = false;
+	request->filename = filename;
+	request->target   = target;
+	request->out      = out;
+	request->image    = {};
+	request->voxels   = {};
+	request->meshes   = {};
+	++loader->pendingCount;
+
+	// the job range is the index of the request
+	auto index            = (int32)( request - loader->requests );
+	request->job.function = runAssetJob;
+	request->job.data     = loader;
+	request->job.first    = index;
+	request->job.last     = index + 1;
+	if( auto jobs = loader->platform->jobs ) {
+		addBackgroundJobs( jobs, &request->job, 1, &request->counter );
+	} else {
+		runAssetJob( loader, index, index + 1 );
+	}
+	return request;
+}
+
+// out and allocator need to stay valid until the request was processed
+// returns false if the request couldn't be queued, the asset needs to be loaded synchronously then
+bool requestTexture( AssetLoader* loader, StringView filename, TextureId* out )
+{
+	if( auto cached = getTextureInfo( filename ) ) {
+		*out = cached->id;
+		return true;
+	}
+	*out = {};
+	return addAssetRequest( loader, AssetType::Texture, filename, nullptr, out ) != nullptr;
+}
+bool requestVoxelCollection( AssetLoader* loader, StackAllocator* allocator, StringView filename,
+                             VoxelCollection* out )
+{
+	assert( isValid( allocator ) );
+	*out = {};
+	return addAssetRequest( loader, AssetType::VoxelCollection, filename, allocator, out )
+	       != nullptr;
+}
+bool requestTileSet( AssetLoader* loader, StackAllocator* allocator, StringView filename,
+                     TileSet* out )
+{
+	assert( isValid( allocator ) );
+	*out = {};
+	return addAssetRequest( loader, AssetType::TileSet, filename, allocator, out ) != nullptr;
+}
+
+// uploads the results of a voxel collection request and copies them into the target allocator
+static bool completeVoxelCollectionAsset( AssetLoader* loader, AssetRequest* request,
+                                          VoxelCollection* out )
+{
+	auto platform = loader->platform;
+	auto texture  = platform->loadTextureFromImage( request->textureFilename, request->image );
+	request->image = {};
+	if( !texture ) {
+		return false;
+	}
+
+	auto voxels = &request->voxels;
+	copyVoxelCollection( request->target, *voxels, out );
+	out->texture = texture;
+	FOR( info : out->frameInfos ) {
+		info.textureMap.texture = texture;
+	}
+	if( auto entry = findCachedVoxelCollectionMeshes( out->filename, out->frames.size() ) ) {
+		for( auto i = 0, count = out->frames.size(); i < count; ++i ) {
+			out->frames[i].mesh       = entry->meshes[i].id;
+			out->frameInfos[i].bounds = entry->meshes[i].bounds;
+		}
+		++entry->referenceCount;
+	} else {
+		for( auto i = 0, count = out->frames.size(); i < count; ++i ) {
+			out->frames[i].mesh = platform->uploadMesh( request->meshes[i] );
+			assert( out->frames[i].mesh );
+		}
+		cacheVoxelCollectionMeshes( *out );
+	}
+	return true;
+}
+
+static void completeAssetRequest( AssetLoader* loader, AssetRequest* request )
+{
+	auto success = request->success;
+	if( success ) {
+		switch( request->type ) {
+			case AssetType::Texture: {
+				auto out = (TextureId*)request->out;
+				*out = loader->platform->loadTextureFromImage( request->filename, request->image );
+				request->image = {};
+				success        = (bool)*out;
+				break;
+			}
+			case AssetType::VoxelCollection: {
+				auto out = (VoxelCollection*)request->out;
+				success  = completeVoxelCollectionAsset( loader, request, out );
+				break;
+			}
+			case AssetType::TileSet: {
+				auto out = (TileSet*)request->out;
+				success  = completeVoxelCollectionAsset( loader, request, &out->voxels );
+				if( success ) {
+					makeTileSetInfos( request->target, out );
+				}
+				break;
+			}
+			InvalidDefaultCase;
+		}
+	}
+	StringView filename = request->filename;
+	if( success ) {
+		LOG( INFORMATION, "{}: Loaded asynchronously", filename );
+	} else {
+		LOG( ERROR, "{}: Failed to load asset", filename );
+	}
+
+	if( request->image ) {
+		loader->platform->freeImageData( &request->image );
+		request->image = {};
+	}
+	if( request->allocator.ptr ) {
+		clear( &request->allocator );
+	}
+	request->used = false;
+	--loader->pendingCount;
+}
+
+// processes completed requests, needs to be called on the main thread at the beginning of a frame
+// returns the number of processed requests
+int32 processAssetCompletions( AssetLoader* loader )
+{
+	assert( loader );
+	PROFILE_FUNCTION();
+
+	int32 result = 0;
+	for( ;; ) {
+		auto completion = &loader->completions[loader->completionsRead % MAX_ASSET_REQUESTS];
+		auto index      = completion->load( std::memory_order_acquire );
+		if( !index ) {
+			break;
+		}
+		completion->store( 0, std::memory_order_relaxed );
+		++loader->completionsRead;
+		completeAssetRequest( loader, &loader->requests[index - 1] );
+		++result;
+	}
+	return result;
+}
+
+bool hasPendingAssets( AssetLoader* loader ) { return loader->pendingCount > 0; }
+
+// helps running jobs until all requests are processed, unlike other waits of the main thread this
+// one takes background jobs too
+void waitForAssets( AssetLoader* loader )
+{
+	assert( loader );
+	auto jobs        = loader->platform->jobs;
+	auto workerIndex = ( jobs ) ? ( getJobWorkerIndex( jobs ) ) : ( -1 );
+	for( ;; ) {
+		processAssetCompletions( loader );
+		if( !hasPendingAssets( loader ) ) {
+			break;
+		}
+		if( workerIndex < 0
+		    || ( !tryRunJob( jobs, workerIndex ) && !tryRunBackgroundJob( jobs ) ) ) {
+			std::this_thread::yield();
+		}
+	}
+}
@@ -96,49 +96,671 @@ CollisionInfo testAabVsAab( rectfarg a, vec2arg aPosition, vec2arg delta, rectfa
 	return info;
 }
 
+// batched testAabVsAab against targets in structure of arrays layout, four targets are tested per
+// iteration with SSE
+// the kernel does the same floating point operations in the same order as testAabVsAab, so that
+// results are bit identical and replays stay deterministic
+#define MAX_AAB_BATCH ( 64 )
+struct AabBatch {
+	alignas( 16 ) float left[MAX_AAB_BATCH];
+	alignas( 16 ) float top[MAX_AAB_BATCH];
+	alignas( 16 ) float right[MAX_AAB_BATCH];
+	alignas( 16 ) float bottom[MAX_AAB_BATCH];
+	int32 count;
+
+	bool full() const { return count == MAX_AAB_BATCH; }
+	void push_back( rectfarg aab )
+	{
+		assert( count < MAX_AAB_BATCH );
+		left[count]   = aab.left;
+		top[count]    = aab.top;
+		right[count]  = aab.right;
+		bottom[count] = aab.bottom;
+		++count;
+	}
+	rectf operator[]( int32 i ) const
+	{
+		assert( i >= 0 && i < count );
+		return {left[i], top[i], right[i], bottom[i]};
+	}
+};
+
+// out[i] is the result of testAabVsAab with targets[first + i], targets beyond count are invalid
+static void testAabVsAab4( rectfarg a, vec2arg aPosition, vec2arg delta,
+                           const AabBatch* targets, int32 first, float maxT, CollisionInfo out[4] )
+{
+	assert( first >= 0 && first < targets->count );
+	auto count = min( targets->count - first, 4 );
+
+	__m128 left, top, right, bottom;
+	if( count == 4 ) {
+		left   = _mm_load_ps( targets->left + first );
+		top    = _mm_load_ps( targets->top + first );
+		right  = _mm_load_ps( targets->right + first );
+		bottom = _mm_load_ps( targets->bottom + first );
+	} else {
+		// pad with the last target, so that we don't read uninitialized lanes
+		alignas( 16 ) float lanes[4][4];
+		for( auto i = 0; i < 4; ++i ) {
+			auto index  = first + min( i, count - 1 );
+			lanes[0][i] = targets->left[index];
+			lanes[1][i] = targets->top[index];
+			lanes[2][i] = targets->right[index];
+			lanes[3][i] = targets->bottom[index];
+		}
+		left   = _mm_load_ps( lanes[0] );
+		top    = _mm_load_ps( lanes[1] );
+		right  = _mm_load_ps( lanes[2] );
+		bottom = _mm_load_ps( lanes[3] );
+	}
+
+	// selects a where mask is set, b otherwise
+	auto select = []( __m128 mask, __m128 a, __m128 b ) {
+		return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+	};
+
+	auto safety    = _mm_set_ps1( SafetyDistance );
+	auto sumLeft   = _mm_add_ps( _mm_sub_ps( left, _mm_set_ps1( a.right ) ), safety );
+	auto sumTop    = _mm_add_ps( _mm_sub_ps( top, _mm_set_ps1( a.bottom ) ), safety );
+	auto sumRight  = _mm_sub_ps( _mm_sub_ps( right, _mm_set_ps1( a.left ) ), safety );
+	auto sumBottom = _mm_sub_ps( _mm_sub_ps( bottom, _mm_set_ps1( a.top ) ), safety );
+	auto px        = _mm_set_ps1( aPosition.x );
+	auto py        = _mm_set_ps1( aPosition.y );
+	auto dx        = _mm_set_ps1( delta.x );
+	auto dy        = _mm_set_ps1( delta.y );
+
+	// normals are encoded as 0 = left, 1 = up, 2 = right, 3 = down
+	const vec2 Normals[] = {{-1, 0}, {0, -1}, {1, 0}, {0, 1}};
+
+	// inside: minimal push, min returns the second argument on ties
+	auto insideX    = _mm_and_ps( _mm_cmpge_ps( px, sumLeft ), _mm_cmplt_ps( px, sumRight ) );
+	auto insideY    = _mm_and_ps( _mm_cmpge_ps( py, sumTop ), _mm_cmplt_ps( py, sumBottom ) );
+	auto inside     = _mm_and_ps( insideX, insideY );
+	auto leftPush   = _mm_sub_ps( px, sumLeft );
+	auto upPush     = _mm_sub_ps( py, sumTop );
+	auto rightPush  = _mm_sub_ps( sumRight, px );
+	auto downPush   = _mm_sub_ps( sumBottom, py );
+	auto mask0      = _mm_cmplt_ps( leftPush, upPush );
+	auto mask1      = _mm_cmplt_ps( rightPush, downPush );
+	auto push0      = select( mask0, leftPush, upPush );
+	auto push1      = select( mask1, rightPush, downPush );
+	auto normal0    = select( mask0, _mm_set_ps1( 0 ), _mm_set_ps1( 1 ) );
+	auto normal1    = select( mask1, _mm_set_ps1( 2 ), _mm_set_ps1( 3 ) );
+	auto mask       = _mm_cmplt_ps( push0, push1 );
+	auto minPush    = select( mask, push0, push1 );
+	auto pushNormal = select( mask, normal0, normal1 );
+
+	// outside: earliest edge that is hit before maxT, earlier edges win ties
+	auto t        = _mm_set_ps1( maxT );
+	auto normal   = _mm_set_ps1( -1 );
+	auto testEdge = [&]( __m128 segment, __m128 p, __m128 d, __m128 other, __m128 otherDelta,
+	                     __m128 start, __m128 end, float code ) {
+		auto intersectionT     = _mm_div_ps( _mm_sub_ps( segment, p ), d );
+		auto intersectionOther = _mm_add_ps( other, _mm_mul_ps( otherDelta, intersectionT ) );
+		auto hit = _mm_and_ps( _mm_cmpgt_ps( intersectionT, _mm_setzero_ps() ),
+		                       _mm_and_ps( _mm_cmpge_ps( intersectionOther, start ),
+		                                   _mm_cmplt_ps( intersectionOther, end ) ) );
+		hit    = _mm_and_ps( hit, _mm_cmplt_ps( intersectionT, t ) );
+		t      = select( hit, intersectionT, t );
+		normal = select( hit, _mm_set_ps1( code ), normal );
+	};
+	if( delta.x != 0 ) {
+		testEdge( sumLeft, px, dx, py, dy, sumTop, sumBottom, 0 );
+		testEdge( sumRight, px, dx, py, dy, sumTop, sumBottom, 2 );
+	}
+	if( delta.y != 0 ) {
+		testEdge( sumTop, py, dy, px, dx, sumLeft, sumRight, 1 );
+		testEdge( sumBottom, py, dy, px, dx, sumLeft, sumRight, 3 );
+	}
+
+	alignas( 16 ) float minPushLanes[4];
+	alignas( 16 ) float pushNormalLanes[4];
+	alignas( 16 ) float tLanes[4];
+	alignas( 16 ) float normalLanes[4];
+	_mm_store_ps( minPushLanes, minPush );
+	_mm_store_ps( pushNormalLanes, pushNormal );
+	_mm_store_ps( tLanes, t );
+	_mm_store_ps( normalLanes, normal );
+	auto insideMask = _mm_movemask_ps( inside );
+	for( auto i = 0; i < 4; ++i ) {
+		auto info = InvalidCollisionInfo;
+		if( i >= count ) {
+			// padding
+		} else if( insideMask & ( 1 << i ) ) {
+			PushPair minPush = {minPushLanes[i], Normals[(int32)pushNormalLanes[i]]};
+			info.t           = -1;
+			info.normal      = minPush.normal;
+			info.push        = minPush.push * minPush.normal;
+			if( ( minPush.normal.x < 0 && delta.x < info.push.x )
+			    || ( minPush.normal.x > 0 && delta.x > info.push.x )
+			    || ( minPush.normal.y < 0 && delta.y < info.push.y )
+			    || ( minPush.normal.y > 0 && delta.y > info.push.y ) ) {
+				// moving away from collision faster than the push, see testAabVsAab
+				info.t = InvalidCollisionInfo.t;
+			}
+		} else if( normalLanes[i] >= 0 ) {
+			info.t      = tLanes[i];
+			info.normal = Normals[(int32)normalLanes[i]];
+		}
+		out[i] = info;
+	}
+}
+
+// index of the target with the earliest collision before maxT, -1 if there is none
+// ties go to the lower index, which is the same result as testing targets one after another
+static int32 findEarliestAabCollision( rectfarg a, vec2arg aPosition, vec2arg delta,
+                                       const AabBatch* targets, float maxT, CollisionInfo* info )
+{
+	int32 result = -1;
+	for( auto first = 0; first < targets->count; first += 4 ) {
+		// a lane can't beat an earlier one with maxT of the iteration instead of the running
+		// minimum, since only collisions with t < minimum are taken
+		CollisionInfo lanes[4];
+		testAabVsAab4( a, aPosition, delta, targets, first, maxT, lanes );
+		for( auto i = 0, count = min( targets->count - first, 4 ); i < count; ++i ) {
+			if( lanes[i] && lanes[i].t < maxT ) {
+				maxT   = lanes[i].t;
+				*info  = lanes[i];
+				result = first + i;
+			}
+		}
+	}
+	return result;
+}
+// index of the first target with a collision that satisfies predicate, -1 if there is none
+template < class Predicate >
+static int32 findFirstAabCollision( rectfarg a, vec2arg aPosition, vec2arg delta,
+                                    const AabBatch* targets, float maxT, CollisionInfo* info,
+                                    Predicate&& predicate )
+{
+	for( auto first = 0; first < targets->count; first += 4 ) {
+		CollisionInfo lanes[4];
+		testAabVsAab4( a, aPosition, delta, targets, first, maxT, lanes );
+		for( auto i = 0, count = min( targets->count - first, 4 ); i < count; ++i ) {
+			if( lanes[i] && predicate( lanes[i] ) ) {
+				*info = lanes[i];
+				return first + i;
+			}
+		}
+	}
+	return -1;
+}
+
 struct CollisionResult {
 	CollidableRef collision;
 	CollisionInfo info;
 	inline explicit operator bool() const { return static_cast< bool >( collision ); }
 };
-static CollisionResult detectCollisionVsTileGrid( rectfarg aab, vec2arg position, vec2arg velocity,
-                                                  TileGrid grid, recti tileGridRegion, float maxT )
+// calls function with every rect of merged occupied tiles that overlaps region and that the aab
+// moving along delta might collide with before maxT
+// empty tiles are skipped with bit scans of the occupancy, rects are tested four at a time
+// against the slabs of their minkowski sums with the aab, the test is conservative (the slabs are
+// widened by TileCandidateEpsilon), so it only rejects rects that testAabVsAab would reject too
+// rects are visited once in the order of their first tile inside region in row major order, maxT is
+// read again for every batch, so that it can shrink while function is finding collisions
+const float TileCandidateEpsilon = 0.001f;
+template < class Function >
+static void forEachTileRectCandidate( rectfarg aab, vec2arg position, vec2arg delta,
+                                      const float* maxT, TileOccupancy occupancy,
+                                      recti region, Function&& function )
 {
 	using namespace GameConstants;
 
+	if( region.left >= region.right || region.top >= region.bottom ) {
+		return;
+	}
+	// minkowski sum of a rect and the aab is (rect + offsetMin, rect + offsetMax)
+	const auto offsetMinX = _mm_set_ps1( -aab.right + SafetyDistance - TileCandidateEpsilon );
+	const auto offsetMinY = _mm_set_ps1( -aab.bottom + SafetyDistance - TileCandidateEpsilon );
+	const auto offsetMaxX = _mm_set_ps1( -aab.left - SafetyDistance + TileCandidateEpsilon );
+	const auto offsetMaxY = _mm_set_ps1( -aab.top - SafetyDistance + TileCandidateEpsilon );
+	const auto tileWidth  = _mm_set_ps1( TileWidth );
+	const auto tileHeight = _mm_set_ps1( TileHeight );
+
+	// tests the slabs of one axis, not moving along the axis means position has to be inside
+	auto testSlab = []( __m128 sumMin, __m128 sumMax, float p, float d, __m128* tMin,
+	                    __m128* tMax ) {
+		auto pos = _mm_set_ps1( p );
+		if( d != 0 ) {
+			auto dir = _mm_set_ps1( d );
+			auto t0  = _mm_div_ps( _mm_sub_ps( sumMin, pos ), dir );
+			auto t1  = _mm_div_ps( _mm_sub_ps( sumMax, pos ), dir );
+			*tMin    = _mm_max_ps( *tMin, _mm_min_ps( t0, t1 ) );
+			*tMax    = _mm_min_ps( *tMax, _mm_max_ps( t0, t1 ) );
+			return _mm_cmple_ps( *tMin, *tMax );
+		}
+		return _mm_and_ps( _mm_cmple_ps( sumMin, pos ), _mm_cmpge_ps( sumMax, pos ) );
+	};
+
+	recti batch[4];
+	int32 batchCount = 0;
+	auto testBatch   = [&]() {
+		// rects beyond the end of the batch are filled with the last one, their results are ignored
+		for( auto i = batchCount; i < 4; ++i ) {
+			batch[i] = batch[batchCount - 1];
+		}
+		auto toFloats = [&]( int32 recti::*member ) {
+			return _mm_setr_ps( (float)( batch[0].*member ), (float)( batch[1].*member ),
+			                    (float)( batch[2].*member ), (float)( batch[3].*member ) );
+		};
+		auto left   = _mm_mul_ps( toFloats( &recti::left ), tileWidth );
+		auto top    = _mm_mul_ps( toFloats( &recti::top ), tileHeight );
+		auto right  = _mm_mul_ps( toFloats( &recti::right ), tileWidth );
+		auto bottom = _mm_mul_ps( toFloats( &recti::bottom ), tileHeight );
+
+		auto tMin = _mm_set_ps1( -FLOAT_MAX );
+		auto tMax = _mm_set_ps1( FLOAT_MAX );
+		auto hit  = _mm_and_ps( testSlab( _mm_add_ps( left, offsetMinX ),
+		                                  _mm_add_ps( right, offsetMaxX ), position.x, delta.x,
+		                                  &tMin, &tMax ),
+		                       testSlab( _mm_add_ps( top, offsetMinY ),
+		                                 _mm_add_ps( bottom, offsetMaxY ), position.y, delta.y,
+		                                 &tMin, &tMax ) );
+		hit       = _mm_and_ps( hit, _mm_cmpge_ps( tMax, _mm_setzero_ps() ) );
+		hit       = _mm_and_ps( hit, _mm_cmple_ps( tMin, _mm_set_ps1( *maxT ) ) );
+		auto mask = _mm_movemask_ps( hit );
+		for( auto i = 0; i < batchCount; ++i ) {
+			if( mask & ( 1 << i ) ) {
+				function( batch[i] );
+			}
+		}
+		batchCount = 0;
+	};
+
+	for( auto y = region.top; y < region.bottom; ++y ) {
+		auto x = region.left;
+		while( x < region.right ) {
+			// skip to the next occupied tile
+			auto word = x / 32;
+			auto bits = occupancy.bits.at( word, y ) & ( ~0u << ( x % 32 ) );
+			while( !bits && ( word + 1 ) * 32 < region.right ) {
+				bits = occupancy.bits.at( ++word, y );
+			}
+			if( !bits ) {
+				break;
+			}
+			x = word * 32 + bitScanForward( bits );
+			if( x >= region.right ) {
+				break;
+			}
+
+			auto id = occupancy.rectIds.at( x, y );
+			assert( id );
+			auto rect = occupancy.rects[id - 1];
+			// a rect is only visited at its first tile inside region
+			if( max( rect.top, region.top ) == y ) {
+				batch[batchCount++] = rect;
+				if( batchCount == 4 ) {
+					testBatch();
+				}
+			}
+			x = rect.right;
+		}
+	}
+	if( batchCount ) {
+		testBatch();
+	}
+}
+
+// collisions are detected against rects of merged tiles, but refer to single tiles, so that
+// friction and grounding still work per tile
+// the tile is the first one of the rect in row major order along the face that was hit
+static int32 getTileFromCollisionRect( TileGrid grid, recti rect, rectfarg aab, vec2arg position,
+                                       vec2arg normal )
+{
+	using namespace GameConstants;
+	auto bounds = translate( aab, position );
+	int32 x;
+	int32 y;
+	if( normal.y != 0 ) {
+		x = clamp( (int32)floor( ( bounds.left + SafetyDistance ) / TileWidth ), rect.left,
+		           rect.right - 1 );
+		y = ( normal.y < 0 ) ? ( rect.top ) : ( rect.bottom - 1 );
+	} else {
+		x = ( normal.x < 0 ) ? ( rect.left ) : ( rect.right - 1 );
+		y = clamp( (int32)floor( ( bounds.top + SafetyDistance ) / TileHeight ), rect.top,
+		           rect.bottom - 1 );
+	}
+	return grid.index( x, y );
+}
+static rectf getTileRectBounds( recti rect )
+{
+	using namespace GameConstants;
+	return {rect.left * TileWidth, rect.top * TileHeight, rect.right * TileWidth,
+	        rect.bottom * TileHeight};
+}
+
+static CollisionResult detectCollisionVsTileGrid( rectfarg aab, vec2arg position, vec2arg velocity,
+                                                  TileGrid grid, TileOccupancy occupancy,
+                                                  recti tileGridRegion, float maxT )
+{
 	CollisionResult result = {};
 	result.info.t          = maxT;
-	for( auto y = tileGridRegion.top; y < tileGridRegion.bottom; ++y ) {
-		for( auto x = tileGridRegion.left; x < tileGridRegion.right; ++x ) {
-			auto index = grid.index( x, y );
-			auto tile  = grid[index];
-			if( tile ) {
-				rectf tileBounds = RectWH( x * TileWidth, y * TileHeight, TileWidth, TileHeight );
-				auto info = testAabVsAab( aab, position, velocity, tileBounds, result.info.t );
-				if( info && info.t < result.info.t ) {
-					result.collision.setTile( index );
-					result.info = info;
+
+	// candidates are collected and tested in batches
+	AabBatch targets;
+	recti rects[MAX_AAB_BATCH];
+	targets.count = 0;
+	auto flush    = [&]() {
+		CollisionInfo info;
+		auto index = findEarliestAabCollision( aab, position, velocity, &targets, result.info.t,
+		                                       &info );
+		if( index >= 0 ) {
+			auto contact = ( info.t < 0 ) ? ( position + info.push )
+			                              : ( position + velocity * info.t );
+			result.collision.setTile(
+			    getTileFromCollisionRect( grid, rects[index], aab, contact, info.normal ) );
+			result.info = info;
+		}
+		targets.count = 0;
+	};
+	auto addRect = [&]( recti rect ) {
+		rects[targets.count] = rect;
+		targets.push_back( getTileRectBounds( rect ) );
+		if( targets.full() ) {
+			flush();
+		}
+	};
+	forEachTileRectCandidate( aab, position, velocity, &result.info.t, occupancy, tileGridRegion,
+	                          addRect );
+	flush();
+	return result;
+}
+
+// broadphase for dynamics
+// uniform grid over the map, every cell holds the indices of the dynamics whose bounds overlap it
+// the grid is rebuilt after dynamics moved, queries only test the dynamics in the cells that
+// overlap the swept bounds of the collidable instead of every dynamic
+// bounds outside of the map are clamped into the border cells, so no dynamic is ever missed
+#define MAX_BROADPHASE_CANDIDATES ( 64 )
+const float BroadphaseCellSize = GameConstants::TileWidth * 4;
+
+struct DynamicsBroadphase {
+	Array< Entity > dynamics;
+	int32 width;  // in cells, 0 if there is no grid and every dynamic is a candidate
+	int32 height;
+	// entries of cell i are entries[cellStarts[i]] until entries[cellStarts[i + 1]], sorted
+	Array< int32 > cellStarts;
+	Array< int32 > entries;  // indices into dynamics
+};
+
+// cells overlapping bounds, touching bounds share a cell
+static recti getBroadphaseCellRegion( const DynamicsBroadphase* broadphase, rectfarg bounds )
+{
+	auto invCellSize = 1.0f / BroadphaseCellSize;
+	auto maxX        = broadphase->width - 1;
+	auto maxY        = broadphase->height - 1;
+	recti result;
+	result.left   = clamp( (int32)floor( bounds.left * invCellSize ), 0, maxX );
+	result.top    = clamp( (int32)floor( bounds.top * invCellSize ), 0, maxY );
+	result.right  = clamp( (int32)floor( bounds.right * invCellSize ), 0, maxX ) + 1;
+	result.bottom = clamp( (int32)floor( bounds.bottom * invCellSize ), 0, maxY ) + 1;
+	return result;
+}
+
+// broadphase without a grid, every dynamic is a candidate
+DynamicsBroadphase makeDynamicsBroadphase( Array< Entity > dynamics )
+{
+	DynamicsBroadphase result = {};
+	result.dynamics           = dynamics;
+	return result;
+}
+
+// builds the grid over the map with a counting sort of the dynamics into the cells
+// allocator needs to outlive the broadphase, falls back to no grid if out of memory
+DynamicsBroadphase makeDynamicsBroadphase( StackAllocator* allocator, Array< Entity > dynamics,
+                                           TileGrid grid )
+{
+	using namespace GameConstants;
+	PROFILE_FUNCTION();
+
+	auto result = makeDynamicsBroadphase( dynamics );
+	if( dynamics.empty() ) {
+		return result;
+	}
+	result.width  = max( (int32)ceil( grid.width * TileWidth / BroadphaseCellSize ), 1 );
+	result.height = max( (int32)ceil( grid.height * TileHeight / BroadphaseCellSize ), 1 );
+	auto cellsCount   = result.width * result.height;
+	result.cellStarts = makeArray( allocator, int32, cellsCount + 1 );
+	if( result.cellStarts.empty() ) {
+		return makeDynamicsBroadphase( dynamics );
+	}
+
+	// count entries of every cell into the next cell, so that the prefix sum results in the starts
+	FOR( start : result.cellStarts ) {
+		start = 0;
+	}
+	FOR( dynamic : dynamics ) {
+		auto bounds = translate( dynamic.aab, dynamic.position );
+		auto region = getBroadphaseCellRegion( &result, bounds );
+		for( auto y = region.top; y < region.bottom; ++y ) {
+			for( auto x = region.left; x < region.right; ++x ) {
+				++result.cellStarts[x + y * result.width + 1];
+			}
+		}
+	}
+	for( auto i = 1; i <= cellsCount; ++i ) {
+		result.cellStarts[i] += result.cellStarts[i - 1];
+	}
+	result.entries = makeArray( allocator, int32, result.cellStarts[cellsCount] );
+	if( result.entries.size() != result.cellStarts[cellsCount] ) {
+		return makeDynamicsBroadphase( dynamics );
+	}
+
+	// cellStarts is used as the write position of every cell, which moves it to the start of the
+	// next cell, dynamics are visited in order, so entries of a cell are sorted
+	FOR( dynamic : dynamics ) {
+		auto index  = indexof( dynamics, dynamic );
+		auto bounds = translate( dynamic.aab, dynamic.position );
+		auto region = getBroadphaseCellRegion( &result, bounds );
+		for( auto y = region.top; y < region.bottom; ++y ) {
+			for( auto x = region.left; x < region.right; ++x ) {
+				result.entries[result.cellStarts[x + y * result.width]++] = index;
+			}
+		}
+	}
+	for( auto i = cellsCount; i > 0; --i ) {
+		result.cellStarts[i] = result.cellStarts[i - 1];
+	}
+	result.cellStarts[0] = 0;
+	return result;
+}
+
+// calls function with the index of every dynamic whose bounds might overlap bounds
+// indices are visited in ascending order and only once, so that results are the same as when
+// testing every dynamic
+template < class Function >
+static void forEachDynamicCandidate( const DynamicsBroadphase* broadphase, rectfarg bounds,
+                                     Function&& function )
+{
+	auto visitAll = [&]() {
+		for( auto i = 0, count = broadphase->dynamics.size(); i < count; ++i ) {
+			function( i );
+		}
+	};
+	if( !broadphase->width ) {
+		visitAll();
+		return;
+	}
+
+	int32 candidates[MAX_BROADPHASE_CANDIDATES];
+	int32 candidatesCount = 0;
+	auto region           = getBroadphaseCellRegion( broadphase, bounds );
+	for( auto y = region.top; y < region.bottom; ++y ) {
+		for( auto x = region.left; x < region.right; ++x ) {
+			auto cell  = x + y * broadphase->width;
+			auto first = broadphase->cellStarts[cell];
+			auto last  = broadphase->cellStarts[cell + 1];
+			for( auto i = first; i < last; ++i ) {
+				// sorted insert, dynamics that overlap multiple cells are only added once
+				auto index = broadphase->entries[i];
+				auto pos   = candidatesCount;
+				while( pos > 0 && candidates[pos - 1] > index ) {
+					--pos;
+				}
+				if( pos > 0 && candidates[pos - 1] == index ) {
+					continue;
+				}
+				if( candidatesCount == MAX_BROADPHASE_CANDIDATES ) {
+					visitAll();
+					return;
+				}
+				for( auto j = candidatesCount; j > pos; --j ) {
+					candidates[j] = candidates[j - 1];
 				}
+				candidates[pos] = index;
+				++candidatesCount;
+			}
+		}
+	}
+	for( auto i = 0; i < candidatesCount; ++i ) {
+		function( candidates[i] );
+	}
+}
+
+// broadphase for hit detection
+// sort and sweep on the x axis between two sets of rects, like the swept hitboxes of attackers and
+// the hurtboxes of defenders, rects are sorted by their left edge, so every rect only needs to be
+// tested against the following rects until one starts right of it
+// touching rects count as overlapping, rects with left > right are empty and never overlap
+struct RectOverlaps {
+	int32 bsCount;
+	// overlaps of as[i] are entries[starts[i]] until entries[starts[i + 1]], sorted
+	// starts is empty if there wasn't enough memory, every b is a candidate then
+	Array< int32 > starts;
+	Array< int32 > entries;  // indices into bs
+};
+
+// allocator needs to outlive the result
+RectOverlaps findRectOverlaps( StackAllocator* allocator, Array< rectf > as, Array< rectf > bs )
+{
+	PROFILE_FUNCTION();
+
+	struct Interval {
+		rectf rect;
+		int32 index;
+		bool isB;
+	};
+	struct Overlap {
+		int32 a;
+		int32 b;
+	};
+
+	RectOverlaps result = {};
+	result.bsCount      = bs.size();
+	auto count          = as.size() + bs.size();
+	auto intervals      = makeUArray( allocator, Interval, count );
+	auto starts         = makeArray( allocator, int32, as.size() + 1 );
+	if( intervals.capacity() != count || starts.size() != as.size() + 1 ) {
+		return result;
+	}
+	FOR( rect : as ) {
+		if( rect.left <= rect.right ) {
+			intervals.push_back( {rect, indexof( as, rect ), false} );
+		}
+	}
+	FOR( rect : bs ) {
+		if( rect.left <= rect.right ) {
+			intervals.push_back( {rect, indexof( bs, rect ), true} );
+		}
+	}
+	sort( intervals.begin(), intervals.end(),
+	      []( const Interval& a, const Interval& b ) { return a.rect.left < b.rect.left; } );
+
+	auto overlaps = beginVector( allocator, Overlap );
+	for( auto i = 0, intervalsCount = intervals.size(); i < intervalsCount; ++i ) {
+		auto& first = intervals[i];
+		for( auto j = i + 1; j < intervalsCount && intervals[j].rect.left <= first.rect.right;
+		     ++j ) {
+			auto& second = intervals[j];
+			if( first.isB == second.isB || first.rect.top > second.rect.bottom
+			    || first.rect.bottom < second.rect.top ) {
+				continue;
+			}
+			if( overlaps.full() ) {
+				endVector( allocator, &overlaps );
+				return result;
+			}
+			if( first.isB ) {
+				overlaps.push_back( {second.index, first.index} );
+			} else {
+				overlaps.push_back( {first.index, second.index} );
 			}
 		}
 	}
+	endVector( allocator, &overlaps );
+	sort( overlaps.begin(), overlaps.end(), []( const Overlap& a, const Overlap& b ) {
+		return a.a < b.a || ( a.a == b.a && a.b < b.b );
+	} );
+
+	result.entries = makeArray( allocator, int32, overlaps.size() );
+	if( result.entries.size() != overlaps.size() ) {
+		result.entries = {};
+		return result;
+	}
+	FOR( start : starts ) {
+		start = 0;
+	}
+	FOR( overlap : overlaps ) {
+		result.entries[indexof( overlaps, overlap )] = overlap.b;
+		++starts[overlap.a + 1];
+	}
+	for( auto i = 1, startsCount = starts.size(); i < startsCount; ++i ) {
+		starts[i] += starts[i - 1];
+	}
+	result.starts = starts;
 	return result;
 }
+
+// calls function with the index of every b that overlaps as[a] in ascending order
+template < class Function >
+static void forEachRectOverlap( const RectOverlaps* overlaps, int32 a, Function&& function )
+{
+	if( overlaps->starts.empty() ) {
+		for( auto i = 0; i < overlaps->bsCount; ++i ) {
+			function( i );
+		}
+		return;
+	}
+	for( auto i = overlaps->starts[a], last = overlaps->starts[a + 1]; i < last; ++i ) {
+		function( overlaps->entries[i] );
+	}
+}
+
 static CollisionResult detectCollisionVsDynamics( rectfarg aab, vec2arg position, vec2arg velocity,
-                                                  Array< Entity > dynamics, float maxT )
+                                                  const DynamicsBroadphase* broadphase, float maxT )
 {
 	using namespace GameConstants;
 
 	CollisionResult result = {};
 	result.info.t          = maxT;
-	FOR( dynamic : dynamics ) {
-		auto info = testAabVsAab( aab, position, velocity,
-		                          translate( dynamic.aab, dynamic.position ), result.info.t );
-		if( info && info.t < result.info.t ) {
-			result.collision.setDynamic( indexof( dynamics, dynamic ), dynamic.handle );
+	auto dynamics          = broadphase->dynamics;
+	auto sweptAab          = sweep( translate( aab, position ), velocity );
+
+	// candidates are collected and tested in batches
+	AabBatch targets;
+	int32 indices[MAX_AAB_BATCH];
+	targets.count = 0;
+	auto flush    = [&]() {
+		CollisionInfo info;
+		auto index = findEarliestAabCollision( aab, position, velocity, &targets, result.info.t,
+		                                       &info );
+		if( index >= 0 ) {
+			auto dynamic = &dynamics[indices[index]];
+			result.collision.setDynamic( indices[index], dynamic->handle );
 			result.info = info;
 		}
-	}
+		targets.count = 0;
+	};
+	forEachDynamicCandidate( broadphase, sweptAab, [&]( int32 index ) {
+		auto dynamic           = &dynamics[index];
+		indices[targets.count] = index;
+		targets.push_back( translate( dynamic->aab, dynamic->position ) );
+		if( targets.full() ) {
+			flush();
+		}
+	} );
+	flush();
 	return result;
 }
 
@@ -157,12 +779,12 @@ static recti getSweptTileGridRegion( rectfarg aab, vec2arg position, vec2arg vel
 }
 
 CollisionResult findCollision( rectfarg aab, vec2arg position, vec2arg velocity, TileGrid grid,
-                               recti tileGridRegion, Array< Entity > dynamics, float maxT,
-                               bool dynamic )
+                               TileOccupancy occupancy, recti tileGridRegion,
+                               const DynamicsBroadphase* dynamics, float maxT, bool dynamic )
 {
 	const recti mapBounds = {0, 0, grid.width, grid.height};
-	auto collision =
-	    detectCollisionVsTileGrid( aab, position, velocity, grid, tileGridRegion, maxT );
+	auto collision        = detectCollisionVsTileGrid( aab, position, velocity, grid, occupancy,
+	                                            tileGridRegion, maxT );
 	if( !dynamic && ( !collision || collision.info.t > 0 ) ) {
 		auto dynamicCollision =
 		    detectCollisionVsDynamics( aab, position, velocity, dynamics, maxT );
@@ -173,8 +795,8 @@ CollisionResult findCollision( rectfarg aab, vec2arg position, vec2arg velocity,
 				auto safety      = dynamicCollision.info.normal * SafetyDistance;
 				auto adjustedVel = dynamicCollision.info.push + safety;
 				auto sweptRegion = getSweptTileGridRegion( aab, position, adjustedVel, mapBounds );
-				auto maxMovementCollision =
-				    detectCollisionVsTileGrid( aab, position, adjustedVel, grid, sweptRegion, 1 );
+				auto maxMovementCollision = detectCollisionVsTileGrid(
+				    aab, position, adjustedVel, grid, occupancy, sweptRegion, 1 );
 				if( maxMovementCollision ) {
 					if( maxMovementCollision.info.t > 0 ) {
 						// TODO: we are being squished between dynamic and tile, handle?
@@ -198,21 +820,54 @@ CollisionResult findCollision( rectfarg aab, vec2arg position, vec2arg velocity,
 	}
 	return collision;
 }
+CollisionResult findCollision( rectfarg aab, vec2arg position, vec2arg velocity, TileGrid grid,
+                               TileOccupancy occupancy, recti tileGridRegion,
+                               Array< Entity > dynamics, float maxT, bool dynamic )
+{
+	auto broadphase = makeDynamicsBroadphase( dynamics );
+	return findCollision( aab, position, velocity, grid, occupancy, tileGridRegion, &broadphase,
+	                      maxT, dynamic );
+}
+
+const int32 CollisionMaxIterations = 4;
+
+// state of every collision iteration that debug jump tracking needs
+// entities are processed concurrently, so samples are collected per entity and applied to
+// debug_Values in entity order after all jobs are done
+struct CollisionDebugSamples {
+	struct Sample {
+		float positionY;
+		bool8 grounded;
+		bool8 rising;
+		bool8 landed;
+	};
+	Sample samples[CollisionMaxIterations];
+	int32 count;
+};
 
 // TODO: rename function, since this does way more than colliding
-void processCollidables( Array< Entity > entries, TileGrid grid,
-                         Array< TileInfo > infos, Array< Entity > dynamics,
-                         bool dynamic, float dt )
+// debugSamples has an entry for every entry of entries or is nullptr
+void processCollidables( const EntitySystem* system, Array< Entity > entries, TileGrid grid,
+                         TileOccupancy occupancy, Array< TileInfo > infos,
+                         const DynamicsBroadphase* broadphase, bool dynamic, float dt,
+                         CollisionDebugSamples* debugSamples )
 {
 	using namespace GameConstants;
 	constexpr const float eps = 0.00001f;
 
+	auto dynamics = broadphase->dynamics;
 	const recti MapBounds = {0, 0, grid.width, grid.height};
 	// TODO: air movement should be accelerated instead of instant
 	FOR( entry : entries ) {
 		auto traits      = getEntityTraits( entry.type );
 		auto oldPosition = entry.position;
 
+		CollisionDebugSamples* debug = nullptr;
+		if( debugSamples ) {
+			debug        = &debugSamples[&entry - entries.begin()];
+			debug->count = 0;
+		}
+
 		entry.walljumpWindow   = processTimer( entry.walljumpWindow, dt );
 		entry.walljumpDuration = processTimer( entry.walljumpDuration, dt );
 		auto alive             = entry.aliveCountdown;
@@ -286,7 +941,7 @@ void processCollidables( Array< Entity > entries, TileGrid grid,
 					break;
 				}
 				case CollidableRef::Dynamic: {
-					auto other = getDynamicFromCollidableRef( dynamics, entry.grounded );
+					auto other = getDynamicFromCollidableRef( system, dynamics, entry.grounded );
 					CollisionInfo info;
 					if( !other
 					    || !( info = testAabVsAab( entry.aab, entry.position, {0, 1},
@@ -298,28 +953,49 @@ void processCollidables( Array< Entity > entries, TileGrid grid,
 				}
 					InvalidDefaultCase;
 			}
+			// candidates for new ground are collected and tested in batches, the first one that we
+			// are standing on becomes the new ground
+			AabBatch groundTargets;
+			auto isGround = [&]( const CollisionInfo& info ) {
+				return info.normal.y < 0 && info.t >= 0 && info.t < SafetyDistance + eps;
+			};
+			auto findGround = [&]( CollisionInfo* info ) {
+				auto index = findFirstAabCollision( entry.aab, entry.position, {0, 1},
+				                                    &groundTargets, 1, info, isGround );
+				groundTargets.count = 0;
+				return index;
+			};
 			if( !entry.grounded ) {
 				// try and find a static entry as new ground
 				auto findNewStaticGround = [&]() {
-					auto bottom = MIN( tileGridRegion.bottom + 1, MapBounds.bottom );
-					for( int32 y = tileGridRegion.top; y < bottom; ++y ) {
-						for( int32 x = tileGridRegion.left; x < tileGridRegion.right; ++x ) {
-							auto index = grid.index( x, y );
-							auto tile  = grid[index];
-							if( tile ) {
-								auto tileBounds =
-								    RectWH( x * TileWidth, y * TileHeight, TileWidth, TileHeight );
-								auto info = testAabVsAab( entry.aab, entry.position, {0, 1},
-								                          tileBounds, 1 );
-								if( info && info.normal.y < 0 && info.t >= 0
-								    && info.t < SafetyDistance + eps ) {
-
-									entry.position.y += info.t - SafetyDistance;
-									entry.grounded.setTile( index );
-									return;
-								}
-							}
+					recti rects[MAX_AAB_BATCH];
+					groundTargets.count = 0;
+					auto flush          = [&]() {
+						CollisionInfo info;
+						auto index = findGround( &info );
+						if( index >= 0 ) {
+							entry.position.y += info.t - SafetyDistance;
+							entry.grounded.setTile( getTileFromCollisionRect(
+							    grid, rects[index], entry.aab, entry.position, info.normal ) );
+						}
+					};
+					auto addRect = [&]( recti rect ) {
+						if( entry.grounded ) {
+							return;
 						}
+						rects[groundTargets.count] = rect;
+						groundTargets.push_back( getTileRectBounds( rect ) );
+						if( groundTargets.full() ) {
+							flush();
+						}
+					};
+					auto region   = tileGridRegion;
+					region.bottom = MIN( tileGridRegion.bottom + 1, MapBounds.bottom );
+					float maxT    = 1;
+					forEachTileRectCandidate( entry.aab, entry.position, {0, 1}, &maxT, occupancy,
+					                          region, addRect );
+					if( !entry.grounded ) {
+						flush();
 					}
 				};
 				findNewStaticGround();
@@ -327,19 +1003,32 @@ void processCollidables( Array< Entity > entries, TileGrid grid,
 			if( !entry.grounded ) {
 				// try and find a dynamic entry as new ground
 				auto findNewDynamicGround = [&]() {
-					FOR( other : dynamics ) {
-						if( &entry == &other ) {
-							continue;
-						}
-						auto info = testAabVsAab( entry.aab, entry.position, {0, 1},
-						                          translate( other.aab, other.position ), 1 );
-						if( info && info.normal.y < 0 && info.t >= 0
-						    && info.t < SafetyDistance + eps ) {
-
+					int32 indices[MAX_AAB_BATCH];
+					groundTargets.count = 0;
+					auto flush          = [&]() {
+						CollisionInfo info;
+						auto index = findGround( &info );
+						if( index >= 0 ) {
+							auto other = &dynamics[indices[index]];
 							entry.position.y += info.t - SafetyDistance;
-							entry.grounded.setDynamic( indexof( dynamics, other ), other.handle );
+							entry.grounded.setDynamic( indices[index], other->handle );
+						}
+					};
+					auto addDynamic = [&]( int32 index ) {
+						auto other = &dynamics[index];
+						if( entry.grounded || &entry == other ) {
 							return;
 						}
+						indices[groundTargets.count] = index;
+						groundTargets.push_back( translate( other->aab, other->position ) );
+						if( groundTargets.full() ) {
+							flush();
+						}
+					};
+					auto sweptAab = sweep( translate( entry.aab, entry.position ), {0, 1} );
+					forEachDynamicCandidate( broadphase, sweptAab, addDynamic );
+					if( !entry.grounded ) {
+						flush();
 					}
 				};
 				findNewDynamicGround();
@@ -351,7 +1040,8 @@ void processCollidables( Array< Entity > entries, TileGrid grid,
 		}
 
 		if( entry.grounded && entry.grounded.type == CollidableRef::Dynamic ) {
-			if( auto dynamicGround = getDynamicFromCollidableRef( dynamics, entry.grounded ) ) {
+			auto dynamicGround = getDynamicFromCollidableRef( system, dynamics, entry.grounded );
+			if( dynamicGround ) {
 				velocity += dynamicGround->positionDelta;
 			}
 		}
@@ -367,10 +1057,10 @@ void processCollidables( Array< Entity > entries, TileGrid grid,
 		}
 
 		entry.lastCollision.clear();
-		constexpr const auto maxIterations = 4;
-		for( auto iterations = 0; iterations < maxIterations && remaining > 0.0f; ++iterations ) {
-			auto collision = findCollision( entry.aab, entry.position, velocity, grid,
-			                                tileGridRegion, dynamics, remaining, dynamic );
+		for( auto iterations = 0; iterations < CollisionMaxIterations && remaining > 0.0f;
+		     ++iterations ) {
+			auto collision = findCollision( entry.aab, entry.position, velocity, grid, occupancy,
+			                                tileGridRegion, broadphase, remaining, dynamic );
 
 			auto normal = collision.info.normal;
 			auto t      = collision.info.t;
@@ -411,22 +1101,13 @@ void processCollidables( Array< Entity > entries, TileGrid grid,
 				setSpatialState( &entry, SpatialState::Grounded );
 			}
 
-#ifdef GAME_DEBUG
-			if( entry.grounded ) {
-				debug_Values->groundPosition = entry.position.y;
-			}
-			if( !entry.grounded && velocity.y < 0 ) {
-				debug_Values->jumpHeight = entry.position.y - debug_Values->groundPosition;
-			}
-			if( normal.y < 0 ) {
-				if( debug_Values->jumpHeight < debug_Values->maxJumpHeight ) {
-					debug_Values->maxJumpHeight = debug_Values->jumpHeight;
-				}
-				debug_Values->jumpHeightError =
-				    abs( debug_Values->jumpHeight - debug_Values->lastJumpHeight );
-				debug_Values->lastJumpHeight = debug_Values->jumpHeight;
+			if( debug ) {
+				auto sample       = &debug->samples[debug->count++];
+				sample->positionY = entry.position.y;
+				sample->grounded  = (bool)entry.grounded;
+				sample->rising    = velocity.y < 0;
+				sample->landed    = normal.y < 0;
 			}
-#endif  // defined( GAME_DEBUG )
 
 			// response
 			if( collision ) {
@@ -485,8 +1166,8 @@ void processCollidables( Array< Entity > entries, TileGrid grid,
 				}
 				auto region =
 				    getSweptTileGridRegion( entry.aab, entry.position, searchDir, MapBounds );
-				auto collision = findCollision( entry.aab, entry.position, searchDir, grid, region,
-				                                dynamics, 1, dynamic );
+				auto collision = findCollision( entry.aab, entry.position, searchDir, grid,
+				                                occupancy, region, broadphase, 1, dynamic );
 				if( !collision || collision.info.normal.y != 0 ) {
 					// clear wallsliding
 					entry.walljumpWindow = {};
@@ -522,14 +1203,85 @@ void processCollidables( Array< Entity > entries, TileGrid grid,
 
 }
 
-static void doCollisionDetection( Room* room, EntitySystem* system, float dt )
+// entities of a pass only collide against tiles and, for static entries, against dynamics that
+// already moved, the results of an entity only depend on its own state
+// so every entity is its own island and a pass can resolve entities concurrently, every entity is
+// only written by the job that owns it, so results are the same as processing them serially and
+// don't depend on how jobs are scheduled
+const int32 CollisionJobGrainSize = 8;
+
+#ifdef GAME_DEBUG
+// tracks jumps the same way as if every entity had written debug_Values while it was processed
+static void applyCollisionDebugSamples( Array< CollisionDebugSamples > samples )
+{
+	FOR( entry : samples ) {
+		for( auto i = 0; i < entry.count; ++i ) {
+			auto sample = &entry.samples[i];
+			if( sample->grounded ) {
+				debug_Values->groundPosition = sample->positionY;
+			}
+			if( !sample->grounded && sample->rising ) {
+				debug_Values->jumpHeight = sample->positionY - debug_Values->groundPosition;
+			}
+			if( sample->landed ) {
+				if( debug_Values->jumpHeight < debug_Values->maxJumpHeight ) {
+					debug_Values->maxJumpHeight = debug_Values->jumpHeight;
+				}
+				debug_Values->jumpHeightError =
+				    abs( debug_Values->jumpHeight - debug_Values->lastJumpHeight );
+				debug_Values->lastJumpHeight = debug_Values->jumpHeight;
+			}
+		}
+	}
+}
+#endif  // defined( GAME_DEBUG )
+
+// jobs can be nullptr to process entities serially
+static void doCollisionDetection( Room* room, EntitySystem* system, JobSystem* jobs, float dt )
 {
 	using namespace GameConstants;
 	assert( room );
 
-	auto grid = getCollisionLayer( room );
+	auto grid      = getCollisionLayer( room );
+	auto occupancy = getCollisionOccupancy( room );
+	auto infos     = room->tileSet->infos;
+
+	SCRATCH_MEMORY_BLOCK( scratch ) {
+		Array< CollisionDebugSamples > dynamicSamples = {};
+		Array< CollisionDebugSamples > staticSamples  = {};
+#ifdef GAME_DEBUG
+		auto dynamicsCount = system->dynamicEntries().size();
+		auto staticsCount  = system->staticEntries().size();
+		dynamicSamples     = makeArray( scratch, CollisionDebugSamples, dynamicsCount );
+		staticSamples      = makeArray( scratch, CollisionDebugSamples, staticsCount );
+#endif
+		// ranges are subranges of the entries, samples are at the same offset
+		auto getSamples = []( Array< CollisionDebugSamples > samples, Array< Entity > entries,
+		                      Array< Entity > range ) {
+			return ( samples.size() ) ? ( samples.begin() + ( range.begin() - entries.begin() ) )
+			                          : ( nullptr );
+		};
+
+		auto noDynamics      = makeDynamicsBroadphase( {} );
+		auto processDynamics = [&]( Array< Entity > range ) {
+			auto samples = getSamples( dynamicSamples, system->dynamicEntries(), range );
+			processCollidables( system, range, grid, occupancy, infos, &noDynamics, true, dt,
+			                    samples );
+		};
+		parallel_for( jobs, system->dynamicEntries(), CollisionJobGrainSize, processDynamics );
+
+		// dynamics don't move anymore this step, so the grid is built once after they moved
+		auto broadphase     = makeDynamicsBroadphase( scratch, system->dynamicEntries(), grid );
+		auto processStatics = [&]( Array< Entity > range ) {
+			auto samples = getSamples( staticSamples, system->staticEntries(), range );
+			processCollidables( system, range, grid, occupancy, infos, &broadphase, false, dt,
+			                    samples );
+		};
+		parallel_for( jobs, system->staticEntries(), CollisionJobGrainSize, processStatics );
 
-	processCollidables( system->dynamicEntries(), grid, room->tileSet->infos, {}, true, dt );
-	processCollidables( system->staticEntries(), grid, room->tileSet->infos,
-	                    system->dynamicEntries(), false, dt );
-}
\ No newline at end of file
+#ifdef GAME_DEBUG
+		applyCollisionDebugSamples( dynamicSamples );
+		applyCollisionDebugSamples( staticSamples );
+#endif
+	}
+}
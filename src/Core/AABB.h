@@ -176,12 +176,12 @@ template< class T > bool isInside( taabbarg< T > a, taabbarg< T > b )
 }
 template< class T > bool isValid( taabbarg< T > box )
 {
-	assert( isValid( r.left ) );
-	assert( isValid( r.bottom ) );
-	assert( isValid( r.near ) );
-	assert( isValid( r.right ) );
-	assert( isValid( r.top ) );
-	assert( isValid( r.far ) );
+	assert( isValid( box.left ) );
+	assert( isValid( box.bottom ) );
+	assert( isValid( box.near ) );
+	assert( isValid( box.right ) );
+	assert( isValid( box.top ) );
+	assert( isValid( box.far ) );
 	return ( box.right >= box.left ) && ( box.top >= box.bottom ) && ( box.far >= box.near );
 }
 
@@ -21,23 +21,26 @@ using UArray = UninitializedArrayView< T >;
 template < class T >
 using Grid = GridView< T >;
 
+// the call site of the macros is passed through, so that allocation tracking attributes the memory
+// to the caller instead of this file
 template < class T >
-Array< T > makeArrayImpl( StackAllocator* allocator, int32 size )
+Array< T > makeArrayImpl( StackAllocator* allocator, int32 size ALLOCATION_SITE_PARAMS )
 {
-	auto p = allocateArray( allocator, T, size );
+	auto p = (T*)allocate( allocator, sizeof( T ) * size, alignof( T ) ALLOCATION_SITE_ARGS );
 	return {p, ( p ) ? ( size ) : ( 0 )};
 }
 template < class T >
-UArray< T > makeUArrayImpl( StackAllocator* allocator, int32 size )
+UArray< T > makeUArrayImpl( StackAllocator* allocator, int32 size ALLOCATION_SITE_PARAMS )
 {
-	auto p = allocateArray( allocator, T, size );
+	auto p = (T*)allocate( allocator, sizeof( T ) * size, alignof( T ) ALLOCATION_SITE_ARGS );
 	return {p, 0, ( p ) ? ( size ) : ( 0 )};
 }
 template < class T >
-Grid< T > makeGridImpl( StackAllocator* allocator, int32 width, int32 height )
+Grid< T > makeGridImpl( StackAllocator* allocator, int32 width,
+                        int32 height ALLOCATION_SITE_PARAMS )
 {
 	auto size = width * height;
-	auto p    = allocateArray( allocator, T, size );
+	auto p    = (T*)allocate( allocator, sizeof( T ) * size, alignof( T ) ALLOCATION_SITE_ARGS );
 	if( !p ) {
 		width  = 0;
 		height = 0;
@@ -45,10 +48,12 @@ Grid< T > makeGridImpl( StackAllocator* allocator, int32 width, int32 height )
 	return {p, width, height};
 }
 
-#define makeArray( allocator, type, size ) makeArrayImpl< type >( ( allocator ), ( size ) )
-#define makeUArray( allocator, type, size ) makeUArrayImpl< type >( ( allocator ), ( size ) )
+#define makeArray( allocator, type, size ) \
+	makeArrayImpl< type >( ( allocator ), ( size ) ALLOCATION_SITE )
+#define makeUArray( allocator, type, size ) \
+	makeUArrayImpl< type >( ( allocator ), ( size ) ALLOCATION_SITE )
 #define makeGrid( allocator, type, width, height ) \
-	makeGridImpl< type >( ( allocator ), ( width ), ( height ) )
+	makeGridImpl< type >( ( allocator ), ( width ), ( height ) ALLOCATION_SITE )
 
 // consume all available memory from stack allocator
 #define beginVector( allocator, type ) beginVector_< type >( ( allocator ) )
@@ -56,8 +61,20 @@ template < class T >
 UninitializedArray< T > beginVector_( StackAllocator* allocator )
 {
 	assert( isValid( allocator ) );
+#ifdef GAME_MEMORY_TRACKING
+	// the vector reserves all remaining memory, which would make high-water marks useless, so the
+	// reservation isn't recorded, endVector records the size that was actually used
+	auto peak      = allocator->peak;
+	auto framePeak = allocator->framePeak;
+	auto result    = makeUArrayImpl< T >(
+	    allocator, safe_truncate< int32 >( getCapacityFor< T >( allocator ) ), nullptr, 0 );
+	allocator->peak      = peak;
+	allocator->framePeak = framePeak;
+	return result;
+#else
 	return makeUArrayImpl< T >( allocator,
 	                            safe_truncate< int32 >( getCapacityFor< T >( allocator ) ) );
+#endif
 }
 
 // fit to size vector and give back unused memory to allocator, only works if v is the most recent
@@ -12,8 +12,10 @@ struct DoubleBits {
 		#define FLT_MAX 3.402823466e+38f         // max value
 		#define FLT_MIN 1.175494351e-38f         // min normalized positive value
 	#endif // COREFLOAT_NO_CRT
-	#define DBL_MAX 1.7976931348623158e+308  // max value
-	#define DBL_MIN 2.2250738585072014e-308  // min positive value
+	#ifndef DBL_MAX
+		#define DBL_MAX 1.7976931348623158e+308  // max value
+		#define DBL_MIN 2.2250738585072014e-308  // min positive value
+	#endif
 
 	#define FLT_POSITIVE_INF_BITS 0x7F800000u
 	#define FLT_NEGATIVE_INF_BITS 0xFF800000u
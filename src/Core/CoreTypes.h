@@ -4,7 +4,7 @@
 #define _CORETYPES_H_INCLUDED_
 
 struct null_t {
-	operator nullptr_t() const { return nullptr; }
+	operator std::nullptr_t() const { return nullptr; }
 };
 const null_t null;
 
@@ -4,6 +4,7 @@
 #define _INTEGERTYPES_H_INCLUDED_
 
 #include <cstdint>
+#include <cstddef>
 
 typedef int8_t int8;
 typedef uint8_t uint8;
@@ -17,7 +18,7 @@ typedef uint64_t uint64;
 // type of what is the fastest way to index into arrays and for loops
 typedef uint32 uintfast;
 
-typedef size_t uintptr;
+typedef uintptr_t uintptr;
 static_assert( sizeof( uintptr ) == sizeof( void* ), "pointer size mismatch" );
 
 #undef INTMAX_MIN
@@ -132,10 +132,10 @@ struct IntrusiveDoublyLinkedList {
 			tail  = entry;
 			count = 1;
 		} else {
-			auto prev   = tail;
-			prev->*next = entry;
+			auto last   = tail;
+			last->*next = entry;
 			tail        = entry;
-			tail->*prev = prev;
+			tail->*prev = last;
 			++count;
 		}
 	}
@@ -154,26 +154,26 @@ struct IntrusiveDoublyLinkedList {
 	T* erase( T* entry )
 	{
 		assert( entry );
-		auto prev = entry->*prev;
-		auto next = entry->*next;
-		if( prev ) {
-			prev->*next = next;
+		auto before = entry->*prev;
+		auto after  = entry->*next;
+		if( before ) {
+			before->*next = after;
 		}
-		if( next ) {
-			next->*prev = prev;
+		if( after ) {
+			after->*prev = before;
 		}
 		if( entry == head ) {
 			assert( head->*prev == nullptr );
-			head = next;
+			head = after;
 			assert( !head || head->*prev == nullptr );
 		}
 		if( entry == tail ) {
 			assert( tail->*next == nullptr );
-			tail = prev;
+			tail = before;
 			assert( !tail || tail->*next == nullptr );
 		}
 		--count;
-		return next;
+		return after;
 	}
 
 	IntrusiveLinkedListIterator< T > begin() { return {head}; }
@@ -184,11 +184,11 @@ struct IntrusiveDoublyLinkedList {
 	IntrusiveLinkedListIterator< const T > cend() const { return {nullptr}; }
 };
 
-template < class T >
-IntrusiveLinkedList< T > makeLinkedList( T* node )
+template < class T, T* T::* const next = &T::next >
+IntrusiveLinkedList< T, next > makeLinkedList( T* node )
 {
-	IntrusiveLinkedList< T > result = {};
-	result.head                     = node;
+	IntrusiveLinkedList< T, next > result = {};
+	result.head                           = node;
 	while( node ) {
 		result.tail = node;
 		node        = node->*next;
@@ -196,11 +196,11 @@ IntrusiveLinkedList< T > makeLinkedList( T* node )
 	}
 	return result;
 }
-template < class T >
-IntrusiveLinkedList< T > makeDoublyLinkedList( T* node )
+template < class T, T* T::* const next = &T::next >
+IntrusiveLinkedList< T, next > makeDoublyLinkedList( T* node )
 {
-	IntrusiveLinkedList< T > result = {};
-	result.head                     = node;
+	IntrusiveLinkedList< T, next > result = {};
+	result.head                           = node;
 	while( node ) {
 		node = node->*next;
 		++result.count;
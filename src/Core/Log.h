@@ -38,7 +38,7 @@ void LOG_IMPL( int32 level, const char* format, const char* file, size_t line,
                const Types&... args );
 
 #define LOG( level, format, ... ) \
-	LOG_IMPL( ( level ), ( format ), __FILE__, __LINE__, __VA_ARGS__ )
+	LOG_IMPL( ( level ), ( format ), __FILE__, __LINE__, ##__VA_ARGS__ )
 
 #endif  // _LOG_H_INCLUDED_
 
@@ -73,8 +73,10 @@ void LOG_IMPL( int32 level, const char* format, const char* file, size_t line,
 				if( GlobalPlatformServices ) {
 					GlobalPlatformServices->outputDebugString( entry->message );
 				}
-#else
+#elif defined( _WIN32 )
 				OutputDebugStringA( entry->message );
+#else
+				fputs( entry->message, stderr );
 #endif
 			}
 		}
@@ -24,7 +24,11 @@
 #ifdef GAME_DEBUG
 	#define assert_m( x, msg ) assert( ( x ) && ( msg ) )
 	#define debug_error( x ) assert( 0 && ( x ) )
-	#define debug_break() __debugbreak()
+	#ifdef _MSC_VER
+		#define debug_break() __debugbreak()
+	#else
+		#define debug_break() __builtin_trap()
+	#endif
 
 	#if GAME_OUT_OF_MEMORY_ASSERTION
 		#define OutOfMemory() assert( 0 && "Out Of Memory" )
@@ -39,7 +43,7 @@
 	#define const_assert( x ) assert( x )
 	#define break_if( x )   \
 		if( x ) {           \
-			__debugbreak(); \
+			debug_break();  \
 		}
 #else
 	#define assert_m( x, msg ) ( (void)0 )
@@ -0,0 +1,85 @@
+// allocation tracking of StackAllocators, only compiled in with GAME_MEMORY_TRACKING
+// allocations record their call site (file and line) in a hash table, so that the memory each call
+// site uses can be reported
+// allocators that are registered with trackStackAllocator additionally get their high-water mark
+// recorded every frame
+
+#include <atomic>
+
+#define MAX_ALLOCATION_SITES ( 1024 )  // needs to be a power of two
+#define MAX_TRACKED_ALLOCATORS ( 16 )
+#define MAX_MEMORY_TRACKING_FRAMES ( 128 )
+
+struct AllocationSite {
+	const char* file;  // nullptr if the slot is unused
+	int32 line;
+	int32 count;           // allocations since the table was cleared
+	uint64 bytes;          // bytes since the table was cleared, including alignment padding
+	uint64 largest;        // biggest single allocation
+	uint64 frameBytes;     // bytes of the current frame
+	uint64 maxFrameBytes;  // most bytes allocated in a single frame
+};
+
+struct StackAllocator;
+struct TrackedAllocator {
+	const char* name;
+	StackAllocator* allocator;
+	size_t framePeaks[MAX_MEMORY_TRACKING_FRAMES];  // high-water marks of the last frames
+};
+
+struct MemoryTrackingTable {
+	std::atomic< int32 > lock;
+	int32 sitesCount;
+	int32 droppedAllocations;  // allocations of call sites that didn't fit into the table
+	AllocationSite sites[MAX_ALLOCATION_SITES];
+
+	TrackedAllocator allocators[MAX_TRACKED_ALLOCATORS];
+	int32 allocatorsCount;
+	int32 currentFrame;  // index into framePeaks of the next frame
+	int32 framesCount;   // number of recorded frames, at most MAX_MEMORY_TRACKING_FRAMES
+};
+
+global_var MemoryTrackingTable* GlobalMemoryTrackingTable = nullptr;
+
+static void lockMemoryTrackingTable( MemoryTrackingTable* table )
+{
+	int32 expected = 0;
+	while( !table->lock.compare_exchange_weak( expected, 1, std::memory_order_acquire ) ) {
+		expected = 0;
+	}
+}
+static void unlockMemoryTrackingTable( MemoryTrackingTable* table )
+{
+	table->lock.store( 0, std::memory_order_release );
+}
+
+// allocations without a call site are not recorded, they still count towards high-water marks
+static void recordAllocation( const char* file, int32 line, size_t size )
+{
+	auto table = GlobalMemoryTrackingTable;
+	if( !table || !file ) {
+		return;
+	}
+
+	lockMemoryTrackingTable( table );
+	// file strings are literals, so the pointer identifies the file
+	auto hash = ( (uintptr)file >> 3 ) * 31 + (uintptr)line;
+	for( auto i = 0; i < MAX_ALLOCATION_SITES; ++i ) {
+		auto site = &table->sites[( hash + i ) & ( MAX_ALLOCATION_SITES - 1 )];
+		if( !site->file ) {
+			site->file = file;
+			site->line = line;
+			++table->sitesCount;
+		}
+		if( site->file == file && site->line == line ) {
+			++site->count;
+			site->bytes += size;
+			site->frameBytes += size;
+			site->largest = max( site->largest, (uint64)size );
+			unlockMemoryTrackingTable( table );
+			return;
+		}
+	}
+	++table->droppedAllocations;
+	unlockMemoryTrackingTable( table );
+}
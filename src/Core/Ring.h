@@ -113,7 +113,6 @@ struct Ring {
 	typedef T* pointer;
 	typedef const T* const_pointer;
 	typedef int32 difference_type;
-	typedef int32 size_type;
 
 	iterator begin() const { return {ptr, first, cap}; }
 	iterator end() const {
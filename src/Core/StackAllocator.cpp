@@ -1,10 +1,124 @@
+#ifdef GAME_MEMORY_TRACKING
+	#include "MemoryTracking.h"
+
+	// allocation macros pass their call site to the allocation functions
+	#define ALLOCATION_SITE_PARAMS , const char* file = nullptr, int32 line = 0
+	#define ALLOCATION_SITE_ARGS , file, line
+	#define ALLOCATION_SITE , __FILE__, __LINE__
+#else
+	#define ALLOCATION_SITE_PARAMS
+	#define ALLOCATION_SITE_ARGS
+	#define ALLOCATION_SITE
+#endif
+
+// virtual memory functions of the platform, used by growable allocators
+// discard gives the physical memory of committed pages back to the os while keeping them
+// accessible, the range might contain pages that were never committed
+typedef void* ReserveMemoryType( size_t size );  // nullptr on failure
+typedef bool CommitMemoryType( void* ptr, size_t size );
+typedef void DiscardMemoryType( void* ptr, size_t size );
+typedef void ReleaseMemoryType( void* ptr, size_t size );
+
+struct VirtualMemoryServices {
+	ReserveMemoryType* reserve;
+	CommitMemoryType* commit;
+	DiscardMemoryType* discard;
+	ReleaseMemoryType* release;
+	size_t pageSize;  // power of two
+};
+
 struct StackAllocator {
 	char* ptr;
 	size_t size;
 	size_t capacity;
 	uint32 lastPoppedAlignment;
+	VirtualMemoryServices* virtualMemory;  // nullptr unless the allocator is growable
+	size_t committed;  // [ptr, ptr + committed) is accessible, only grows
+	size_t resident;   // high-water mark of size since memory was last discarded
+#ifdef GAME_MEMORY_TRACKING
+	size_t peak;       // high-water mark of size
+	size_t framePeak;  // high-water mark of size since the frame began
+#endif
 };
 
+#ifdef GAME_MEMORY_TRACKING
+	static void updatePeak( StackAllocator* allocator )
+	{
+		allocator->peak      = max( allocator->peak, allocator->size );
+		allocator->framePeak = max( allocator->framePeak, allocator->size );
+	}
+#endif
+
+/*
+growable allocators reserve their capacity as address space up front and commit it in steps as size
+grows, so that memory is only used once it is needed
+when size is rolled back by clear, TemporaryMemoryGuard, StackAllocatorGuard or
+StackAllocatorPartition and at least StackAllocatorDiscardThreshold bytes above size were used, the
+pages above size are discarded, which gives the physical memory back to the os
+pages are never decommitted, so that a stale copy of the allocator (like one restored from a memory
+snapshot) never accesses memory that isn't committed
+*/
+const size_t StackAllocatorCommitSize       = kilobytes( 64 );
+const size_t StackAllocatorDiscardThreshold = megabytes( 1 );
+
+static uintptr alignVirtualMemoryDown( uintptr address, size_t alignment )
+{
+	assert( alignment && ( alignment & ( alignment - 1 ) ) == 0 );
+	return address & ~( (uintptr)alignment - 1 );
+}
+static uintptr alignVirtualMemoryUp( uintptr address, size_t alignment )
+{
+	return alignVirtualMemoryDown( address + alignment - 1, alignment );
+}
+
+// makes sure that [ptr, ptr + size) is committed, size must not exceed capacity
+static bool commitStackAllocator( StackAllocator* allocator, size_t size )
+{
+	assert( allocator->virtualMemory );
+	assert( size <= allocator->capacity );
+	if( size > allocator->committed ) {
+		auto virtualMemory = allocator->virtualMemory;
+		auto granularity   = max( StackAllocatorCommitSize, virtualMemory->pageSize );
+		auto ptr           = (uintptr)allocator->ptr;
+		// partitions don't start at page boundaries, the pages they share are committed twice
+		auto first = alignVirtualMemoryDown( ptr + allocator->committed, virtualMemory->pageSize );
+		auto last  = min( alignVirtualMemoryUp( ptr + size, granularity ),
+		                  alignVirtualMemoryUp( ptr + allocator->capacity, virtualMemory->pageSize ) );
+		if( !virtualMemory->commit( (void*)first, (size_t)( last - first ) ) ) {
+			return false;
+		}
+		allocator->committed = min( (size_t)( last - ptr ), allocator->capacity );
+	}
+	allocator->resident = max( allocator->resident, size );
+	return true;
+}
+// discards the pages above size if enough memory is unused
+static void shrinkStackAllocator( StackAllocator* allocator )
+{
+	auto virtualMemory = allocator->virtualMemory;
+	if( !virtualMemory || allocator->resident < allocator->size + StackAllocatorDiscardThreshold ) {
+		return;
+	}
+	// only whole pages inside of [size, resident) are discarded, the pages at the boundaries might
+	// still be in use
+	auto ptr   = (uintptr)allocator->ptr;
+	auto first = alignVirtualMemoryUp( ptr + allocator->size, virtualMemory->pageSize );
+	auto last  = alignVirtualMemoryDown( ptr + allocator->resident, virtualMemory->pageSize );
+	if( first < last ) {
+		virtualMemory->discard( (void*)first, (size_t)( last - first ) );
+	}
+	allocator->resident = allocator->size;
+}
+// takes over committed and resident memory of a growable allocator that was carved out of
+// allocator, so that it is discarded once allocator is rolled back
+static void mergeStackAllocator( StackAllocator* allocator, StackAllocator* other )
+{
+	assert( allocator->virtualMemory == other->virtualMemory );
+	auto offset          = (size_t)( other->ptr - allocator->ptr );
+	allocator->committed = max( allocator->committed, offset + other->committed );
+	allocator->resident  = max( allocator->resident, offset + other->resident );
+}
+
 char* back( StackAllocator* allocator )
 {
 	return allocator->ptr + allocator->size;
@@ -43,6 +157,7 @@ void clear( StackAllocator* allocator )
 {
 	allocator->size = 0;
 	allocator->lastPoppedAlignment = 1;
+	shrinkStackAllocator( allocator );
 }
 size_t remaining( StackAllocator* allocator )
 {
@@ -61,7 +176,7 @@ size_t remaining( StackAllocator* allocator, uint32 alignment )
 	return result;
 }
 
-void* allocate( StackAllocator* allocator, size_t size, uint32 alignment )
+void* allocate( StackAllocator* allocator, size_t size, uint32 alignment ALLOCATION_SITE_PARAMS )
 {
 	assert( allocator );
 	assert( allocator->ptr );
@@ -72,11 +187,20 @@ void* allocate( StackAllocator* allocator, size_t size, uint32 alignment )
 		OutOfMemory();
 		return nullptr;
 	}
+	if( allocator->virtualMemory
+	    && !commitStackAllocator( allocator, allocator->size + offset + size ) ) {
+		OutOfMemory();
+		return nullptr;
+	}
 
 	auto result = back( allocator ) + offset;
 	allocator->size += offset + size;
 	assert_alignment( result, alignment );
 	allocator->lastPoppedAlignment = 1;
+#ifdef GAME_MEMORY_TRACKING
+	updatePeak( allocator );
+	recordAllocation( file, line, offset + size );
+#endif
 	return result;
 }
 void* reallocate( StackAllocator* allocator, void* ptr, size_t newSize, size_t oldSize,
@@ -85,7 +209,15 @@ void* reallocate( StackAllocator* allocator, void* ptr, size_t newSize, size_t o
 	assert( isValid( allocator ) );
 	assert( ptr );
 	if( isBack( allocator, ptr, oldSize ) ) {
+		if( allocator->virtualMemory && newSize > oldSize
+		    && !commitStackAllocator( allocator, allocator->size + newSize - oldSize ) ) {
+			OutOfMemory();
+			return nullptr;
+		}
 		allocator->size += newSize - oldSize;
+#ifdef GAME_MEMORY_TRACKING
+		updatePeak( allocator );
+#endif
 		return ptr;
 	} else if( newSize < oldSize ) {
 		// no reallocation needed
@@ -104,7 +236,14 @@ bool reallocateInPlace( StackAllocator* allocator, void* ptr, size_t newSize, si
 	assert( isValid( allocator ) );
 	assert( ptr );
 	if( isBack( allocator, ptr, oldSize ) ) {
+		if( allocator->virtualMemory && newSize > oldSize
+		    && !commitStackAllocator( allocator, allocator->size + newSize - oldSize ) ) {
+			return false;
+		}
 		allocator->size += newSize - oldSize;
+#ifdef GAME_MEMORY_TRACKING
+		updatePeak( allocator );
+#endif
 		return true;
 	}
 	return false;
@@ -120,22 +259,52 @@ void free( StackAllocator* allocator, void* ptr, size_t size, uint32 alignment )
 }
 
 #define allocateStruct( allocator, type ) \
-	( type* ) allocate( ( allocator ), sizeof( type ), alignof( type ) )
+	( type* ) allocate( ( allocator ), sizeof( type ), alignof( type ) ALLOCATION_SITE )
 #define allocateArray( allocator, type, count ) \
-	( type* ) allocate( ( allocator ), sizeof( type ) * ( count ), alignof( type ) )
-#define maxAllocateArray( allocator, type ) \
-	( type* )allocate( ( allocator ), remaining( allocator, alignof( type ) ) / sizeof( type ) )
+	( type* ) allocate( ( allocator ), sizeof( type ) * ( count ), alignof( type ) ALLOCATION_SITE )
+#define maxAllocateArray( allocator, type )                                                     \
+	( type* )allocate( ( allocator ), remaining( allocator, alignof( type ) ) / sizeof( type ), \
+	                   alignof( type ) ALLOCATION_SITE )
 #define freeStruct( allocator, ptr ) \
 	free( ( allocator ), ptr, sizeof( *( ptr ) ), alignof( typeof( *( ptr ) ) ) )
 
-StackAllocator makeStackAllocator( StackAllocator* allocator, size_t capacity )
+StackAllocator makeStackAllocator_( StackAllocator* allocator,
+                                    size_t capacity ALLOCATION_SITE_PARAMS )
 {
-	return {allocateArray( allocator, char, capacity ), 0, capacity, 1};
+	return {(char*)allocate( allocator, capacity, 1 ALLOCATION_SITE_ARGS ), 0, capacity, 1};
 }
-StackAllocator makeStackAllocator( void* ptr, size_t capacity )
+StackAllocator makeStackAllocator_( void* ptr, size_t capacity ALLOCATION_SITE_PARAMS )
 {
 	return {(char*)ptr, 0, capacity, 1};
 }
+#define makeStackAllocator( allocator, capacity ) \
+	makeStackAllocator_( ( allocator ), ( capacity ) ALLOCATION_SITE )
+
+// reserves capacity rounded up to StackAllocatorCommitSize, nothing is committed until allocated
+// allocators made from a growable allocator with makeStackAllocator are committed completely,
+// partitions made with StackAllocatorPartition are growable themselves
+StackAllocator makeGrowableStackAllocator( VirtualMemoryServices* virtualMemory, size_t capacity )
+{
+	assert( virtualMemory );
+	StackAllocator result = {};
+	auto granularity      = max( StackAllocatorCommitSize, virtualMemory->pageSize );
+	capacity              = (size_t)alignVirtualMemoryUp( capacity, granularity );
+	if( auto ptr = virtualMemory->reserve( capacity ) ) {
+		result.ptr           = (char*)ptr;
+		result.capacity      = capacity;
+		result.virtualMemory = virtualMemory;
+	}
+	result.lastPoppedAlignment = 1;
+	return result;
+}
+void releaseGrowableStackAllocator( StackAllocator* allocator )
+{
+	assert( allocator );
+	if( allocator->virtualMemory && allocator->ptr ) {
+		allocator->virtualMemory->release( allocator->ptr, allocator->capacity );
+	}
+	*allocator = {};
+}
 
 template< class T >
 size_t getCapacityFor( StackAllocator* allocator )
@@ -158,6 +327,7 @@ struct TemporaryMemoryGuard {
 	{
 		allocator->size                = size;
 		allocator->lastPoppedAlignment = lastPoppedAlignment;
+		shrinkStackAllocator( allocator );
 	}
 };
 
@@ -215,6 +385,7 @@ struct StackAllocatorPartition {
 	StackAllocator* allocator = nullptr;
 	StackAllocator prim = {};
 	size_t oldSize = 0;
+	size_t oldCommitted = 0;
 	uint32 lastPoppedAlignment = 1;
 
 	StackAllocator* primary() { return &prim; }
@@ -225,6 +396,7 @@ struct StackAllocatorPartition {
 	: allocator( other.allocator ),
 	  prim( other.prim ),
 	  oldSize( other.oldSize ),
+	  oldCommitted( other.oldCommitted ),
 	  lastPoppedAlignment( other.lastPoppedAlignment )
 	{
 		other.allocator = nullptr;
@@ -236,6 +408,9 @@ struct StackAllocatorPartition {
 			assert( end( &prim ) <= back( allocator ) );
 			allocator->size = oldSize;
 			allocator->lastPoppedAlignment = lastPoppedAlignment;
+			if( allocator->virtualMemory ) {
+				mergePartition();
+			}
 		}
 	}
 
@@ -246,16 +421,48 @@ struct StackAllocatorPartition {
 		result.allocator               = allocator;
 		auto remainingSize             = remaining( allocator );
 		auto primSize                  = remainingSize - ( remainingSize / ( primaryRatio + 1 ) );
-		result.prim                    = makeStackAllocator( allocator, primSize );
 		result.lastPoppedAlignment     = allocator->lastPoppedAlignment;
+		if( allocator->virtualMemory ) {
+			// committing the primary allocator up front would commit most of the reservation, so
+			// it is carved out uncommitted and grows on its own
+			// allocations from the scrap allocator commit from the end of the primary allocator
+			result.oldCommitted = allocator->committed;
+			auto prim           = &result.prim;
+			prim->ptr           = back( allocator );
+			prim->capacity      = primSize;
+			prim->virtualMemory = allocator->virtualMemory;
+			prim->committed     = ( allocator->committed > allocator->size )
+			                          ? ( allocator->committed - allocator->size )
+			                          : ( 0 );
+			prim->lastPoppedAlignment = 1;
+			allocator->size += primSize;
+			allocator->committed = max( allocator->committed, allocator->size );
+		} else {
+			result.prim = makeStackAllocator( allocator, primSize );
+		}
 		return result;
 	}
 
+	// committed memory past the primary allocator isn't contiguous, only the committed memory
+	// of the primary allocator is kept track of
+	void mergePartition()
+	{
+		allocator->committed = oldCommitted;
+		mergeStackAllocator( allocator, &prim );
+		shrinkStackAllocator( allocator );
+	}
+
 	void commit()
 	{
 		assert( end( &prim ) <= back( allocator ) );
 		allocator->size                = back( &prim ) - begin( allocator );
 		allocator->lastPoppedAlignment = prim.lastPoppedAlignment;
+		if( allocator->virtualMemory ) {
+			mergePartition();
+		}
+#ifdef GAME_MEMORY_TRACKING
+		updatePeak( allocator );
+#endif
 		allocator                      = nullptr;
 	}
 };
@@ -271,7 +478,16 @@ struct StackAllocatorGuard {
 	~StackAllocatorGuard()
 	{
 		if( allocator ) {
-			*allocator = state;
+#ifdef GAME_MEMORY_TRACKING
+			// high-water marks survive the rollback
+			state.peak      = allocator->peak;
+			state.framePeak = allocator->framePeak;
+#endif
+			// memory committed since then stays committed
+			state.committed = allocator->committed;
+			state.resident  = allocator->resident;
+			*allocator      = state;
+			shrinkStackAllocator( allocator );
 		}
 	}
 
@@ -29,11 +29,7 @@ struct short_string : string {
 		cap = N;
 	}
 	short_string( const short_string& other ) : short_string() { assign( other ); }
-	short_string( StringView other ) : short_string()
-	{
-		assign( other );
-		return *this;
-	}
+	short_string( StringView other ) : short_string() { assign( other ); }
 	short_string& operator=( const short_string& other )
 	{
 		assign( other );
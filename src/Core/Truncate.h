@@ -3,10 +3,12 @@
 #ifndef _TRUNCATE_H_INCLUDED_
 #define _TRUNCATE_H_INCLUDED_
 
-#pragma warning( push )
-// warning C4127: conditional expression is constant
-// if constexpr not a thing yet
-#pragma warning( disable: 4127 )
+#if defined( _MSC_VER )
+	#pragma warning( push )
+	// warning C4127: conditional expression is constant
+	// if constexpr not a thing yet
+	#pragma warning( disable: 4127 )
+#endif
 
 template < class ReturnType, class ValueType >
 inline constexpr ReturnType safe_truncate( ValueType val )
@@ -25,7 +27,9 @@ inline constexpr ReturnType safe_truncate( ValueType val )
 	return static_cast< ReturnType >( val );
 }
 
-#pragma warning( pop )
+#if defined( _MSC_VER )
+	#pragma warning( pop )
+#endif
 
 // deduced version of safe truncate, so that the return type does not have to be repeated
 // motivation of this method is to say "truncate implicitly, but make sure at runtime that
@@ -152,6 +152,10 @@ struct Utf8Sequence {
 
 Utf8Sequence toUtf8( uint32 codepoint );
 int32 convertUtf16ToUtf8( const uint16* utf16Start, int32 utf16Length, char* out, int32 size );
+#if !defined( UNICODE_NO_WCHAR_T_OVERLOAD ) && !defined( _WIN32 )
+	// wchar_t is utf-32 outside of windows
+	#define UNICODE_NO_WCHAR_T_OVERLOAD
+#endif
 #ifndef UNICODE_NO_WCHAR_T_OVERLOAD
 	inline int32 convertUtf16ToUtf8( const wchar_t* utf16Start, int32 utf16Length, char* out,
                                      int32 size )
@@ -1,7 +1,9 @@
 #define GAME_RENDER_DEBUG_OUTPUT 0
 #define GAME_RENDER_SKELETON_NODES 0
 #define GAME_DEBUG_PRINTING 1
-#define NO_PROFILING
+#ifndef GAME_PROFILING
+	#define NO_PROFILING
+#endif
 #define GAME_OUT_OF_MEMORY_ASSERTION 0
 #define GAME_BREAK_ON_ERROR_LOG 1
 
@@ -988,7 +988,6 @@ void openAnimation( AnimatorState* animator, AnimatorAnimation* animation )
 
 	populateVisibleGroups( animator );
 
-	animator->keyframes.end();
 	animator->keyframes.reserve( animation->keyframes.size() );
 	FOR( keyframe : animation->keyframes ) {
 		if( keyframe.data.type != AnimatorKeyframeData::type_event ) {
@@ -2439,7 +2438,6 @@ void changeModelSpace( AnimatorNode* node, mat4arg model )
 		node->translation   = localBase;
 		auto toYawPitchRoll = [&]( vec3arg d, vec3arg oldRotation ) -> vec3 {
 			vec3 result = oldRotation;
-			auto xAxis = row( model, 0 ).xyz;
 			auto yAxis = row( model, 1 ).xyz;
 			auto zAxis = row( model, 2 ).xyz;
 			if( !floatEqZero( d.x ) || !floatEqZero( d.y ) ) {
@@ -3491,7 +3489,6 @@ AnimatorProjection animatorSetProjection( AppData* app, GameInputs* inputs, rect
 	auto animator = &app->animatorState;
 	auto editor   = &animator->editor;
 	auto renderer = &app->renderer;
-	auto handle   = imguiMakeHandle( editor, ImGuiControlType::None );
 	if( editor->viewType == AnimatorEditorViewType::Perspective ) {
 		auto projection = matrixPerspectiveFovProjection( rect, app->width, app->height,
 		                                                  degreesToRadians( 65 ), -1, 1 );
@@ -3892,7 +3889,6 @@ void doHitboxEditor( AppData* app, GameInputs* inputs, rectfarg rect )
 	auto renderer = &app->renderer;
 	auto animator = &app->animatorState;
 	auto editor   = &animator->editor;
-	auto handle   = imguiMakeHandle( editor, ImGuiControlType::None );
 
 	auto projection = animatorSetProjection( app, inputs, rect );
 	setScissorRect( renderer, Rect< int32 >( rect ) );
@@ -4129,7 +4125,11 @@ void doAnimator( AppData* app, GameInputs* inputs, bool focus, float dt )
 		*gui = defaultImmediateModeGui();
 		imguiLoadDefaultStyle( gui, &app->platform, font );
 
-		animator->controlIcons = app->platform.loadTexture( "Data/Images/animator_controls.png" );
+		// textures load in the background, they are uploaded at the beginning of a later frame
+		const StringView controlsFilename = "Data/Images/animator_controls.png";
+		if( !requestTexture( &app->assetLoader, controlsFilename, &animator->controlIcons ) ) {
+			animator->controlIcons = app->platform.loadTexture( controlsFilename );
+		}
 
 		animator->editor.contextMenu = imguiGenerateContainer( gui, {}, ImGuiVisibility::Hidden );
 		animator->fileMenu           = imguiGenerateContainer( gui, {}, ImGuiVisibility::Hidden );
@@ -4139,13 +4139,14 @@ void doAnimator( AppData* app, GameInputs* inputs, bool focus, float dt )
 		animator->messageBox.container =
 		    imguiGenerateContainer( gui, {0, 0, 300, 10}, ImGuiVisibility::Hidden );
 
-		auto allocator                   = &app->stackAllocator;
-		const auto MaxNodes              = 10;
-		const auto MaxKeyframes          = 50;
-		const auto MaxAnimations         = 20;
-		animator->stringPool             = makeStringPool( allocator, 100 );
-		animator->particleSystem         = makeParticleSystem( allocator, 200 );
-		animator->particleSystem.texture = app->platform.loadTexture( "Data/Images/dust.png" );
+		auto allocator           = &app->stackAllocator;
+		animator->stringPool     = makeStringPool( allocator, 100 );
+		animator->particleSystem = makeParticleSystem( allocator, 200 );
+		const StringView dustFilename = "Data/Images/dust.png";
+		if( !requestTexture( &app->assetLoader, dustFilename,
+		                     &animator->particleSystem.texture ) ) {
+			animator->particleSystem.texture = app->platform.loadTexture( dustFilename );
+		}
 
 		animator->fieldNames[0] = pushString( &animator->stringPool, "Translation" );
 		animator->fieldNames[1] = pushString( &animator->stringPool, "Rotation" );
@@ -5,6 +5,23 @@ const float MinScale     = 0;
 const float MaxScale     = 1;
 const char* const Filter = "Room\0*.room\0All\0*.*\0";
 
+// occupancy of every layer is carved out of the storage in pool
+static TileOccupancy makeTileOccupancy( TilesPool* pool, int32 layer, int32 width, int32 height )
+{
+	auto wordsPerLayer = MaxHeight * ( ( MaxWidth + 31 ) / 32 );
+	auto bits          = pool->occupancyBits + layer * wordsPerLayer;
+	auto rects         = pool->occupancyRects + layer * MaxTiles;
+	auto rectIds       = pool->occupancyRectIds + layer * MaxTiles;
+
+	TileOccupancy result = {};
+	result.bits          = makeGridView( bits, ( width + 31 ) / 32, height );
+	result.rects         = makeUninitializedArrayView( rects, width * height );
+	result.rectIds       = makeGridView( rectIds, width, height );
+	zeroMemory( result.bits.data(), result.bits.size() );
+	zeroMemory( result.rectIds.data(), result.rectIds.size() );
+	return result;
+}
+
 Room toRoom( TilesPool* pool, View* view )
 {
 	Room result    = {};
@@ -20,6 +37,9 @@ Room toRoom( TilesPool* pool, View* view )
 			copy( dest->grid.ptr + y * src->width, src->data + y * MaxWidth, src->width );
 		}
 		data += src->width * src->height;
+
+		dest->occupancy = makeTileOccupancy( pool, i, src->width, src->height );
+		updateTileOccupancy( &dest->occupancy, dest->grid );
 	}
 	return result;
 }
@@ -27,8 +47,10 @@ Room makeRoom( TilesPool* pool, int32 width, int32 height )
 {
 	Room result = {};
 	auto data   = pool->data;
-	FOR( layer : result.layers ) {
-		layer.grid = makeGridView( data, width, height );
+	for( auto i = 0; i < RL_Count; ++i ) {
+		auto layer       = &result.layers[i];
+		layer->grid      = makeGridView( data, width, height );
+		layer->occupancy = makeTileOccupancy( pool, i, width, height );
 		data += width * height;
 	}
 	return result;
@@ -70,8 +92,7 @@ void setUnsavedChanges( View* view )
 
 void save( State* editor, View* view, StringView filename )
 {
-	auto allocator = GlobalScrap;
-	TEMPORARY_MEMORY_BLOCK( allocator ) {
+	SCRATCH_MEMORY_BLOCK( allocator ) {
 		auto room = toRoom( &editor->tilePool, view );
 		if( !room.tileSet ) {
 			LOG( ERROR, "Can't save file {}: No tile set defined", filename );
@@ -95,8 +116,7 @@ void save( State* editor, View* view, StringView filename )
 }
 void load( State* editor, View* view, StringView filename )
 {
-	auto allocator = GlobalScrap;
-	TEMPORARY_MEMORY_BLOCK( allocator ) {
+	SCRATCH_MEMORY_BLOCK( allocator ) {
 		auto data = readFile( allocator, filename );
 		if( data.size() ) {
 			auto reader = makeMemoryReader( data.data(), data.size() );
@@ -256,7 +276,11 @@ void playRoom( AppData* app, View* view )
 		auto position = gridPosToEntityPos( entity.position );
 		auto handle   = addEntityHandle( &game->entityHandles );
 		assert( entity.type != Entity::type_none );
-		addEntity( &game->entitySystem, &game->skeletonSystem, handle, entity.type, position );
+		if( handle
+		    && !addEntity( &game->entitySystem, &game->skeletonSystem, handle, entity.type,
+		                   position ) ) {
+			removeEntityHandle( &game->entityHandles, handle );
+		}
 	}
 
 	app->focus = AppFocus::Game;
@@ -345,7 +369,7 @@ void doSidebar( AppData* app, GameInputs* inputs, rectfarg rect )
 		} else {
 			imguiText( "Entities" );
 			auto listboxSize = imguiSize( imgui::Ratio{1}, imgui::Absolute{100} );
-			if( auto tileSet = view->tileSet ) {
+			if( view->tileSet ) {
 				auto listboxHandle = imguiMakeHandle( &editor->entitiesScrollPos );
 				int32 index        = view->placingEntity;
 				auto listboxRect   = imguiAddItem( listboxSize.width, listboxSize.height );
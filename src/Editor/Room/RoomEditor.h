@@ -9,6 +9,9 @@ const int32 MaxTiles  = MaxWidth * MaxHeight;
 
 struct TilesPool {
 	GameTile data[RL_Count * MaxTiles];
+	uint32 occupancyBits[RL_Count * MaxHeight * ( ( MaxWidth + 31 ) / 32 )];
+	recti occupancyRects[RL_Count * MaxTiles];
+	int32 occupancyRectIds[RL_Count * MaxTiles];
 };
 
 struct View {
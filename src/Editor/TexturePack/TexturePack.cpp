@@ -155,7 +155,7 @@ bool doTextureDisplay( AppData* app, TexturePackSource* source )
 						}
 						FOR( frame : makeArrayView( textureMap.frames, textureMap.framesCount ) ) {
 							frame.source = sourceIndex;
-							for( auto i = 0; i < VF_Count; ++i ) {
+							for( uint32 i = 0; i < VF_Count; ++i ) {
 								if( textureMap.bulkModeItems[i].selected ) {
 									auto face = &frame.faces[i];
 									if( auto prev =
@@ -182,7 +182,7 @@ bool doTextureDisplay( AppData* app, TexturePackSource* source )
 								continue;
 							}
 							frame.source = sourceIndex;
-							for( auto i = 0; i < VF_Count; ++i ) {
+							for( uint32 i = 0; i < VF_Count; ++i ) {
 								auto item = &frame.textureMapItems[i];
 								if( item->selected ) {
 									auto face = &frame.faces[i];
@@ -689,7 +689,7 @@ void texturePackLoad( AppData* app )
 				auto destFrame = &dest->frames[i];
 				copy( destFrame->textureMapItems, entries, countof( destFrame->textureMapItems ) );
 
-				for( auto j = 0; j < VF_Count; ++j ) {
+				for( uint32 j = 0; j < VF_Count; ++j ) {
 					auto face = frame[VoxelFaceStrings[j]].getObject();
 					if( !face ) {
 						continue;
@@ -751,7 +751,7 @@ void texturePackSave( AppData* app )
 				writeStartArray( &writer );
 					FOR( frame : makeArrayView( textureMap.frames, textureMap.framesCount ) ) {
 						writeStartObject( &writer );
-						for( auto i = 0; i < VF_Count; ++i ) {
+						for( uint32 i = 0; i < VF_Count; ++i ) {
 							writePropertyName( &writer, VoxelFaceStrings[i] );
 
 					        auto face          = &frame.faces[i];
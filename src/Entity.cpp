@@ -1,26 +1,106 @@
+// handles are generational: the lower bits are the slot + 1, the upper bits the generation of the
+// slot, slots are reused after their handle was removed with the next generation, so that stale
+// handles never compare equal to handles that were added later
+const uint32 EntityHandleSlotBits = 16;
+const uint32 EntityHandleSlotMask = ( 1u << EntityHandleSlotBits ) - 1;
+
 struct EntityHandle {
 	uint32 bits;
 
-	inline uint32 index() { return bits - 1; }
+	inline int32 index() const { return (int32)( bits & EntityHandleSlotMask ) - 1; }
+	inline uint16 generation() const { return (uint16)( bits >> EntityHandleSlotBits ); }
 	inline explicit operator bool() const { return bits != 0; }
 	inline bool operator==( EntityHandle other ) const { return bits == other.bits; }
 	inline bool operator!=( EntityHandle other ) const { return bits != other.bits; }
 };
 
 struct HandleManager {
-	// TODO: keep book about invalid entity handles, so that we can detect use after remove
-	uint32 ids;
+	Array< uint16 > generations;  // current generation of every slot
+	UArray< uint16 > freeSlots;   // used as a stack
 };
 
-HandleManager makeHandleManager()
+HandleManager makeHandleManager( StackAllocator* allocator, int32 maxCount )
 {
+	assert( maxCount > 0 && maxCount < (int32)EntityHandleSlotMask );
 	HandleManager result = {};
+	result.generations   = makeArray( allocator, uint16, maxCount );
+	result.freeSlots     = makeUArray( allocator, uint16, maxCount );
+	zeroMemory( result.generations.data(), result.generations.size() );
+	for( auto i = result.freeSlots.capacity() - 1; i >= 0; --i ) {
+		result.freeSlots.push_back( safe_truncate< uint16 >( i ) );
+	}
 	return result;
 }
+// returns an invalid handle if all slots are in use
 EntityHandle addEntityHandle( HandleManager* handles )
 {
 	assert( handles );
-	return {++handles->ids};
+	if( handles->freeSlots.empty() ) {
+		LOG( ERROR, "Too many entity handles" );
+		return {};
+	}
+	auto slot = handles->freeSlots.back();
+	handles->freeSlots.pop_back();
+	return {( (uint32)handles->generations[slot] << EntityHandleSlotBits ) | ( slot + 1u )};
+}
+// whether handle was added and wasn't removed yet
+bool isValid( const HandleManager* handles, EntityHandle handle )
+{
+	assert( handles );
+	auto slot = handle.index();
+	return slot >= 0 && slot < handles->generations.size()
+	       && handles->generations[slot] == handle.generation();
+}
+void removeEntityHandle( HandleManager* handles, EntityHandle handle )
+{
+	assert( isValid( handles, handle ) );
+	auto slot = safe_truncate< uint16 >( handle.index() );
+	++handles->generations[slot];
+	handles->freeSlots.push_back( slot );
+}
+void removeEntityHandles( HandleManager* handles, Array< EntityHandle > removed )
+{
+	FOR( handle : removed ) {
+		removeEntityHandle( handles, handle );
+	}
+}
+// removes all handles, they stay invalid since every generation is advanced
+void clearEntityHandles( HandleManager* handles )
+{
+	assert( handles );
+	handles->freeSlots.clear();
+	for( auto i = handles->generations.size() - 1; i >= 0; --i ) {
+		++handles->generations[i];
+		handles->freeSlots.push_back( safe_truncate< uint16 >( i ) );
+	}
+}
+
+// set of handles as a bitset over their slots, so that systems can test in O(1) whether their
+// components are removed
+// stale handles aren't added, only valid handles can share a slot with a component
+struct EntityHandleSet {
+	Array< uint32 > bits;
+
+	bool contains( EntityHandle handle ) const
+	{
+		auto slot = handle.index();
+		return slot >= 0 && slot / 32 < bits.size()
+		       && ( bits[slot / 32] & ( 1u << ( slot % 32 ) ) ) != 0;
+	}
+};
+EntityHandleSet makeEntityHandleSet( StackAllocator* allocator, const HandleManager* handles,
+                                     Array< EntityHandle > entries )
+{
+	EntityHandleSet result = {};
+	result.bits = makeArray( allocator, uint32, ( handles->generations.size() + 31 ) / 32 );
+	zeroMemory( result.bits.data(), result.bits.size() );
+	FOR( handle : entries ) {
+		if( isValid( handles, handle ) ) {
+			auto slot = handle.index();
+			result.bits[slot / 32] |= 1u << ( slot % 32 );
+		}
+	}
+	return result;
 }
 
 enum class SpatialState {
@@ -91,6 +171,10 @@ static const StringView EntityTypeNames[] = {
 // entity class, so now it is actually clear what this structure is: everything you need to know
 // about an entity is here
 // there are still "components", but for things that operate on entities as a whole, like controls
+// fields that only behavior code needs live in EntityDetails, so that the physics, hit detection
+// and render passes that iterate over all entities don't have to load them
+// fields that any pass over all entities reads, like hurtFlashCountdown, need to stay in Entity
+struct EntityDetails;
 struct Entity {
 	vec2 position;
 	vec2 velocity;
@@ -129,13 +213,11 @@ struct Entity {
 		uint8 invincible : 1;    // whether entity is invincible
 		uint8 deflects : 1;      // whether entity deflects projectiles
 	} flags;
-	EntityFaceDirection prevFaceDirection;
 	EntityFaceDirection faceDirection;
 	EntityTeam team;
-	EntityControl control;
-	vec2 hurtNormal;
 
 	Skeleton* skeleton;
+	EntityDetails* details;  // owned by the EntitySystem, doesn't move when entries move
 
 	enum Type {
 		type_none,
@@ -160,15 +242,41 @@ struct Entity {
 		enum : int8 { Idle, Moving, Turning, Stopping, Attacking, Hurt } state;
 		bool8 shouldTurn;
 	};
-	union {
-		Hero hero;
-		Wheels wheels;
-	};
 
 	bool walljumpLeft() const { return flags.walljumpLeft; }
 	bool dynamic() const { return flags.dynamic; }
 	bool dead() const { return flags.deathFlag; }
+
+	// accessors of details
+	EntityControl& control();
+	vec2& hurtNormal();
+	EntityFaceDirection& prevFaceDirection();
+	Hero& hero();
+	Wheels& wheels();
 };
+struct EntityDetails {
+	EntityControl control;
+	vec2 hurtNormal;
+	EntityFaceDirection prevFaceDirection;
+
+	union {
+		Entity::Hero hero;
+		Entity::Wheels wheels;
+	};
+};
+inline EntityControl& Entity::control() { return details->control; }
+inline vec2& Entity::hurtNormal() { return details->hurtNormal; }
+inline EntityFaceDirection& Entity::prevFaceDirection() { return details->prevFaceDirection; }
+inline Entity::Hero& Entity::hero()
+{
+	assert( type == type_hero );
+	return details->hero;
+}
+inline Entity::Wheels& Entity::wheels()
+{
+	assert( type == type_wheels );
+	return details->wheels;
+}
 static_assert( countof( EntityTypeNames ) == Entity::type_count, "Invalid EntityTypeNames" );
 
 void setSpatialState( Entity* collidable, SpatialState state )
@@ -202,19 +310,6 @@ bool isSpatialStateWalljumpable( Entity* collidable )
 	       == SpatialState::Airborne;
 }
 
-Entity* getDynamicFromCollidableRef( Array< Entity > dynamics, CollidableRef ref )
-{
-	assert( ref.type == CollidableRef::Dynamic );
-	assert( ref.index >= 0 );
-	if( ref.index < dynamics.size() ) {
-		auto candidate = &dynamics[ref.index];
-		if( candidate->handle == ref.handle ) {
-			return candidate;
-		}
-	}
-	auto handle = ref.handle;
-	return find_first_where( dynamics, entry.handle == handle );
-}
 float getFrictionCoefficitonFromCollidableRef( Array< Entity > dynamics, TileGrid grid,
                                                Array< TileInfo > infos, CollidableRef ref )
 {
@@ -263,6 +358,13 @@ rectf getBoundsFromCollidableRef( Array< Entity > dynamics, TileGrid grid,
 struct EntitySystem {
 	UArray< Entity > entries;
 	int32 entriesCount;  // count of entries that are not dynamic
+	// index into entries of every handle slot, -1 if there is no entity with a handle of the slot
+	// entries move when static entries are added or entries are removed, updateEntityIndices needs
+	// to be called afterwards
+	Array< int16 > indices;
+	// one per entry, an entity keeps its details while entries move
+	Array< EntityDetails > details;
+	UArray< int16 > freeDetails;  // indices of unused details
 
 	Array< Entity > staticEntries() const
 	{
@@ -273,12 +375,57 @@ struct EntitySystem {
 		return makeArrayView( entries.begin() + entriesCount, entries.end() );
 	}
 };
-EntitySystem makeEntitySystem( StackAllocator* allocator, int32 maxCount )
+// marks all details as unused, needs to be called when all entries are cleared
+void clearEntityDetails( EntitySystem* system )
 {
+	assert( system );
+	system->freeDetails.clear();
+	for( auto i = system->details.size() - 1; i >= 0; --i ) {
+		system->freeDetails.push_back( safe_truncate< int16 >( i ) );
+	}
+}
+// maxHandles is the maximum number of handles of the HandleManager that entities get handles from
+EntitySystem makeEntitySystem( StackAllocator* allocator, int32 maxCount, int32 maxHandles )
+{
+	assert( maxCount <= INT16_MAX );
 	EntitySystem result = {};
 	result.entries      = makeUArray( allocator, Entity, maxCount );
+	result.indices      = makeArray( allocator, int16, maxHandles );
+	result.details      = makeArray( allocator, EntityDetails, maxCount );
+	result.freeDetails  = makeUArray( allocator, int16, maxCount );
+	FOR( index : result.indices ) {
+		index = -1;
+	}
+	clearEntityDetails( &result );
+	return result;
+}
+// details are handed out from the front, entries can't outnumber them, since they have the same
+// capacity
+EntityDetails* allocateEntityDetails( EntitySystem* system )
+{
+	assert( system );
+	assert( system->freeDetails.size() );
+	auto index = system->freeDetails.back();
+	system->freeDetails.pop_back();
+	auto result = &system->details[index];
+	*result     = {};
 	return result;
 }
+void freeEntityDetails( EntitySystem* system, EntityDetails* details )
+{
+	assert( system );
+	assert( details >= system->details.begin() && details < system->details.end() );
+	system->freeDetails.push_back( safe_truncate< int16 >( details - system->details.begin() ) );
+}
+// updates indices of entries starting at first after entries moved
+void updateEntityIndices( EntitySystem* system, int32 first = 0 )
+{
+	assert( system );
+	for( auto i = first, count = system->entries.size(); i < count; ++i ) {
+		auto slot             = system->entries[i].handle.index();
+		system->indices[slot] = safe_truncate< int16 >( i );
+	}
+}
 
 namespace EntityTraitsFlags
 {
@@ -368,7 +515,32 @@ const EntityTraitsData* const getEntityTraits( Entity::Type type )
 struct SkeletonSystem;
 Entity* addEntity( EntitySystem* entitySystem, SkeletonSystem* skeletonSystem, EntityHandle handle,
                    Entity::Type type, vec2arg position = {} );
-Entity* findEntity( EntitySystem* system, EntityHandle handle )
+Entity* findEntity( const EntitySystem* system, EntityHandle handle )
+{
+	auto slot = handle.index();
+	if( slot >= 0 && slot < system->indices.size() && system->indices[slot] >= 0 ) {
+		auto entity = system->entries.begin() + system->indices[slot];
+		if( entity->handle == handle ) {
+			return entity;
+		}
+	}
+	return nullptr;
+}
+Entity* getDynamicFromCollidableRef( const EntitySystem* system, Array< Entity > dynamics,
+                                     CollidableRef ref )
 {
-	return find_first_where( system->entries, entry.handle == handle );
+	assert( ref.type == CollidableRef::Dynamic );
+	assert( ref.index >= 0 );
+	if( ref.index < dynamics.size() ) {
+		auto candidate = &dynamics[ref.index];
+		if( candidate->handle == ref.handle ) {
+			return candidate;
+		}
+	}
+	// dynamics moved since ref was set
+	auto result = findEntity( system, ref.handle );
+	if( result && result >= dynamics.begin() && result < dynamics.end() ) {
+		return result;
+	}
+	return nullptr;
 }
\ No newline at end of file
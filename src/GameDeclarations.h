@@ -5,6 +5,9 @@
 
 typedef TextureId LoadTextureType( StringView filename );
 typedef TextureId LoadTextureFromMemoryType( ImageData image );
+// takes ownership of an image returned by LoadImageToMemoryType, so that images can be decoded on
+// other threads and uploaded later, filename is used to cache the texture like LoadTextureType does
+typedef TextureId LoadTextureFromImageType( StringView filename, ImageData image );
 typedef void DeleteTextureType( TextureId id );
 typedef ImageData LoadImageToMemoryType( StringView filename );
 typedef void FreeImageDataType( ImageData* image );
@@ -23,8 +26,8 @@ typedef void DeleteShaderType( ShaderId shader );
 	#define MAX_PATH 260
 #endif
 typedef short_string< MAX_PATH > FilenameString;
-static const char* DefaultFilter = "All\0*.*\0";
-static const char* JsonFilter = "Json\0*.json\0All\0*.*\0";
+static const char* const DefaultFilter = "All\0*.*\0";
+static const char* const JsonFilter    = "Json\0*.json\0All\0*.*\0";
 
 typedef int32 GetOpenFilenameType( const char* filter, const char* initialDir, bool multiselect,
                                    char* filenameBuffer, int32 filenameBufferSize );
@@ -50,6 +53,7 @@ struct PlatformServices {
 	// graphics
 	LoadTextureType* loadTexture;
 	LoadTextureFromMemoryType* loadTextureFromMemory;
+	LoadTextureFromImageType* loadTextureFromImage;
 	DeleteTextureType* deleteTexture;
 	LoadImageToMemoryType* loadImageToMemory;
 	FreeImageDataType* freeImageData;
@@ -82,6 +86,12 @@ struct PlatformServices {
 	ReallocateType* reallocateInPlace;
 	FreeType* deallocate;
 
+	// virtual memory
+	VirtualMemoryServices virtualMemory;
+
+	// jobs
+	struct JobSystem* jobs;  // nullptr if the platform layer doesn't run job workers
+
 	// debug
 	OutputDebugStringType* outputDebugString;
 };
@@ -91,7 +101,10 @@ struct PlatformRemapInfo {
 	bool success;
 	IngameLog* logStorage;  // log structure for the platform layer to fill
 	string_logger* debugLogger;
-	TextureMap* textureMap;  // textureMap for the platform layer to fill
+	TextureMap* textureMap;                 // textureMap for the platform layer to fill
+	struct ProfilingTable* profilingTable;  // per thread profiling events of the last frames
+	// allocation call sites and high-water marks, nullptr unless built with GAME_MEMORY_TRACKING
+	struct MemoryTrackingTable* memoryTrackingTable;
 
 	int32 width;  // requested window size
 	int32 height;
@@ -125,6 +138,8 @@ struct PlatformInfo {
 	size_t mallocAllocated;
 	size_t mallocFree;
 	size_t mallocFootprint;
+
+	double microsecondsPerTick;  // converts rdtsc timestamps of profiling events to microseconds
 };
 
 #ifdef GAME_DLL
@@ -136,6 +151,13 @@ struct PlatformInfo {
 #define INITIALIZE_APP( name )           \
 	GAME_STORAGE PlatformRemapInfo name( \
 	    void* memory, size_t size, PlatformServices platformServices, PlatformInfo* platformInfo )
+// updateAndRender records into one of RENDER_COMMANDS_BUFFERS_COUNT command buffers in turn, so
+// the returned RenderCommands stay valid until updateAndRender was called
+// RENDER_COMMANDS_BUFFERS_COUNT - 1 more times, this way the platform layer can draw a frame while
+// the next one is updated
+// the platform layer has to finish drawing before it changes resources (textures, meshes) or
+// reinitializes game memory
+#define RENDER_COMMANDS_BUFFERS_COUNT ( 2 )
 #define UPDATE_AND_RENDER( name )                                                       \
 	GAME_STORAGE struct RenderCommands* name( void* memory, struct GameInputs* inputs,  \
 	                                          struct GameInputs* fixedInputs, float dt, \
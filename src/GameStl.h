@@ -8,6 +8,7 @@
 #include <limits>
 #include <algorithm>
 #include <functional>
+#include <utility>
 using std::pair;
 using std::begin;
 using std::end;
@@ -32,5 +33,12 @@ using std::less;
 using std::less_equal;
 using std::greater;
 using std::greater_equal;
+// msvc puts the float overloads into the global namespace, libstdc++ only has them in std
+using std::floor;
+using std::ceil;
+using std::round;
+using std::fmod;
+using std::abs;
+using std::signbit;
 
 #endif // _GAMESTL_H_INCLUDED_
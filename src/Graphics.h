@@ -871,6 +871,17 @@ void addRenderCommandMesh( RenderCommands* renderCommands, const Mesh& mesh )
 	body->mesh = mesh;
 	body->size = 0;
 }
+// copies mesh into the command stream, needed for meshes that change before the frame is drawn
+RenderCommandMesh* addRenderCommandMeshCopy( RenderCommands* renderCommands, const Mesh& mesh )
+{
+	PROFILE_FUNCTION();
+
+	auto body = addRenderCommandMeshImpl< RenderCommandMesh >( renderCommands, mesh.verticesCount,
+	                                                           mesh.indicesCount );
+	copy( body->mesh.vertices, mesh.vertices, body->mesh.verticesCount );
+	copy( body->mesh.indices, mesh.indices, body->mesh.indicesCount );
+	return body;
+}
 RenderCommandMesh* addRenderCommandMeshTransformed( RenderCommands* renderCommands,
                                                     const Mesh& mesh )
 {
@@ -444,7 +444,7 @@ void imguiClear()
 		ImGui->hoverContainer = ImGui->capture.container;
 	} else {
 		ImGui->hoverContainer = -1;
-		if( auto font = ImGui->font ) {
+		if( ImGui->font ) {
 			int8 z = -1;
 			for( auto i = 0, count = ImGui->containersCount; i < count; ++i ) {
 				auto container = &ImGui->containers[i];
@@ -2180,7 +2180,6 @@ bool imguiCombo( ImGuiHandle handle, const void* items, int32 entrySize, int32 i
 	auto buttonRect  = RectSetLeft( inner, inner.right - buttonWidth - style->innerPadding * 2 );
 	buttonRect = alignCenter( buttonRect, buttonWidth, ::height( style->rects[ComboButton] ) );
 
-	auto textRect             = imguiInnerRect( RectSetRight( inner, buttonRect.left ) );
 	ImGuiComboboxState* state = nullptr;
 
 	// we will treat children being focused as the combobox being focused
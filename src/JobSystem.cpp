@@ -0,0 +1,288 @@
+// work stealing job system
+// every worker has a lock-free deque (Chase-Lev): the owning worker pushes and pops jobs at the
+// bottom, idle workers steal from the top
+// jobs are referenced by pointer, their storage needs to outlive the wait on their counter
+// the platform layer creates the worker threads (platform/common/JobWorkers.cpp) and passes the
+// system to the game in PlatformServices, the thread that initialized the system is worker 0 and
+// runs jobs while it waits on counters
+// background jobs (asset loading) can take longer than a frame, they are pushed by worker 0 into
+// their own deque that only the other workers steal from, so that worker 0 never picks one up
+// while it waits inside of a frame
+// background jobs run game code, the platform layer calls waitForBackgroundJobs before the game
+// dll is unloaded or game memory is restored
+// usage:
+//     parallel_for( jobs, makeArrayView( entries ), 16, [&]( Array< Entity > range ) {
+//         FOR( entity : range ) { ... }
+//     } );
+
+#include <atomic>
+#include <thread>
+
+#define MAX_JOB_WORKERS ( 16 )
+#define MAX_WORKER_JOBS ( 256 )  // needs to be a power of two
+#define MAX_PARALLEL_FOR_JOBS ( 64 )
+
+static_assert( MAX_PROFILING_THREADS >= 2 * MAX_JOB_WORKERS + 1,
+               "MAX_PROFILING_THREADS needs to cover job workers, render and rasterizer threads" );
+
+struct JobCounter {
+	std::atomic< int32 > pending;
+};
+
+typedef void JobFunctionType( void* data, int32 first, int32 last );
+struct Job {
+	JobFunctionType* function;
+	void* data;
+	int32 first;
+	int32 last;
+	JobCounter* counter;
+};
+
+struct JobDeque {
+	alignas( 64 ) std::atomic< int64 > top;     // end that jobs are stolen from
+	alignas( 64 ) std::atomic< int64 > bottom;  // end that the owning worker pushes and pops
+	std::atomic< Job* > jobs[MAX_WORKER_JOBS];
+};
+
+struct JobSystem;
+typedef void WakeJobWorkersType( JobSystem* system );
+
+struct JobSystem {
+	int32 workersCount;
+	std::thread::id threadIds[MAX_JOB_WORKERS];
+	JobDeque deques[MAX_JOB_WORKERS];
+	JobDeque background;                     // only worker 0 pushes, nobody pops
+	std::atomic< int32 > backgroundPending;  // background jobs that didn't finish yet
+	std::atomic< int32 > sleepingCount;      // workers that wait for jobs
+	WakeJobWorkersType* wakeWorkers;         // set by the platform layer
+	void* platformData;
+};
+
+// worker index of the calling thread, -1 if the thread isn't a worker
+// thread_local can't be used, since the host and the game dll have their own copies of it
+static int32 getJobWorkerIndex( JobSystem* system )
+{
+	auto id = std::this_thread::get_id();
+	for( auto i = 0; i < system->workersCount; ++i ) {
+		if( system->threadIds[i] == id ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// only the owning worker may push and pop
+static bool pushJob( JobDeque* deque, Job* job )
+{
+	auto bottom = deque->bottom.load( std::memory_order_relaxed );
+	auto top    = deque->top.load( std::memory_order_acquire );
+	if( bottom - top >= MAX_WORKER_JOBS ) {
+		return false;
+	}
+	deque->jobs[bottom & ( MAX_WORKER_JOBS - 1 )].store( job, std::memory_order_relaxed );
+	// publishes the job to stealers, which load bottom with acquire
+	deque->bottom.store( bottom + 1, std::memory_order_release );
+	return true;
+}
+static Job* popJob( JobDeque* deque )
+{
+	auto bottom = deque->bottom.load( std::memory_order_relaxed ) - 1;
+	deque->bottom.store( bottom, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	auto top = deque->top.load( std::memory_order_relaxed );
+
+	Job* result = nullptr;
+	if( top <= bottom ) {
+		result = deque->jobs[bottom & ( MAX_WORKER_JOBS - 1 )].load( std::memory_order_relaxed );
+		if( top == bottom ) {
+			// last job, race against stealers
+			if( !deque->top.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst,
+			                                         std::memory_order_relaxed ) ) {
+				result = nullptr;
+			}
+			deque->bottom.store( bottom + 1, std::memory_order_relaxed );
+		}
+	} else {
+		deque->bottom.store( bottom + 1, std::memory_order_relaxed );
+	}
+	return result;
+}
+static Job* stealJob( JobDeque* deque )
+{
+	auto top = deque->top.load( std::memory_order_acquire );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	auto bottom = deque->bottom.load( std::memory_order_acquire );
+	if( top >= bottom ) {
+		return nullptr;
+	}
+	auto result = deque->jobs[top & ( MAX_WORKER_JOBS - 1 )].load( std::memory_order_relaxed );
+	if( !deque->top.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst,
+	                                         std::memory_order_relaxed ) ) {
+		return nullptr;
+	}
+	return result;
+}
+
+static void runJob( Job* job )
+{
+	job->function( job->data, job->first, job->last );
+	job->counter->pending.fetch_sub( 1, std::memory_order_release );
+}
+
+// steals and runs a background job, returns false if there was none
+bool tryRunBackgroundJob( JobSystem* system )
+{
+	if( auto job = stealJob( &system->background ) ) {
+		runJob( job );
+		system->backgroundPending.fetch_sub( 1, std::memory_order_release );
+		return true;
+	}
+	return false;
+}
+
+// runs a job of the workers own deque or steals one from another worker
+// worker 0 doesn't take background jobs here, since it might be waiting inside of a frame
+// returns false if there was no job
+bool tryRunJob( JobSystem* system, int32 workerIndex )
+{
+	assert( workerIndex >= 0 && workerIndex < system->workersCount );
+	auto job = popJob( &system->deques[workerIndex] );
+	for( auto i = 1; !job && i < system->workersCount; ++i ) {
+		job = stealJob( &system->deques[( workerIndex + i ) % system->workersCount] );
+	}
+	if( job ) {
+		runJob( job );
+		return true;
+	}
+	return workerIndex != 0 && tryRunBackgroundJob( system );
+}
+
+static bool hasJobs( JobDeque* deque )
+{
+	return deque->top.load( std::memory_order_acquire )
+	       < deque->bottom.load( std::memory_order_acquire );
+}
+bool hasPendingJobs( JobSystem* system )
+{
+	for( auto i = 0; i < system->workersCount; ++i ) {
+		if( hasJobs( &system->deques[i] ) ) {
+			return true;
+		}
+	}
+	return hasJobs( &system->background );
+}
+
+static void wakeJobWorkersIfSleeping( JobSystem* system )
+{
+	// pairs with the increment of sleepingCount before workers check for jobs, so that either the
+	// worker sees the jobs or we see the sleeping worker
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	if( system->wakeWorkers && system->sleepingCount.load( std::memory_order_relaxed ) > 0 ) {
+		system->wakeWorkers( system );
+	}
+}
+
+// adds jobs to the deque of the calling worker, counter is incremented by count
+// jobs run on the calling thread directly if it isn't a worker or its deque is full
+void addJobs( JobSystem* system, Job* jobs, int32 count, JobCounter* counter )
+{
+	assert( system );
+	assert( counter );
+	counter->pending.fetch_add( count, std::memory_order_relaxed );
+	auto workerIndex = getJobWorkerIndex( system );
+	auto deque       = ( workerIndex >= 0 ) ? ( &system->deques[workerIndex] ) : ( nullptr );
+	for( auto i = 0; i < count; ++i ) {
+		auto job     = &jobs[i];
+		job->counter = counter;
+		if( !deque || !pushJob( deque, job ) ) {
+			runJob( job );
+		}
+	}
+	wakeJobWorkersIfSleeping( system );
+}
+
+// adds jobs to the background deque, needs to be called from worker 0
+// jobs run on the calling thread directly if there are no other workers or the deque is full
+void addBackgroundJobs( JobSystem* system, Job* jobs, int32 count, JobCounter* counter )
+{
+	assert( system );
+	assert( counter );
+	assert( getJobWorkerIndex( system ) == 0 );
+	counter->pending.fetch_add( count, std::memory_order_relaxed );
+	for( auto i = 0; i < count; ++i ) {
+		auto job     = &jobs[i];
+		job->counter = counter;
+		// counted before the push, so that a thief can't finish the job before it was counted
+		system->backgroundPending.fetch_add( 1, std::memory_order_relaxed );
+		if( system->workersCount <= 1 || !pushJob( &system->background, job ) ) {
+			system->backgroundPending.fetch_sub( 1, std::memory_order_relaxed );
+			runJob( job );
+		}
+	}
+	wakeJobWorkersIfSleeping( system );
+}
+
+// runs background jobs until all of them are done, the calling thread doesn't need to be a worker
+void waitForBackgroundJobs( JobSystem* system )
+{
+	assert( system );
+	while( system->backgroundPending.load( std::memory_order_acquire ) > 0 ) {
+		if( !tryRunBackgroundJob( system ) ) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+// runs jobs until all jobs of counter are done
+void waitForJobCounter( JobSystem* system, JobCounter* counter )
+{
+	assert( system );
+	assert( counter );
+	auto workerIndex = getJobWorkerIndex( system );
+	while( counter->pending.load( std::memory_order_acquire ) > 0 ) {
+		if( workerIndex < 0 || !tryRunJob( system, workerIndex ) ) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+// calls function with consecutive subranges of view that are at least grainSize elements big on
+// all workers and waits until all of them are done
+// function is called directly if system is nullptr or the calling thread isn't a worker
+template < class T, class Function >
+void parallel_for( JobSystem* system, ArrayView< T > view, int32 grainSize, Function&& function )
+{
+	assert( grainSize > 0 );
+	auto count     = (int32)view.size();
+	auto jobsCount = 1;
+	if( system && getJobWorkerIndex( system ) >= 0 ) {
+		jobsCount = min( ( count + grainSize - 1 ) / grainSize, system->workersCount * 4,
+		                 MAX_PARALLEL_FOR_JOBS );
+	}
+	if( jobsCount <= 1 ) {
+		function( view );
+		return;
+	}
+
+	struct Data {
+		ArrayView< T > view;
+		typename std::remove_reference< Function >::type* function;
+	};
+	Data data = {view, &function};
+	auto run  = []( void* ptr, int32 first, int32 last ) {
+		auto data  = (Data*)ptr;
+		auto begin = data->view.begin();
+		( *data->function )( makeArrayView( begin + first, begin + last ) );
+	};
+
+	Job jobs[MAX_PARALLEL_FOR_JOBS];
+	for( auto i = 0; i < jobsCount; ++i ) {
+		jobs[i].function = run;
+		jobs[i].data     = &data;
+		jobs[i].first    = (int32)( (int64)count * i / jobsCount );
+		jobs[i].last     = (int32)( (int64)count * ( i + 1 ) / jobsCount );
+	}
+	JobCounter counter = {};
+	addJobs( system, jobs, jobsCount, &counter );
+	waitForJobCounter( system, &counter );
+}
@@ -98,7 +98,7 @@ void writePropertyName( JsonWriter* writer, StringView name )
 		writer->builder << ' ';
 	}
 }
-template < class T, class = std::enable_if< !std::is_enum< T >::value >::type >
+template < class T, class = typename std::enable_if< !std::is_enum< T >::value >::type >
 void writeValue( JsonWriter* writer, const T& value )
 {
 	writeComma( writer );
@@ -106,7 +106,7 @@ void writeValue( JsonWriter* writer, const T& value )
 	writer->isNotProperty = true;
 	writer->builder << value;
 }
-template < class T, class = std::enable_if< std::is_enum< T >::value >::type >
+template < class T, class = typename std::enable_if< std::is_enum< T >::value >::type >
 void writeValue( JsonWriter* writer, T value )
 {
 	::writeValue( writer, valueof( value ) );
@@ -0,0 +1,142 @@
+// frame bookkeeping and reports of the allocation tracking in Core/MemoryTracking.h
+// the game calls beginMemoryTrackingFrame and endMemoryTrackingFrame around every frame, the report
+// is shown in the debug gui and printed by the headless host
+
+void clearMemoryTrackingTable( MemoryTrackingTable* table )
+{
+	assert( table );
+	lockMemoryTrackingTable( table );
+	fill( table->sites, AllocationSite{}, MAX_ALLOCATION_SITES );
+	table->sitesCount         = 0;
+	table->droppedAllocations = 0;
+	table->allocatorsCount    = 0;
+	table->currentFrame       = 0;
+	table->framesCount        = 0;
+	unlockMemoryTrackingTable( table );
+}
+
+// allocator needs to outlive the table or be untracked by clearing the table, name should be a
+// string literal, tracking an allocator again only updates its name
+void trackStackAllocator( MemoryTrackingTable* table, const char* name, StackAllocator* allocator )
+{
+	assert( table );
+	assert( allocator );
+	for( auto i = 0; i < table->allocatorsCount; ++i ) {
+		if( table->allocators[i].allocator == allocator ) {
+			table->allocators[i].name = name;
+			return;
+		}
+	}
+	if( table->allocatorsCount >= MAX_TRACKED_ALLOCATORS ) {
+		LOG( ERROR, "Too many tracked allocators, {} is not tracked", name );
+		return;
+	}
+	auto tracked       = &table->allocators[table->allocatorsCount++];
+	*tracked           = {};
+	tracked->name      = name;
+	tracked->allocator = allocator;
+}
+
+// allocations between frames, like the ones during initialization, are counted as their own frame
+void beginMemoryTrackingFrame( MemoryTrackingTable* table )
+{
+	assert( table );
+	lockMemoryTrackingTable( table );
+	for( auto& site : table->sites ) {
+		site.maxFrameBytes = max( site.maxFrameBytes, site.frameBytes );
+		site.frameBytes    = 0;
+	}
+	unlockMemoryTrackingTable( table );
+	for( auto i = 0; i < table->allocatorsCount; ++i ) {
+		auto allocator       = table->allocators[i].allocator;
+		allocator->framePeak = allocator->size;
+	}
+}
+
+void endMemoryTrackingFrame( MemoryTrackingTable* table )
+{
+	assert( table );
+	lockMemoryTrackingTable( table );
+	for( auto& site : table->sites ) {
+		site.maxFrameBytes = max( site.maxFrameBytes, site.frameBytes );
+	}
+	unlockMemoryTrackingTable( table );
+	auto frame = table->currentFrame;
+	for( auto i = 0; i < table->allocatorsCount; ++i ) {
+		auto tracked               = &table->allocators[i];
+		tracked->framePeaks[frame] = tracked->allocator->framePeak;
+	}
+	table->currentFrame = ( frame + 1 ) % MAX_MEMORY_TRACKING_FRAMES;
+	table->framesCount  = min( table->framesCount + 1, MAX_MEMORY_TRACKING_FRAMES );
+}
+
+// most bytes used in a single frame over the recorded frames
+size_t getMaxFramePeak( MemoryTrackingTable* table, TrackedAllocator* tracked )
+{
+	size_t result = 0;
+	for( auto i = 0; i < table->framesCount; ++i ) {
+		result = max( result, tracked->framePeaks[i] );
+	}
+	return result;
+}
+
+// max characters of a report line, without the filename
+const size_t MemoryTrackingReportLineSize = 128;
+
+// size of the output of writeMemoryTrackingReport
+size_t getMemoryTrackingReportSize( MemoryTrackingTable* table, int32 maxSites )
+{
+	size_t result = MemoryTrackingReportLineSize * ( 3 + table->allocatorsCount );
+	auto count    = 0;
+	for( auto& site : table->sites ) {
+		if( site.file && count++ < maxSites ) {
+			result += MemoryTrackingReportLineSize + strlen( site.file );
+		}
+	}
+	return result + 1;
+}
+
+// writes high-water marks of the tracked allocators and the maxSites call sites that allocated the
+// most bytes in a single frame
+void writeMemoryTrackingReport( string_builder* builder, MemoryTrackingTable* table,
+                                int32 maxSites )
+{
+	assert( builder );
+	assert( table );
+
+	// strings are not padded by print, so they are printed last
+	builder->print( "      used frame peak  max frame       peak   capacity allocator\n" );
+	for( auto i = 0; i < table->allocatorsCount; ++i ) {
+		auto tracked   = &table->allocators[i];
+		auto allocator = tracked->allocator;
+		builder->print( "{:10} {:10} {:10} {:10} {:10} {}\n", (uint64)allocator->size,
+		                (uint64)allocator->framePeak, (uint64)getMaxFramePeak( table, tracked ),
+		                (uint64)allocator->peak, (uint64)allocator->capacity, tracked->name );
+	}
+
+	// sort a copy, so that allocations can continue while we are printing
+	AllocationSite sites[MAX_ALLOCATION_SITES];
+	int32 sitesCount = 0;
+	lockMemoryTrackingTable( table );
+	for( auto& site : table->sites ) {
+		if( site.file ) {
+			sites[sitesCount++] = site;
+		}
+	}
+	auto droppedAllocations = table->droppedAllocations;
+	unlockMemoryTrackingTable( table );
+	sort( sites, sites + sitesCount, []( const AllocationSite& a, const AllocationSite& b ) {
+		return a.maxFrameBytes > b.maxFrameBytes
+		       || ( a.maxFrameBytes == b.maxFrameBytes && a.bytes > b.bytes );
+	} );
+
+	builder->print( " max frame    largest      count        bytes call site\n" );
+	for( auto i = 0, count = min( sitesCount, maxSites ); i < count; ++i ) {
+		auto site = &sites[i];
+		builder->print( "{:10} {:10} {:10} {:12} {}:{}\n", site->maxFrameBytes, site->largest,
+		                site->count, site->bytes, site->file, site->line );
+	}
+	if( droppedAllocations ) {
+		builder->print( "{} allocations dropped, too many call sites\n", droppedAllocations );
+	}
+}
@@ -1,9 +1,43 @@
-#include <intrin.h>
+#ifdef _MSC_VER
+	#include <intrin.h>
+#else
+	#include <x86intrin.h>
+#endif
+#include <atomic>
+
+// hardware counters are read with perf_event_open at every event, which is linux only
+#ifdef GAME_PROFILING_COUNTERS
+	#ifndef __linux__
+		#error "GAME_PROFILING_COUNTERS is only supported on linux"
+	#endif
+	#include <linux/perf_event.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
+
+// every thread that emits profiling events gets its own ring buffer, so that writing an event does
+// not need any synchronization with other threads
+// frames are delimited by FrameMarker events, so that the last n frames can be captured at any time
+
+#ifdef GAME_PROFILING_COUNTERS
+	enum ProfilingCounterValues {
+		ProfilingCounter_Instructions,
+		ProfilingCounter_CacheMisses,
+		ProfilingCounter_BranchMisses,
+
+		ProfilingCounter_Count
+	};
+#endif
 
 struct ProfilingEvent {
 	uint64 timestamp;
 	uint16 infoIndex;
-	enum : int8 { Begin, End } type;
+	uint16 threadIndex;
+	enum : int8 { Begin, End, FrameMarker } type;
+#ifdef GAME_PROFILING_COUNTERS
+	uint64 counters[ProfilingCounter_Count];  // zero if counters aren't available on this thread
+#endif
 };
 struct ProfilingInfo {
 	const char* file;
@@ -11,56 +45,216 @@ struct ProfilingInfo {
 	int32 line;
 };
 
-#define MAX_PROFILING_EVENTS ( 4 * 20480 )
+#ifdef GAME_PROFILING_COUNTERS
+	// events are bigger with counters, keep the table at roughly the same size
+	#define MAX_PROFILING_EVENTS ( 2048 )
+#else
+	#define MAX_PROFILING_EVENTS ( 4096 )  // per thread, needs to be a power of two
+#endif
 #define MAX_PROFILING_INFOS ( 2048 )
+// all job workers (see MAX_JOB_WORKERS), the render thread and as many software rasterizer threads
+// as there are job workers, events of threads beyond that are dropped and counted
+#define MAX_PROFILING_THREADS ( 33 )
 
-struct ProfilingTable {
-	uint16 infosCount;
-	uint16 eventsCount;
+static_assert( ( MAX_PROFILING_EVENTS & ( MAX_PROFILING_EVENTS - 1 ) ) == 0,
+               "MAX_PROFILING_EVENTS must be a power of two" );
+
+struct ProfilingThread {
+	std::atomic< uint32 > owner;    // id of the thread that writes into this buffer, 0 if unused
+	std::atomic< uint32 > written;  // total number of events written, wraps around
 	ProfilingEvent events[MAX_PROFILING_EVENTS];
+};
+
+struct ProfilingTable {
+	std::atomic< int32 > infosCount;
+	std::atomic< int32 > infosLock;
+	std::atomic< uint32 > droppedEvents;  // events of threads that didn't get a buffer
 	ProfilingInfo infos[MAX_PROFILING_INFOS];
+	ProfilingThread threads[MAX_PROFILING_THREADS];
 };
 
 #ifndef NO_PROFILING
 
 	extern global_var ProfilingTable* GlobalProfilingTable;
 
+	static ProfilingThread* registerProfilingThread( uint32 threadId )
+	{
+		for( auto i = 0; i < MAX_PROFILING_THREADS; ++i ) {
+			auto thread   = &GlobalProfilingTable->threads[i];
+			uint32 unused = 0;
+			if( thread->owner.load( std::memory_order_relaxed ) == threadId
+			    || thread->owner.compare_exchange_strong( unused, threadId ) ) {
+				return thread;
+			}
+		}
+		// events of threads that do not fit into the table are dropped, see droppedEvents
+		return nullptr;
+	}
+	#ifdef GAME_PROFILING_COUNTERS
+		// opens a counter group that counts the calling thread on any cpu
+		// returns false if counters aren't available, for instance because of perf_event_paranoid or
+		// because we run inside a vm without a pmu, events then only contain timestamps
+		static bool openProfilingCounters( int32 ( &fds )[ProfilingCounter_Count] )
+		{
+			const uint64 configs[ProfilingCounter_Count] = {
+			    PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+			for( auto& fd : fds ) {
+				fd = -1;
+			}
+			for( auto i = 0; i < ProfilingCounter_Count; ++i ) {
+				perf_event_attr attr = {};
+				attr.type            = PERF_TYPE_HARDWARE;
+				attr.size            = sizeof( perf_event_attr );
+				attr.config          = configs[i];
+				attr.disabled        = ( i == 0 );
+				attr.exclude_kernel  = 1;
+				attr.exclude_hv      = 1;
+				attr.read_format     = PERF_FORMAT_GROUP;
+				fds[i] = (int32)syscall( __NR_perf_event_open, &attr, 0, -1, fds[0], 0 );
+				if( fds[i] < 0 ) {
+					for( auto j = 0; j < i; ++j ) {
+						close( fds[j] );
+					}
+					fds[0] = -1;
+					return false;
+				}
+			}
+			ioctl( fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+			return true;
+		}
+		static void readProfilingCounters( int32 groupFd,
+		                                   uint64 ( &counters )[ProfilingCounter_Count] )
+		{
+			struct {
+				uint64 count;
+				uint64 values[ProfilingCounter_Count];
+			} group;
+			if( groupFd < 0
+			    || read( groupFd, &group, sizeof( group ) ) != (ssize_t)sizeof( group ) ) {
+				memset( counters, 0, sizeof( counters ) );
+				return;
+			}
+			memcpy( counters, group.values, sizeof( counters ) );
+		}
+	#endif
+
+	struct ProfilingThreadRegistration {
+		uint32 threadId;
+		ProfilingThread* thread;
+	#ifdef GAME_PROFILING_COUNTERS
+		bool countersOpened;
+		int32 counterFds[ProfilingCounter_Count];
+	#endif
+
+		// threads give up their buffer when they exit, so that short lived threads do not use up
+		// all buffers
+		~ProfilingThreadRegistration()
+		{
+			if( thread ) {
+				auto owner = threadId;
+				thread->owner.compare_exchange_strong( owner, 0 );
+			}
+	#ifdef GAME_PROFILING_COUNTERS
+			if( countersOpened && counterFds[0] >= 0 ) {
+				for( auto fd : counterFds ) {
+					close( fd );
+				}
+			}
+	#endif
+		}
+	};
+	// returns nullptr if there is no free buffer for this thread
+	static ProfilingThreadRegistration* getProfilingThread()
+	{
+		static std::atomic< uint32 > nextThreadId( 1 );
+		static thread_local ProfilingThreadRegistration registration = {nextThreadId.fetch_add( 1 ),
+		                                                                nullptr};
+
+		// the table lives in game memory, which gets cleared when the game is restarted, so we check
+		// whether we still own the buffer
+		auto thread = registration.thread;
+		if( !thread || thread->owner.load( std::memory_order_relaxed ) != registration.threadId ) {
+			thread              = registerProfilingThread( registration.threadId );
+			registration.thread = thread;
+		}
+	#ifdef GAME_PROFILING_COUNTERS
+		if( !registration.countersOpened ) {
+			registration.countersOpened = true;
+			openProfilingCounters( registration.counterFds );
+		}
+	#endif
+		return ( thread ) ? ( &registration ) : ( nullptr );
+	}
+
+	static void writeProfilingEvent( uint16 infoIndex, decltype( ProfilingEvent::type ) type )
+	{
+		if( auto registration = getProfilingThread() ) {
+			// only the owning thread writes, readers check written to detect overwritten events
+			auto thread  = registration->thread;
+			auto written = thread->written.load( std::memory_order_relaxed );
+			auto event   = &thread->events[written & ( MAX_PROFILING_EVENTS - 1 )];
+	#ifdef GAME_PROFILING_COUNTERS
+			// counters are read before the timestamp, so that the read itself is not measured by
+			// begin events
+			readProfilingCounters( registration->counterFds[0], event->counters );
+	#endif
+			event->timestamp   = __rdtsc();
+			event->infoIndex   = infoIndex;
+			event->threadIndex = (uint16)( thread - GlobalProfilingTable->threads );
+			event->type        = type;
+			thread->written.store( written + 1, std::memory_order_release );
+		} else {
+			GlobalProfilingTable->droppedEvents.fetch_add( 1, std::memory_order_relaxed );
+		}
+	}
+
 	uint16 getProfilingInfo( const char* file, const char* block, int32 line )
 	{
-		for( int32 i = 0, count = GlobalProfilingTable->infosCount; i < count; ++i ) {
-			auto info = &GlobalProfilingTable->infos[i];
+		auto table = GlobalProfilingTable;
+		int32 unlocked = 0;
+		while( !table->infosLock.compare_exchange_weak( unlocked, 1, std::memory_order_acquire ) ) {
+			unlocked = 0;
+		}
+		uint16 result = 0;
+		auto count    = table->infosCount.load( std::memory_order_relaxed );
+		auto found    = false;
+		for( int32 i = 0; i < count; ++i ) {
+			auto info = &table->infos[i];
 			if( ( info->file == file || strcmp( info->file, file ) == 0 )
 			    && ( info->block == block || strcmp( info->block, block ) == 0 ) ) {
 
-				return safe_truncate< uint16 >( i );
+				result = safe_truncate< uint16 >( i );
+				found  = true;
+				break;
 			}
 		}
-		assert( GlobalProfilingTable->infosCount < MAX_PROFILING_INFOS );
-		uint16 index                       = GlobalProfilingTable->infosCount++;
-		GlobalProfilingTable->infos[index] = {file, block, line};
-		return index;
+		if( !found ) {
+			assert( count < MAX_PROFILING_INFOS );
+			result               = safe_truncate< uint16 >( count );
+			table->infos[result] = {file, block, line};
+			table->infosCount.store( count + 1, std::memory_order_release );
+		}
+		table->infosLock.store( 0, std::memory_order_release );
+		return result;
 	}
 
-	#define PROFILING_EVENT_( type )                                                     \
-		assert( GlobalProfilingTable->eventsCount < MAX_PROFILING_EVENTS );              \
-		auto event = &GlobalProfilingTable->events[GlobalProfilingTable->eventsCount++]; \
-		*event     = {__rdtsc(), infoIndex, ProfilingEvent::type};
-
 	#define PROFILING_BLOCK_( file, name, line, type )                      \
 		{                                                                   \
 			static uint16 infoIndex = getProfilingInfo( file, name, line ); \
-			PROFILING_EVENT_( type );                                       \
+			writeProfilingEvent( infoIndex, ProfilingEvent::type );         \
 		}
 	#define BEGIN_PROFILING_BLOCK( name ) PROFILING_BLOCK_( __FILE__, name, __LINE__, Begin )
 	#define END_PROFILING_BLOCK( name ) PROFILING_BLOCK_( __FILE__, name, __LINE__, End )
+	// marks the start of a new frame, should be called from one thread only
+	#define BEGIN_PROFILING_FRAME() writeProfilingEvent( 0, ProfilingEvent::FrameMarker )
 
 	struct ScopedProfilingBlock {
 		uint16 infoIndex;
 		ScopedProfilingBlock( uint16 infoIndex ) : infoIndex( infoIndex )
 		{
-			PROFILING_EVENT_( Begin );
+			writeProfilingEvent( infoIndex, ProfilingEvent::Begin );
 		}
-		~ScopedProfilingBlock() { PROFILING_EVENT_( End ); }
+		~ScopedProfilingBlock() { writeProfilingEvent( infoIndex, ProfilingEvent::End ); }
 	};
 
 	#define PROFILE_FUNCTION2( counter, file, name, line )                                    \
@@ -72,23 +266,164 @@ struct ProfilingTable {
 #else // !defined( NO_PROFILING )
 	#define BEGIN_PROFILING_BLOCK( name ) ( (void)0 )
 	#define END_PROFILING_BLOCK( name ) ( (void)0 )
+	#define BEGIN_PROFILING_FRAME() ( (void)0 )
 	#define PROFILE_FUNCTION() ( (void)0 )
 #endif // !defined( NO_PROFILING )
 
+void clearProfilingTable( ProfilingTable* table )
+{
+	assert( table );
+	table->infosCount    = 0;
+	table->infosLock     = 0;
+	table->droppedEvents = 0;
+	for( auto& thread : table->threads ) {
+		thread.owner   = 0;
+		thread.written = 0;
+	}
+}
+
+// events of a single thread in the order they were written
+struct ProfilingThreadEvents {
+	Array< ProfilingEvent > events;
+	int32 threadIndex;
+};
+struct ProfilingCapture {
+	Array< ProfilingThreadEvents > threads;
+	uint64 beginTimestamp;
+	uint64 endTimestamp;
+	int32 framesCount;  // number of frames captured, less than requested if not enough were recorded
+	uint32 droppedEvents;  // events of threads without a buffer since the table was cleared
+};
+
+// copies the events of the ring buffer that are still valid, can be called while thread is writing
+static Array< ProfilingEvent > copyProfilingThreadEvents( StackAllocator* allocator,
+                                                          ProfilingThread* thread )
+{
+	auto written = thread->written.load( std::memory_order_acquire );
+	auto count   = min( written, (uint32)MAX_PROFILING_EVENTS );
+	auto events  = allocateArray( allocator, ProfilingEvent, count );
+	if( !events ) {
+		OutOfMemory();
+		return {};
+	}
+	auto first = written - count;
+	for( uint32 i = 0; i < count; ++i ) {
+		events[i] = thread->events[( first + i ) & ( MAX_PROFILING_EVENTS - 1 )];
+	}
+	// events at the front might have been overwritten while we were copying
+	// once the ring is full, the event the thread is writing right now lands in the slot after the
+	// last overwritten one, without being counted in written yet
+	// the fence keeps the copies above from being reordered past the second load of written
+	std::atomic_thread_fence( std::memory_order_acquire );
+	auto overwritten = thread->written.load( std::memory_order_acquire ) - written;
+	if( written >= (uint32)MAX_PROFILING_EVENTS ) {
+		++overwritten;
+	}
+	auto valid = ( overwritten < count ) ? ( count - overwritten ) : ( 0u );
+	return makeArrayView( events + ( count - valid ), (int32)valid );
+}
+
+// worst case memory needed by captureProfilingFrames, including alignment padding
+size_t getProfilingCaptureSize()
+{
+	return ( sizeof( ProfilingEvent ) * MAX_PROFILING_EVENTS + sizeof( ProfilingThreadEvents ) + 32 )
+	       * MAX_PROFILING_THREADS;
+}
+
+// captures the events of the last framesCount frames of all threads
+// a frame starts at a FrameMarker, so the current frame counts as one frame
+ProfilingCapture captureProfilingFrames( StackAllocator* allocator, ProfilingTable* table,
+                                         int32 framesCount )
+{
+	assert( isValid( allocator ) );
+	assert( table );
+	assert( framesCount > 0 );
+
+	ProfilingCapture result = {};
+	auto threads            = allocateArray( allocator, ProfilingThreadEvents, MAX_PROFILING_THREADS );
+	if( !threads ) {
+		OutOfMemory();
+		return {};
+	}
+	int32 threadsCount = 0;
+	for( auto i = 0; i < MAX_PROFILING_THREADS; ++i ) {
+		auto thread = &table->threads[i];
+		// buffers of threads that exited still contain their events
+		if( thread->written.load( std::memory_order_relaxed ) ) {
+			threads[threadsCount++] = {copyProfilingThreadEvents( allocator, thread ), i};
+		}
+	}
+
+	// find the frame marker the capture starts at, walking backwards from the newest event
+	uint64 beginTimestamp = 0;
+	uint64 endTimestamp   = 0;
+	bool foundBegin       = false;
+	for( auto i = 0; i < threadsCount; ++i ) {
+		auto events = threads[i].events;
+		if( events.size() ) {
+			endTimestamp = max( endTimestamp, events.back().timestamp );
+		}
+		int32 markers = 0;
+		for( auto j = events.size() - 1; j >= 0 && markers < framesCount; --j ) {
+			if( events[j].type == ProfilingEvent::FrameMarker ) {
+				++markers;
+				beginTimestamp = events[j].timestamp;
+			}
+		}
+		if( markers ) {
+			result.framesCount = markers;
+			foundBegin         = true;
+			break;
+		}
+	}
+	if( !foundBegin ) {
+		// no frames were marked, capture everything
+		beginTimestamp = UINT64_MAX;
+		for( auto i = 0; i < threadsCount; ++i ) {
+			if( threads[i].events.size() ) {
+				beginTimestamp = min( beginTimestamp, threads[i].events[0].timestamp );
+			}
+		}
+	}
+
+	for( auto i = 0; i < threadsCount; ++i ) {
+		auto events = threads[i].events;
+		auto first  = events.begin();
+		while( first != events.end() && first->timestamp < beginTimestamp ) {
+			++first;
+		}
+		threads[i].events = makeArrayView( first, events.end() );
+	}
+
+	result.threads        = makeArrayView( threads, threadsCount );
+	result.beginTimestamp = ( threadsCount ) ? ( beginTimestamp ) : ( 0 );
+	result.endTimestamp   = max( endTimestamp, result.beginTimestamp );
+	result.droppedEvents  = table->droppedEvents.load( std::memory_order_relaxed );
+	return result;
+}
+
 struct ProfilingBlock {
 	uint64 duration;
 	float relRatio; // ratio of cpu usage relative to parent
 	float absRatio; // ratio of cpu usage relative to absolute cpu usage
 	uint16 infoIndex;
+	uint16 threadIndex;
+#ifdef GAME_PROFILING_COUNTERS
+	uint64 counters[ProfilingCounter_Count];  // counted events between begin and end of the block
+#endif
 	ProfilingBlock* child;
 	ProfilingBlock* next;
 };
 struct ProfilingState {
 	IntrusiveLinkedList< ProfilingBlock > blocks;
 	Array< ProfilingInfo > infos;
+	uint32 droppedEvents;  // see ProfilingCapture::droppedEvents
 };
 
-ProfilingState processProfilingEvents( StackAllocator* allocator, ProfilingTable* table )
+// builds the block hierarchy of the last framesCount frames, top level blocks of all threads are
+// in blocks, ordered by thread
+ProfilingState processProfilingEvents( StackAllocator* allocator, ProfilingTable* table,
+                                       int32 framesCount = 1 )
 {
 	assert( isValid( allocator ) );
 	assert( table );
@@ -98,67 +433,93 @@ ProfilingState processProfilingEvents( StackAllocator* allocator, ProfilingTable
 	auto primary          = partition.primary();
 	auto scrap            = partition.scrap();
 
+	auto capture = captureProfilingFrames( scrap, table, framesCount );
+
 	struct StackEntry {
-		uint64 timestamp;
+		const ProfilingEvent* begin;
 		ProfilingBlock* block;
 		ProfilingBlock* childrenTail;
 	};
 	auto stack                  = beginVector( scrap, StackEntry );
 	double oneOverTotalDuration = 1;
-	if( table->eventsCount ) {
-		auto totalDuration =
-		    table->events[table->eventsCount - 1].timestamp - table->events[0].timestamp;
-		if( totalDuration ) {
-			oneOverTotalDuration = 1.0 / totalDuration;
-		}
+	if( auto totalDuration = capture.endTimestamp - capture.beginTimestamp ) {
+		oneOverTotalDuration = 1.0 / totalDuration;
 	}
 
-	for( int32 i = 0, count = table->eventsCount; i < count; ++i ) {
-		auto event = &table->events[i];
-		switch( event->type ) {
-			case ProfilingEvent::Begin: {
-				auto current       = allocateStruct( primary, ProfilingBlock );
-				*current           = {};
-				current->infoIndex = event->infoIndex;
-				current->relRatio  = 1;
-				if( stack.size() ) {
-					auto parent = &stack.back();
-					if( parent->childrenTail ) {
-						parent->childrenTail->next = current;
+	auto endBlock = [&]( uint64 timestamp, const ProfilingEvent* end ) {
+		auto current    = &stack.back();
+		auto block      = current->block;
+		block->duration = timestamp - current->begin->timestamp;
+#ifdef GAME_PROFILING_COUNTERS
+		// counters are zero if they couldn't be read, the end might be zero because of that too
+		for( auto i = 0; i < ProfilingCounter_Count; ++i ) {
+			auto first = current->begin->counters[i];
+			auto last  = end->counters[i];
+			block->counters[i] = ( last > first ) ? ( last - first ) : ( 0 );
+		}
+#else
+		(void)end;
+#endif
+		block->absRatio = (float)( block->duration * oneOverTotalDuration );
+		stack.pop_back();
+		if( !block->duration ) {
+			return;
+		}
+		double oneOverDuration = 1.0 / block->duration;
+		// calculate duration relRatio of children
+		for( auto child = block->child; child; child = child->next ) {
+			child->relRatio = (float)( child->duration * oneOverDuration );
+		}
+	};
+
+	FOR( thread : capture.threads ) {
+		FOR( event : thread.events ) {
+			switch( event.type ) {
+				case ProfilingEvent::Begin: {
+					auto current         = allocateStruct( primary, ProfilingBlock );
+					*current             = {};
+					current->infoIndex   = event.infoIndex;
+					current->threadIndex = event.threadIndex;
+					current->relRatio    = 1;
+					if( stack.size() ) {
+						auto parent = &stack.back();
+						if( parent->childrenTail ) {
+							parent->childrenTail->next = current;
+						}
+						parent->childrenTail = current;
+						if( !parent->block->child ) {
+							parent->block->child = current;
+						}
+					} else {
+						result.blocks.push( current );
 					}
-					parent->childrenTail = current;
-					if( !parent->block->child ) {
-						parent->block->child = current;
+					stack.push_back( {&event, current} );
+					break;
+				}
+				case ProfilingEvent::End: {
+					// blocks that began before the capture have no begin event
+					if( stack.size() ) {
+						endBlock( event.timestamp, &event );
 					}
-				} else {
-					result.blocks.push( current );
+					break;
 				}
-				stack.push_back( {event->timestamp, current} );
-				break;
-			}
-			case ProfilingEvent::End: {
-				assert( stack.size() );
-				auto current    = &stack.back();
-				auto block      = current->block;
-				block->duration = event->timestamp - current->timestamp;
-				block->absRatio = (float)( block->duration * oneOverTotalDuration );
-				assert( block->duration );
-				double oneOverDuration = 1.0 / block->duration;
-				stack.pop_back();
-				// calculate duration relRatio of children
-				for( auto child = block->child; child; child = child->next ) {
-					child->relRatio = (float)( child->duration * oneOverDuration );
+				case ProfilingEvent::FrameMarker: {
+					break;
 				}
-				break;
+					InvalidDefaultCase;
 			}
-				InvalidDefaultCase;
+		}
+		// blocks that are still running are cut off at the end of the capture
+		while( stack.size() ) {
+			endBlock( capture.endTimestamp, &thread.events.back() );
 		}
 	}
-	assert( stack.size() == 0 );
 
-	result.infos = makeArray( primary, ProfilingInfo, table->infosCount );
-	result.infos.assign( table->infos, table->infos + table->infosCount );
+	auto infosCount      = table->infosCount.load( std::memory_order_acquire );
+	result.infos         = makeArray( primary, ProfilingInfo, infosCount );
+	result.droppedEvents = capture.droppedEvents;
+	result.infos.assign( table->infos, table->infos + infosCount );
 
 	partition.commit();
 	return result;
-}
\ No newline at end of file
+}
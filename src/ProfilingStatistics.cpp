@@ -0,0 +1,315 @@
+// statistics of profiling blocks over many frames
+// every frame the ProfilingState of that frame is added, which updates
+// - rolling min/mean/max and a histogram of the ticks each block took over the last frames
+// - a call tree that accumulates the self ticks of every call path since the last reset, which
+//   can be exported as folded stacks for flame graph tools
+
+// histogram buckets are powers of two split into 4 linear sub buckets, so that the error of
+// percentiles is at most 25%
+const int32 ProfilingHistogramSubBucketBits = 2;
+const int32 ProfilingHistogramSubBuckets    = 1 << ProfilingHistogramSubBucketBits;
+const int32 ProfilingHistogramBuckets       = 64 * ProfilingHistogramSubBuckets;
+
+static int32 getProfilingHistogramBucket( uint64 ticks )
+{
+	if( ticks < ProfilingHistogramSubBuckets ) {
+		return (int32)ticks;
+	}
+	int32 log2 = 0;
+	for( auto shift = 32; shift > 0; shift /= 2 ) {
+		if( ticks >> ( log2 + shift ) ) {
+			log2 += shift;
+		}
+	}
+	auto subBucket = (int32)( ticks >> ( log2 - ProfilingHistogramSubBucketBits ) )
+	                 & ( ProfilingHistogramSubBuckets - 1 );
+	return ( log2 - ProfilingHistogramSubBucketBits + 1 ) * ProfilingHistogramSubBuckets
+	       + subBucket;
+}
+// largest tick count that falls into bucket
+static uint64 getProfilingHistogramBucketMax( int32 bucket )
+{
+	if( bucket < ProfilingHistogramSubBuckets ) {
+		return (uint64)bucket;
+	}
+	auto log2      = bucket / ProfilingHistogramSubBuckets + ProfilingHistogramSubBucketBits - 1;
+	auto subBucket = (uint64)( bucket % ProfilingHistogramSubBuckets );
+	auto width     = (uint64)1 << ( log2 - ProfilingHistogramSubBucketBits );
+	return ( ProfilingHistogramSubBuckets + subBucket ) * width + ( width - 1 );
+}
+
+struct ProfilingBlockStatistics {
+	uint64* samples;  // ring buffer of ticks per frame, 0 if the block didn't run in that frame
+	uint16 histogram[ProfilingHistogramBuckets];  // only counts frames the block ran in
+	uint64 sum;
+	int32 framesCount;  // number of frames in samples the block ran in
+};
+
+// call path node, children are identified by their info index
+struct ProfilingCallNode {
+	uint64 selfTicks;
+	uint16 infoIndex;
+	ProfilingCallNode* child;
+	ProfilingCallNode* next;
+};
+
+struct ProfilingStatistics {
+	StackAllocator allocator;
+	int32 framesCapacity;  // rolling window size
+	int32 currentFrame;    // index into samples of the next frame
+	int32 framesCount;     // number of frames that were added, at most framesCapacity
+	ProfilingBlockStatistics* blocks[MAX_PROFILING_INFOS];
+	uint64 frameTicks[MAX_PROFILING_INFOS];
+	int32 depths[MAX_PROFILING_INFOS];
+	ProfilingCallNode* threads[MAX_PROFILING_THREADS];  // roots of the call tree of every thread
+	uint32 droppedEvents;  // events of threads without a buffer in the table, not in the call tree
+	bool outOfMemory;
+};
+
+void initProfilingStatistics( ProfilingStatistics* statistics, StackAllocator* allocator,
+                              size_t size, int32 framesCapacity )
+{
+	assert( statistics );
+	assert( framesCapacity > 0 && framesCapacity <= UINT16_MAX );
+	*statistics                = {};
+	statistics->allocator      = makeStackAllocator( allocator, size );
+	statistics->framesCapacity = framesCapacity;
+	if( !isValid( &statistics->allocator ) ) {
+		statistics->outOfMemory = true;
+		OutOfMemory();
+	}
+}
+
+static ProfilingBlockStatistics* getProfilingBlockStatistics( ProfilingStatistics* statistics,
+                                                              int32 infoIndex )
+{
+	auto result = statistics->blocks[infoIndex];
+	if( !result && !statistics->outOfMemory ) {
+		auto allocator = &statistics->allocator;
+		result         = allocateStruct( allocator, ProfilingBlockStatistics );
+		auto samples   = allocateArray( allocator, uint64, statistics->framesCapacity );
+		if( !result || !samples ) {
+			// only log once, this would be called every frame otherwise
+			statistics->outOfMemory = true;
+			OutOfMemory();
+			return nullptr;
+		}
+		*result         = {};
+		result->samples = samples;
+		zeroMemory( samples, (size_t)statistics->framesCapacity );
+		statistics->blocks[infoIndex] = result;
+	}
+	return result;
+}
+
+// sums up ticks of blocks, only the outermost block is measured for recursive functions
+static void accumulateProfilingFrameTicks( ProfilingStatistics* statistics,
+                                           ProfilingBlock* block )
+{
+	for( ; block; block = block->next ) {
+		if( statistics->depths[block->infoIndex]++ == 0 ) {
+			statistics->frameTicks[block->infoIndex] += block->duration;
+		}
+		accumulateProfilingFrameTicks( statistics, block->child );
+		--statistics->depths[block->infoIndex];
+	}
+}
+
+// adds the self ticks of block and its children to the node in nodes with the same info index
+static void mergeProfilingCallNode( ProfilingStatistics* statistics, ProfilingCallNode** nodes,
+                                    ProfilingBlock* block )
+{
+	auto node = *nodes;
+	while( node && node->infoIndex != block->infoIndex ) {
+		node = node->next;
+	}
+	if( !node ) {
+		if( statistics->outOfMemory ) {
+			return;
+		}
+		node = allocateStruct( &statistics->allocator, ProfilingCallNode );
+		if( !node ) {
+			statistics->outOfMemory = true;
+			OutOfMemory();
+			return;
+		}
+		*node           = {};
+		node->infoIndex = block->infoIndex;
+		node->next      = *nodes;
+		*nodes          = node;
+	}
+
+	uint64 childTicks = 0;
+	for( auto child = block->child; child; child = child->next ) {
+		childTicks += child->duration;
+		mergeProfilingCallNode( statistics, &node->child, child );
+	}
+	node->selfTicks += ( block->duration > childTicks ) ? ( block->duration - childTicks ) : ( 0 );
+}
+
+// adds a frame, state should be the result of processProfilingEvents of a single frame
+void updateProfilingStatistics( ProfilingStatistics* statistics, ProfilingState* state )
+{
+	assert( statistics );
+	assert( state );
+
+	statistics->droppedEvents = state->droppedEvents;
+	accumulateProfilingFrameTicks( statistics, state->blocks.head );
+	for( auto block = state->blocks.head; block; block = block->next ) {
+		assert( block->threadIndex < MAX_PROFILING_THREADS );
+		mergeProfilingCallNode( statistics, &statistics->threads[block->threadIndex], block );
+	}
+
+	// blocks that didn't run this frame still need their old sample evicted
+	auto frame = statistics->currentFrame;
+	for( int32 i = 0; i < MAX_PROFILING_INFOS; ++i ) {
+		auto ticks = statistics->frameTicks[i];
+		auto block = ( ticks ) ? ( getProfilingBlockStatistics( statistics, i ) )
+		                       : ( statistics->blocks[i] );
+		if( !block ) {
+			continue;
+		}
+		if( auto evicted = block->samples[frame] ) {
+			--block->histogram[getProfilingHistogramBucket( evicted )];
+			block->sum -= evicted;
+			--block->framesCount;
+		}
+		block->samples[frame] = ticks;
+		if( ticks ) {
+			++block->histogram[getProfilingHistogramBucket( ticks )];
+			block->sum += ticks;
+			++block->framesCount;
+		}
+		statistics->frameTicks[i] = 0;
+	}
+	statistics->currentFrame = ( frame + 1 ) % statistics->framesCapacity;
+	statistics->framesCount  = min( statistics->framesCount + 1, statistics->framesCapacity );
+}
+
+struct ProfilingBlockSummary {
+	uint64 min;
+	uint64 mean;
+	uint64 max;
+	uint64 p50;  // percentiles are upper bounds of histogram buckets
+	uint64 p95;
+	uint64 p99;
+	int32 framesCount;  // frames of the rolling window the block ran in
+};
+ProfilingBlockSummary getProfilingBlockSummary( ProfilingStatistics* statistics,
+                                                int32 infoIndex )
+{
+	assert( infoIndex >= 0 && infoIndex < MAX_PROFILING_INFOS );
+	ProfilingBlockSummary result = {};
+	auto block                   = statistics->blocks[infoIndex];
+	if( !block || !block->framesCount ) {
+		return result;
+	}
+
+	result.min = UINT64_MAX;
+	for( auto i = 0; i < statistics->framesCapacity; ++i ) {
+		if( auto ticks = block->samples[i] ) {
+			result.min = min( result.min, ticks );
+			result.max = max( result.max, ticks );
+		}
+	}
+	result.mean        = block->sum / block->framesCount;
+	result.framesCount = block->framesCount;
+
+	// nearest rank method
+	auto percentile = [block, &result]( int32 p ) {
+		auto rank  = ( p * block->framesCount + 99 ) / 100;
+		auto count = 0;
+		for( auto i = 0; i < ProfilingHistogramBuckets; ++i ) {
+			count += block->histogram[i];
+			if( count >= rank ) {
+				return min( getProfilingHistogramBucketMax( i ), result.max );
+			}
+		}
+		return result.max;
+	};
+	result.p50 = percentile( 50 );
+	result.p95 = percentile( 95 );
+	result.p99 = percentile( 99 );
+	return result;
+}
+
+static void resetProfilingCallNodes( ProfilingCallNode* node )
+{
+	for( ; node; node = node->next ) {
+		node->selfTicks = 0;
+		resetProfilingCallNodes( node->child );
+	}
+}
+// starts accumulating the call tree from scratch, the rolling window is kept
+// nodes are interleaved with block statistics in the allocator, so they are kept and only their
+// ticks are cleared
+void resetProfilingCallTree( ProfilingStatistics* statistics )
+{
+	for( auto root : statistics->threads ) {
+		resetProfilingCallNodes( root );
+	}
+}
+
+// max digits of uint64 + separators
+const size_t ProfilingFoldedLineOverhead = 24;
+
+static size_t getProfilingFoldedStacksSize( ProfilingTable* table, ProfilingCallNode* node,
+                                            size_t pathLength, int32 infosCount )
+{
+	size_t result = 0;
+	for( ; node; node = node->next ) {
+		auto length = pathLength;
+		if( node->infoIndex < infosCount ) {
+			length += 1 + strlen( table->infos[node->infoIndex].block );
+		}
+		result += length + ProfilingFoldedLineOverhead;
+		result += getProfilingFoldedStacksSize( table, node->child, length, infosCount );
+	}
+	return result;
+}
+// size of the output of writeProfilingFoldedStacks
+size_t getProfilingFoldedStacksSize( ProfilingStatistics* statistics, ProfilingTable* table )
+{
+	auto infosCount = table->infosCount.load( std::memory_order_acquire );
+	size_t result   = 1;
+	for( auto root : statistics->threads ) {
+		result += getProfilingFoldedStacksSize( table, root, ProfilingFoldedLineOverhead,
+		                                        infosCount );
+	}
+	return result;
+}
+
+static void writeProfilingFoldedStacks( string_builder* builder, ProfilingTable* table,
+                                        ProfilingCallNode* node, char* path, int32 pathLength,
+                                        int32 pathCapacity, int32 infosCount )
+{
+	for( ; node; node = node->next ) {
+		auto length = pathLength;
+		if( node->infoIndex < infosCount ) {
+			length += snprint( path + length, pathCapacity - length, ";{}",
+			                   table->infos[node->infoIndex].block );
+		}
+		if( node->selfTicks ) {
+			builder->print( "{} {}\n", StringView( path, length ), node->selfTicks );
+		}
+		writeProfilingFoldedStacks( builder, table, node->child, path, length, pathCapacity,
+		                            infosCount );
+	}
+}
+
+// writes the call tree as folded stacks, one "thread;block;child ticks" line per call path
+// the output can be turned into a flame graph with flamegraph.pl or opened in speedscope
+void writeProfilingFoldedStacks( string_builder* builder, ProfilingStatistics* statistics,
+                                 ProfilingTable* table )
+{
+	auto infosCount = table->infosCount.load( std::memory_order_acquire );
+	char path[4096];
+	for( auto i = 0; i < MAX_PROFILING_THREADS; ++i ) {
+		if( !statistics->threads[i] ) {
+			continue;
+		}
+		auto length = snprint( path, countof( path ), "Thread {}", i );
+		writeProfilingFoldedStacks( builder, table, statistics->threads[i], path, length,
+		                            countof( path ), infosCount );
+	}
+}
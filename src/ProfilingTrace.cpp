@@ -0,0 +1,156 @@
+// export of profiling captures in the chrome trace event format, which can be opened in
+// chrome://tracing or ui.perfetto.dev
+// timestamps are converted from rdtsc ticks to microseconds relative to an origin timestamp
+
+static StringView getProfilingTraceCategory( const char* file )
+{
+	// use the filename without directories, so that events are grouped by source file
+	auto result = StringView( file );
+	for( auto i = result.size() - 1; i >= 0; --i ) {
+		if( result[i] == '/' || result[i] == '\\' ) {
+			return substr( result, i + 1 );
+		}
+	}
+	return result;
+}
+
+// worst case size of the metadata event that names one thread
+static const size_t ProfilingTraceThreadNameSize = 128;
+
+// worst case size of the trace of a capture, used to size the buffer of the JsonWriter
+size_t getProfilingTraceSize( ProfilingCapture* capture, ProfilingTable* table )
+{
+	auto infosCount   = table->infosCount.load( std::memory_order_acquire );
+	size_t infoLength = 0;
+	for( auto i = 0; i < infosCount; ++i ) {
+		auto info  = &table->infos[i];
+		infoLength = max( infoLength, strlen( info->file ) + strlen( info->block ) );
+	}
+	// names might need escaping, so every character can become two characters
+	const size_t eventSize = 128 + infoLength * 2;
+	size_t result          = 256 + MAX_PROFILING_THREADS * ProfilingTraceThreadNameSize;
+	FOR( thread : capture->threads ) {
+		result += thread.events.size() * eventSize;
+	}
+	return result;
+}
+
+static void writeProfilingTraceTimestamp( JsonWriter* writer, uint64 timestamp,
+                                          uint64 originTimestamp, double microsecondsPerTick )
+{
+	auto microseconds =
+	    ( timestamp > originTimestamp ) ? ( timestamp - originTimestamp ) * microsecondsPerTick : 0;
+	writePropertyName( writer, "ts" );
+	writeComma( writer );
+	writer->isNotFirst    = true;
+	writer->isNotProperty = true;
+
+	// JsonWriter has no double overload, write it directly so that long sessions keep their
+	// precision
+	auto builder     = &writer->builder;
+	auto format      = defaultPrintFormat();
+	format.precision = 3;
+	builder->sz += print_double( builder->end(), builder->remaining(), &format, microseconds );
+}
+
+// writes the events of a capture as trace event objects into the current json array
+// blocks that have no begin event inside of the capture are skipped
+void writeProfilingTraceEvents( JsonWriter* writer, ProfilingCapture* capture,
+                                ProfilingTable* table, uint64 originTimestamp,
+                                double microsecondsPerTick )
+{
+	assert( writer );
+	assert( capture );
+	assert( table );
+
+	auto infosCount = table->infosCount.load( std::memory_order_acquire );
+	FOR( thread : capture->threads ) {
+		int32 depth = 0;
+		FOR( event : thread.events ) {
+			if( event.type == ProfilingEvent::End && depth <= 0 ) {
+				continue;
+			}
+			if( event.type != ProfilingEvent::FrameMarker && event.infoIndex >= infosCount ) {
+				continue;
+			}
+
+			writeStartObject( writer );
+			switch( event.type ) {
+				case ProfilingEvent::Begin: {
+					auto info = &table->infos[event.infoIndex];
+					writeProperty( writer, "name", StringView( info->block ) );
+					writeProperty( writer, "cat", getProfilingTraceCategory( info->file ) );
+					writeProperty( writer, "ph", StringView( "B" ) );
+					++depth;
+					break;
+				}
+				case ProfilingEvent::End: {
+					writeProperty( writer, "ph", StringView( "E" ) );
+					--depth;
+					break;
+				}
+				case ProfilingEvent::FrameMarker: {
+					writeProperty( writer, "name", StringView( "Frame" ) );
+					writeProperty( writer, "ph", StringView( "i" ) );
+					writeProperty( writer, "s", StringView( "g" ) );
+					break;
+				}
+					InvalidDefaultCase;
+			}
+			writeProfilingTraceTimestamp( writer, event.timestamp, originTimestamp,
+			                              microsecondsPerTick );
+			writeProperty( writer, "pid", 1 );
+			writeProperty( writer, "tid", thread.threadIndex );
+			writeEndObject( writer );
+		}
+	}
+}
+
+// writes names of the threads that have a buffer in the table, so that threads show up with names
+// instead of ids in the viewer
+void writeProfilingTraceMetadata( JsonWriter* writer, ProfilingTable* table )
+{
+	for( auto i = 0; i < MAX_PROFILING_THREADS; ++i ) {
+		if( !table->threads[i].owner.load( std::memory_order_relaxed ) ) {
+			continue;
+		}
+		writeStartObject( writer );
+		writeProperty( writer, "name", StringView( "thread_name" ) );
+		writeProperty( writer, "ph", StringView( "M" ) );
+		writeProperty( writer, "pid", 1 );
+		writeProperty( writer, "tid", i );
+		writePropertyName( writer, "args" );
+		writeStartObject( writer );
+		static_string_builder< 32 > name;
+		name.print( "Thread {}", i );
+		writeProperty( writer, "name", asStringView( name ) );
+		writeEndObject( writer );
+		writeEndObject( writer );
+	}
+}
+
+// writes the properties that follow traceEvents, droppedEvents is shown in the metadata of the
+// viewer, so that a trace that is missing threads doesn't look complete
+void writeProfilingTraceOtherData( JsonWriter* writer, uint32 droppedEvents )
+{
+	writeProperty( writer, "displayTimeUnit", StringView( "ms" ) );
+	writePropertyName( writer, "otherData" );
+	writeStartObject( writer );
+	writeProperty( writer, "droppedEvents", droppedEvents );
+	writeEndObject( writer );
+}
+
+// writes a complete trace document of a capture
+void writeProfilingTrace( JsonWriter* writer, ProfilingCapture* capture, ProfilingTable* table,
+                          double microsecondsPerTick )
+{
+	writeStartObject( writer );
+	writePropertyName( writer, "traceEvents" );
+	writeStartArray( writer );
+	writeProfilingTraceMetadata( writer, table );
+	writeProfilingTraceEvents( writer, capture, table, capture->beginTimestamp,
+	                           microsecondsPerTick );
+	writeEndArray( writer );
+	writeProfilingTraceOtherData( writer, capture->droppedEvents );
+	writeEndObject( writer );
+}
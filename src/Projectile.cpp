@@ -62,8 +62,8 @@ ProjectileSystem makeProjectileSystem( StackAllocator* allocator, int32 maxProje
 	};
 
 	for( int32 i = 0, count = (int32)ProjectileType::Count; i < count; ++i ) {
-		TEMPORARY_MEMORY_BLOCK( GlobalScrap ) {
-			auto definitionAllocator = makeStackAllocator( GlobalScrap, kilobytes( 10 ) );
+		SCRATCH_MEMORY_BLOCK( scratch ) {
+			auto definitionAllocator = makeStackAllocator( scratch, kilobytes( 10 ) );
 			auto filename  = Files[i];
 			auto dest      = &result.data[i];
 
@@ -132,27 +132,32 @@ bool emitProjectile( GameState* game, vec2arg origin, vec2arg direction, Project
 	// TODO: emit different types of projectiles based on upgrades
 	auto system = &game->projectileSystem;
 	if( system->entries.remaining() ) {
+		auto handle = addEntityHandle( &game->entityHandles );
+		if( !handle ) {
+			return false;
+		}
 		auto projectile = system->entries.emplace_back();
 		auto traits     = getProjectileTraits( type );
 
 		*projectile = {
-		    origin,                                   // position
-		    direction * traits->initialSpeed,         // velocity
-		    direction * traits->acceleration,         // acceleration
-		    {},                                       // positionDelta
-		    addEntityHandle( &game->entityHandles ),  // handle
-		    type,                                     // type
-		    traits->durability,                       // durability
-		    team,                                     // team
-		    {false},                                  // deflected
-		    traits->alive,                            // aliveCountdown
+		    origin,                            // position
+		    direction * traits->initialSpeed,  // velocity
+		    direction * traits->acceleration,  // acceleration
+		    {},                                // positionDelta
+		    handle,                            // handle
+		    type,                              // type
+		    traits->durability,                // durability
+		    team,                              // team
+		    {false},                           // deflected
+		    traits->alive,                     // aliveCountdown
 		};
 		return true;
 	}
 	return false;
 }
 
-void processProjectiles( GameState* game, TileGrid grid, Array< Entity > dynamics, float dt )
+void processProjectiles( GameState* game, TileGrid grid, TileOccupancy occupancy,
+                         Array< Entity > dynamics, float dt )
 {
 	using namespace GameConstants;
 
@@ -192,8 +197,9 @@ void processProjectiles( GameState* game, TileGrid grid, Array< Entity > dynamic
 		    getSweptTileGridRegion( data->collision, entry.position, velocity, MapBounds );
 		constexpr const auto maxIterations = 4;
 		for( auto iterations = 0; iterations < maxIterations && remaining > 0.0f; ++iterations ) {
-			const auto collision = findCollision( data->collision, entry.position, velocity, grid,
-			                                      tileGridRegion, dynamics, remaining, false );
+			const auto collision =
+			    findCollision( data->collision, entry.position, velocity, grid, occupancy,
+			                   tileGridRegion, dynamics, remaining, false );
 
 			const auto& info = collision.info;
 			if( collision ) {
@@ -272,8 +278,8 @@ void processProjectiles( GameState* game, TileGrid grid, Array< Entity > dynamic
 		entry.positionDelta = entry.position - oldPosition;
 	}
 
-	TEMPORARY_MEMORY_BLOCK( GlobalScrap ) {
-		auto handles = beginVector( GlobalScrap, EntityHandle );
+	SCRATCH_MEMORY_BLOCK( scratch ) {
+		auto handles = beginVector( scratch, EntityHandle );
 		erase_if( system->entries, [&]( const Projectile& entry ) {
 			if( !entry.aliveCountdown ) {
 				emitParticles( &game->particleSystem, entry.position,
@@ -286,6 +292,10 @@ void processProjectiles( GameState* game, TileGrid grid, Array< Entity > dynamic
 			}
 			return dead;
 		} );
-		removeEntities( &game->hitboxSystem, makeArrayView( handles ) );
+		endVector( scratch, &handles );
+		auto removed = makeArrayView( handles );
+		removeEntities( &game->hitboxSystem,
+		                makeEntityHandleSet( scratch, &game->entityHandles, removed ) );
+		removeEntityHandles( &game->entityHandles, removed );
 	}
 }
\ No newline at end of file
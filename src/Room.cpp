@@ -31,6 +31,89 @@ enum RoomLayerValues {
 };
 typedef Grid< GameTile > TileGrid;
 
+// which tiles of a layer are occupied, so that collision doesn't need to load every tile
+// occupied tiles are also greedily merged into rectangles, so that collision can test one box for
+// a run of solid tiles instead of every tile, the tile a collision happened with is recovered from
+// the rectangle (see getTileFromCollisionRect)
+struct TileOccupancy {
+	Grid< uint32 > bits;     // bit x % 32 of word x / 32 in row y is set if the tile is occupied
+	UArray< recti > rects;   // merged occupied tiles, in tiles
+	Grid< int32 > rectIds;   // index + 1 of the rect covering the tile, 0 if the tile is empty
+};
+
+TileOccupancy makeTileOccupancy( StackAllocator* allocator, int32 width, int32 height )
+{
+	TileOccupancy result = {};
+	result.bits          = makeGrid( allocator, uint32, ( width + 31 ) / 32, height );
+	result.rects         = makeUArray( allocator, recti, width * height );
+	result.rectIds       = makeGrid( allocator, int32, width, height );
+	zeroMemory( result.bits.data(), result.bits.size() );
+	zeroMemory( result.rectIds.data(), result.rectIds.size() );
+	return result;
+}
+bool isTileOccupied( TileOccupancy occupancy, int32 x, int32 y )
+{
+	return ( occupancy.bits.at( x / 32, y ) & ( 1u << ( x % 32 ) ) ) != 0;
+}
+
+static void setTileRectIds( TileOccupancy* occupancy, recti rect, int32 id )
+{
+	for( auto y = rect.top; y < rect.bottom; ++y ) {
+		for( auto x = rect.left; x < rect.right; ++x ) {
+			occupancy->rectIds.at( x, y ) = id;
+		}
+	}
+}
+// greedily merges the occupied tiles inside region that aren't covered by a rect yet
+static void mergeTileRects( TileOccupancy* occupancy, recti region )
+{
+	auto isFree = [occupancy]( int32 x, int32 y ) {
+		return isTileOccupied( *occupancy, x, y ) && !occupancy->rectIds.at( x, y );
+	};
+	for( auto y = region.top; y < region.bottom; ++y ) {
+		for( auto x = region.left; x < region.right; ++x ) {
+			if( !isFree( x, y ) ) {
+				continue;
+			}
+			recti rect = {x, y, x + 1, y + 1};
+			while( rect.right < region.right && isFree( rect.right, y ) ) {
+				++rect.right;
+			}
+			for( ; rect.bottom < region.bottom; ++rect.bottom ) {
+				auto solidRow = true;
+				for( auto i = rect.left; i < rect.right && solidRow; ++i ) {
+					solidRow = isFree( i, rect.bottom );
+				}
+				if( !solidRow ) {
+					break;
+				}
+			}
+			assert( !occupancy->rects.full() );
+			occupancy->rects.push_back( rect );
+			setTileRectIds( occupancy, rect, occupancy->rects.size() );
+			x = rect.right - 1;
+		}
+	}
+}
+// rebuilds occupancy of all tiles, needs to be called after tiles of grid were changed
+void updateTileOccupancy( TileOccupancy* occupancy, TileGrid grid )
+{
+	assert( occupancy->bits.width == ( grid.width + 31 ) / 32 );
+	assert( occupancy->bits.height == grid.height );
+	assert( occupancy->rectIds.width == grid.width );
+	assert( occupancy->rectIds.height == grid.height );
+	zeroMemory( occupancy->bits.data(), occupancy->bits.size() );
+	zeroMemory( occupancy->rectIds.data(), occupancy->rectIds.size() );
+	occupancy->rects.clear();
+	for( auto y = 0; y < grid.height; ++y ) {
+		for( auto x = 0; x < grid.width; ++x ) {
+			if( grid.at( x, y ) ) {
+				occupancy->bits.at( x / 32, y ) |= 1u << ( x % 32 );
+			}
+		}
+	}
+	mergeTileRects( occupancy, {0, 0, grid.width, grid.height} );
+}
 enum class RoomBackgroundType {
 	BlueSky,
 };
@@ -44,6 +127,7 @@ StringView to_string( RoomBackgroundType type )
 struct Room {
 	struct Layer {
 		TileGrid grid;
+		TileOccupancy occupancy;
 	};
 	Layer layers[RL_Count];
 	TileSet* tileSet;
@@ -68,17 +152,23 @@ void renderBackground( RenderCommands* renderer, RoomBackgroundType background )
 }
 
 TileGrid getCollisionLayer( Room* room ) { return room->layers[RL_Main].grid; }
+TileOccupancy getCollisionOccupancy( Room* room ) { return room->layers[RL_Main].occupancy; }
 
-bool loadTileSet( StackAllocator* allocator, StringView filename, TileSet* out ) {
-	if( !loadVoxelCollection( allocator, filename, &out->voxels ) ) {
-		return false;
-	}
+// fills the tile infos from the already loaded voxels of the tile set
+void makeTileSetInfos( StackAllocator* allocator, TileSet* out )
+{
 	out->infos = makeArray( allocator, TileInfo, out->voxels.frameInfos.size() );
 	for( auto i = 0; i < out->infos.size(); ++i ) {
 		auto dest = &out->infos[i];
 		*dest = {};
 		dest->frictionCoefficient = out->voxels.frameInfos[i].frictionCoefficient;
 	}
+}
+bool loadTileSet( StackAllocator* allocator, StringView filename, TileSet* out ) {
+	if( !loadVoxelCollection( allocator, filename, &out->voxels ) ) {
+		return false;
+	}
+	makeTileSetInfos( allocator, out );
 	return true;
 }
 
@@ -126,6 +216,7 @@ Room makeRoom( StackAllocator* allocator, int32 width, int32 height )
 	FOR( layer : result.layers ) {
 		layer.grid = makeGrid( allocator, GameTile, width, height );
 		zeroMemory( layer.grid.data(), layer.grid.size() );
+		layer.occupancy = makeTileOccupancy( allocator, width, height );
 	}
 	return result;
 }
@@ -180,5 +271,8 @@ static Room debugGetRoom( StackAllocator* allocator, TileSet* tileSet )
 	};
 	processLayer( result.layers[RL_Main].grid, GameDebugMapMain );
 	processLayer( result.layers[RL_Front].grid, GameDebugMapFront );
+	FOR( layer : result.layers ) {
+		updateTileOccupancy( &layer.occupancy, layer.grid );
+	}
 	return result;
 }
\ No newline at end of file
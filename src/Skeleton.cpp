@@ -17,9 +17,8 @@ void readNodes( StackAllocator* allocator, const JsonObject& attr,
                 Array< SkeletonEmitterState >* emitters, Array< SkeletonHitboxState >* hitboxes,
                 bool base )
 {
-	auto transformsAttr        = attr["transforms"].getObjectArray();
-	const auto transformsCount = transformsAttr.size();
-	auto readTransforms        = [base]( const JsonObject& attr, SkeletonTransform* dest ) {
+	auto transformsAttr = attr["transforms"].getObjectArray();
+	auto readTransforms = [base]( const JsonObject& attr, SkeletonTransform* dest ) {
 		deserialize( attr["id"], dest->id, -1 );
 		deserialize( attr["translation"], dest->translation );
 		deserialize( attr["rotation"], dest->rotation );
@@ -134,9 +133,9 @@ bool applyPermutation( Array< T > array, Array< int16 > permutation )
 		return false;
 	}
 
-	TEMPORARY_MEMORY_BLOCK( GlobalScrap ) {
+	SCRATCH_MEMORY_BLOCK( scratch ) {
 		const auto count = array.size();
-		auto oldValues = makeArray( GlobalScrap, int16, count );
+		auto oldValues = makeArray( scratch, int16, count );
 		iota_n( oldValues.begin(), count, (int16)0 );
 		for( auto i = 0; i < count; ++i ) {
 			auto perm    = permutation[i];
@@ -150,7 +149,7 @@ bool applyPermutation( Array< T > array, Array< int16 > permutation )
 }
 bool sortTransforms( Array< SkeletonTransform > transforms )
 {
-	auto scrap = GlobalScrap;
+	auto scrap = getThreadScratch();
 	const auto transformsCount = transforms.size();
 	TEMPORARY_MEMORY_BLOCK( scrap ) {
 		// init children counts
@@ -235,9 +234,9 @@ bool applyPermutationByIds( Array< T > array, Array< int16 > ids )
 		return false;
 	}
 
-	TEMPORARY_MEMORY_BLOCK( GlobalScrap ) {
+	SCRATCH_MEMORY_BLOCK( scratch ) {
 		const auto count = array.size();
-		auto permutation = makeArray( GlobalScrap, int16, count );
+		auto permutation = makeArray( scratch, int16, count );
 		for( auto i = 0; i < count; ++i ) {
 			auto id        = ids[i];
 			permutation[i] = auto_truncate(
@@ -258,9 +257,9 @@ bool applyPermutationByIds( Array< T > array, Array< T > base )
 		return false;
 	}
 
-	TEMPORARY_MEMORY_BLOCK( GlobalScrap ) {
+	SCRATCH_MEMORY_BLOCK( scratch ) {
 		const auto count = array.size();
-		auto ids         = makeArray( GlobalScrap, int16, count );
+		auto ids         = makeArray( scratch, int16, count );
 		for( auto i = 0; i < count; ++i ) {
 			ids[i] = base[i].id;
 		}
@@ -273,20 +272,20 @@ bool applyPermutationByIds( Array< T > array, Array< T > base )
 bool loadSkeletonDefinitionImpl( StackAllocator* allocator, StringView filename,
                                  SkeletonDefinition* out )
 {
-	// allocator can't be GlobalScrap because this function uses GlobalScrap itself and out will be
-	// wiped as a result at the end
-	assert( allocator != GlobalScrap );
+	// allocator can't be the scratch allocator of this thread because this function uses it itself
+	// and out will be wiped as a result at the end
+	assert( allocator != getThreadScratch() );
 
 #define ABORT_ERROR( str, ... )                            \
 	do {                                                   \
 		LOG( ERROR, "{}: " str, filename, ##__VA_ARGS__ ); \
-		__debugbreak();                                    \
+		debug_break();                                     \
 		return false;                                      \
 	} while( false )
 
 	auto guard = StackAllocatorGuard( allocator );
 
-	auto scrap = GlobalScrap;
+	auto scrap = getThreadScratch();
 	TEMPORARY_MEMORY_BLOCK( scrap ) {
 		auto file = readFile( scrap, filename );
 		auto doc = makeJsonDocument( scrap, file );
@@ -392,9 +391,8 @@ bool loadSkeletonDefinitionImpl( StackAllocator* allocator, StringView filename,
 		if( nodes ) {
 			TEMPORARY_MEMORY_BLOCK( scrap ) {
 				// idents
-				auto idents            = nodes["idents"].getObjectArray();
-				const auto identsCount = idents.size();
-				auto readIdents        = []( const JsonObject& attr, SkeletonId* dest ) {
+				auto idents     = nodes["idents"].getObjectArray();
+				auto readIdents = []( const JsonObject& attr, SkeletonId* dest ) {
 					deserialize( attr["id"], dest->id, -1 );
 					dest->nameLength = (int16)copyToString( attr["name"].getString(), dest->name );
 				};
@@ -995,7 +993,7 @@ void update( Skeleton* skeleton, ParticleSystem* particleSystem, float dt )
 		auto interpolateKeyframeData = [ease]( Array< BezierForwardDifferencerData > curves,
 		                                       float currentFrame, const auto& keyframes,
 		                                       int16 index, auto def ) {
-			typeof( keyframes )::value_type::value_type result = def;
+			typename typeof( keyframes )::value_type::value_type result = def;
 			if( index >= 0 && index < keyframes.size() ) {
 				auto current = &keyframes[index];
 				if( index + 1 < keyframes.size() ) {
@@ -1013,14 +1011,14 @@ void update( Skeleton* skeleton, ParticleSystem* particleSystem, float dt )
 		auto processKeyframe = [findCurrentKeyframe, interpolateKeyframeData](
 		    Array< BezierForwardDifferencerData > curves, float currentFrame, const auto& keyframes,
 		    int16* index, auto* data ) {
-			typeof( keyframes )::value_type::value_type def = {};
+			typename typeof( keyframes )::value_type::value_type def = {};
 			*index = findCurrentKeyframe( currentFrame, keyframes, *index );
 			*data += interpolateKeyframeData( curves, currentFrame, keyframes, *index, def );
 		};
 		auto processScale = [findCurrentKeyframe, interpolateKeyframeData](
 		    Array< BezierForwardDifferencerData > curves, float currentFrame, const auto& keyframes,
 		    int16* index, auto* data ) {
-			typeof( keyframes )::value_type::value_type def = {1, 1, 1};
+			typename typeof( keyframes )::value_type::value_type def = {1, 1, 1};
 			*index = findCurrentKeyframe( currentFrame, keyframes, *index );
 			*data  = multiplyComponents(
 			    interpolateKeyframeData( curves, currentFrame, keyframes, *index, def ), *data );
@@ -1028,14 +1026,14 @@ void update( Skeleton* skeleton, ParticleSystem* particleSystem, float dt )
 		auto processColor = [findCurrentKeyframe, interpolateKeyframeData](
 		    Array< BezierForwardDifferencerData > curves, float currentFrame, const auto& keyframes,
 		    int16* index, auto* data ) {
-			typeof( keyframes )::value_type::value_type def = {};
+			typename typeof( keyframes )::value_type::value_type def = {};
 			*index = findCurrentKeyframe( currentFrame, keyframes, *index );
 			*data  = interpolateKeyframeData( curves, currentFrame, keyframes, *index, def );
 		};
 		auto processCustom = [findCurrentKeyframe]( Array< BezierForwardDifferencerData > curves,
 		                                            float currentFrame, const auto& keyframes,
 		                                            int16* index, auto* data ) {
-			typeof( keyframes )::value_type::value_type def = {};
+			typename typeof( keyframes )::value_type::value_type def = {};
 			*index = findCurrentKeyframe( currentFrame, keyframes, *index );
 			if( *index >= 0 ) {
 				*data = keyframes[*index].data;
@@ -1460,7 +1458,6 @@ SkeletonSystem makeSkeletonSystem()
 
 Skeleton* addSkeleton( SkeletonSystem* system, const SkeletonDefinition& definition )
 {
-	auto findEmptySkeleton = []( SkeletonSystem* system ) -> Skeleton** {};
 	if( !system->skeletons.remaining() ) {
 		const auto newSize = system->skeletons.capacity() * 2;
 		system->skeletons  = makeInitializedArrayView(
@@ -1575,6 +1572,9 @@ Entity* addEntity( EntitySystem* entitySystem, SkeletonSystem* skeletonSystem, E
 		result->bounceModifier          = traits->init.bounceModifier;
 		result->airFrictionCoeffictient = traits->init.airFrictionCoeffictient;
 		result->team                    = traits->team;
+		result->details                 = allocateEntityDetails( entitySystem );
+		// static entries are inserted in front of dynamics, which moves them
+		updateEntityIndices( entitySystem, indexof( entitySystem->entries, *result ) );
 
 		auto skeletonTraits = getSkeletonTraits( skeletonSystem, type );
 		if( skeletonTraits && skeletonTraits->definition && *skeletonTraits->definition ) {
@@ -1585,14 +1585,16 @@ Entity* addEntity( EntitySystem* entitySystem, SkeletonSystem* skeletonSystem, E
 
 		switch( type ) {
 			case Entity::type_hero: {
-				result->hero.stats                 = traits->stats;
-				result->hero.currentAnimationIndex = -1;
-				result->hero.currentAnimation      = -1;
+				auto hero                   = &result->hero();
+				hero->stats                 = traits->stats;
+				hero->currentAnimationIndex = -1;
+				hero->currentAnimation      = -1;
 				break;
 			}
 			case Entity::type_wheels: {
-				result->wheels.stats            = traits->stats;
-				result->wheels.currentAnimation = -1;
+				auto wheels              = &result->wheels();
+				wheels->stats            = traits->stats;
+				wheels->currentAnimation = -1;
 				break;
 			}
 		}
@@ -0,0 +1,152 @@
+// per thread scratch allocators, so that code using scratch memory can run on any thread
+// every thread that calls getThreadScratch gets its own growable arena, which is reserved the first
+// time the arena is used and kept for the next thread when the thread exits
+// the main thread is bound to GlobalScrap, so that scratch memory of the main thread and
+// GlobalScrap are the same allocator
+// usage:
+//     SCRATCH_MEMORY_BLOCK( scratch ) {
+//         auto data = makeArray( scratch, int32, count );
+//     }
+// SCRATCH_MEMORY_BLOCK asserts that the thread got an arena, code that can handle running out of
+// arenas calls getThreadScratch and checks for nullptr
+
+// one arena for every job worker, the main thread is worker 0 and bound to the first arena, and one
+// for a thread outside of the JobSystem
+#define MAX_SCRATCH_ARENAS ( MAX_JOB_WORKERS + 1 )
+
+struct ScratchArena {
+	std::atomic< uint32 > owner;  // thread id of the thread using the arena, 0 if unused
+	StackAllocator* allocator;    // storage or the allocator bound with bindThreadScratch
+	StackAllocator storage;
+};
+
+struct ScratchTable {
+	VirtualMemoryServices* virtualMemory;
+	size_t reserveSize;  // address space reserved for every arena
+	ScratchArena arenas[MAX_SCRATCH_ARENAS];
+};
+
+global_var ScratchTable* GlobalScratchTable = nullptr;
+
+struct ScratchRegistration {
+	uint32 threadId;
+	ScratchArena* arena;
+
+	// threads give up their arena when they exit, the memory stays reserved for the next thread
+	~ScratchRegistration()
+	{
+		if( arena && arena->owner.load( std::memory_order_relaxed ) == threadId ) {
+			clear( arena->allocator );
+			arena->owner.store( 0, std::memory_order_release );
+		}
+	}
+};
+static ScratchRegistration* getScratchRegistration()
+{
+	static std::atomic< uint32 > nextThreadId( 1 );
+	static thread_local ScratchRegistration registration = {nextThreadId.fetch_add( 1 ), nullptr};
+	return &registration;
+}
+
+// virtualMemory needs to outlive the table, arenas are reserved lazily
+void initScratchTable( ScratchTable* table, VirtualMemoryServices* virtualMemory,
+                       size_t reserveSize )
+{
+	assert( table );
+	assert( virtualMemory );
+	table->virtualMemory = virtualMemory;
+	table->reserveSize   = reserveSize;
+	for( auto& arena : table->arenas ) {
+		arena.owner     = 0;
+		arena.allocator = nullptr;
+		arena.storage   = {};
+	}
+}
+
+// gives up ownership of all arenas, needed when the dll is reloaded, since thread ids start over
+// reserved memory is kept
+void clearScratchTable( ScratchTable* table )
+{
+	assert( table );
+	for( auto& arena : table->arenas ) {
+		arena.owner     = 0;
+		arena.allocator = ( arena.storage.ptr ) ? ( &arena.storage ) : ( nullptr );
+		if( arena.allocator ) {
+			clear( arena.allocator );
+		}
+	}
+}
+
+// binds allocator as the scratch allocator of the calling thread, it uses the first arena
+void bindThreadScratch( ScratchTable* table, StackAllocator* allocator )
+{
+	assert( table );
+	assert( isValid( allocator ) );
+	auto registration = getScratchRegistration();
+	auto arena        = &table->arenas[0];
+	arena->allocator  = allocator;
+	arena->owner.store( registration->threadId, std::memory_order_release );
+	registration->arena = arena;
+}
+
+static ScratchArena* registerScratchArena( uint32 threadId )
+{
+	auto table = GlobalScratchTable;
+	if( !table->virtualMemory->reserve ) {
+		LOG( ERROR, "Scratch arenas need virtual memory" );
+		return nullptr;
+	}
+	// the first arena is reserved for the thread bound with bindThreadScratch
+	for( auto i = 1; i < MAX_SCRATCH_ARENAS; ++i ) {
+		auto arena    = &table->arenas[i];
+		uint32 unused = 0;
+		if( !arena->owner.compare_exchange_strong( unused, threadId,
+		                                           std::memory_order_acquire ) ) {
+			continue;
+		}
+		// only the owner touches the arena, so reserving doesn't need to be synchronized
+		if( !arena->storage.ptr ) {
+			arena->storage = makeGrowableStackAllocator( table->virtualMemory, table->reserveSize );
+			if( !arena->storage.ptr ) {
+				arena->owner.store( 0, std::memory_order_release );
+				OutOfMemory();
+				return nullptr;
+			}
+		}
+		arena->allocator = &arena->storage;
+		return arena;
+	}
+	LOG( ERROR, "Too many threads use scratch memory" );
+	return nullptr;
+}
+
+// scratch allocator of the calling thread, nullptr if the arenas are used up
+// only the calling thread may use the allocator, it doesn't need to be synchronized
+StackAllocator* getThreadScratch()
+{
+	auto registration = getScratchRegistration();
+	auto arena        = registration->arena;
+	// the table lives in game memory, which gets cleared when the game is restarted, so we check
+	// whether we still own the arena
+	if( !arena || arena->owner.load( std::memory_order_relaxed ) != registration->threadId ) {
+		arena               = registerScratchArena( registration->threadId );
+		registration->arena = arena;
+	}
+	return ( arena ) ? ( arena->allocator ) : ( nullptr );
+}
+
+// like getThreadScratch, for callers that can't go on without scratch memory
+StackAllocator* requireThreadScratch()
+{
+	auto result = getThreadScratch();
+	assert_m( result, "Thread has no scratch arena, MAX_SCRATCH_ARENAS is too small" );
+	return result;
+}
+
+// both loops end the block, so that break inside of it leaves the block like it does with
+// TEMPORARY_MEMORY_BLOCK
+#define SCRATCH_MEMORY_BLOCK( name )                                    \
+	if( auto _once = false ) {                                          \
+	} else                                                              \
+		for( auto name = requireThreadScratch(); !_once; _once = true ) \
+			for( auto _scope = TemporaryMemoryGuard( name ); !_once; _once = true )
@@ -1,3 +1,5 @@
+#include <mutex>
+
 struct VoxelCollection {
 	struct Frame {
 		MeshId mesh;
@@ -44,6 +46,66 @@ Array< VoxelCollection::Frame > getAnimationFrames( VoxelCollection* collection,
 	return makeRangeView( collection->frames, getAnimationRange( collection, name ) );
 }
 
+// parses the frames and animations of a voxel collection json without loading its texture
+// textureSize is used to normalize the texture coordinates, all textureMaps use texture
+void parseVoxelCollection( StackAllocator* allocator, JsonObject root, TextureId texture,
+                           vec2 textureSize, VoxelCollection* out )
+{
+	assert( out );
+
+	auto itw = 1.0f / textureSize.x;
+	auto ith = 1.0f / textureSize.y;
+
+	auto mapping      = root["mapping"].getArray();
+	int32 framesCount = 0;
+	FOR( animationVal : mapping ) {
+		auto animation = animationVal.getObject();
+		framesCount += animation["frames"].getArray().size();
+	}
+
+	out->texture    = texture;
+	out->frames     = makeArray( allocator, VoxelCollection::Frame, framesCount );
+	out->frameInfos = makeArray( allocator, VoxelCollection::FrameInfo, framesCount );
+	out->animations = makeArray( allocator, VoxelCollection::Animation, mapping.size() );
+
+	int32 currentFrame = 0;
+	for( int32 i = 0, count = mapping.size(); i < count; ++i ) {
+		auto animation  = mapping[i].getObject();
+		auto dest       = &out->animations[i];
+		dest->name      = makeString( allocator, animation["name"].getString() );
+		dest->range.min = safe_truncate< uint16 >( currentFrame );
+
+		FOR( frameVal : animation["frames"].getArray() ) {
+			auto frame     = frameVal.getObject();
+			auto destFrame = &out->frames[currentFrame];
+			auto destInfo  = &out->frameInfos[currentFrame];
+			++currentFrame;
+
+			*destFrame                    = {};
+			*destInfo                     = {};
+			destInfo->frictionCoefficient = 1;
+
+			for( uint32 face = 0; face < VF_Count; ++face ) {
+				auto faceObject = frame[VoxelFaceStrings[face]].getObject();
+
+				destInfo->textureMap.texture = texture;
+				deserialize( faceObject["rect"], destInfo->textureRegion[face] );
+				deserialize( faceObject["texCoords"],
+				             destInfo->textureMap.entries[face].texCoords );
+				destInfo->frictionCoefficient = faceObject["frictionCoefficient"].getFloat( 1 );
+				FOR( vert : destInfo->textureMap.entries[face].texCoords.elements ) {
+					vert.x *= itw;
+					vert.y *= ith;
+				}
+			}
+			deserialize( frame["offset"], destFrame->offset );
+		}
+
+		dest->range.max = safe_truncate< uint16 >( currentFrame );
+	}
+	out->voxelsFilename = makeString( allocator, root["voxels"].getString() );
+}
+
 bool loadVoxelCollectionTextureMapping( StackAllocator* allocator, StringView filename,
                                         VoxelCollection* out )
 {
@@ -51,7 +113,7 @@ bool loadVoxelCollectionTextureMapping( StackAllocator* allocator, StringView fi
 
 	auto guard = StackAllocatorGuard( allocator );
 	auto primary = allocator;
-	auto scrap   = GlobalScrap;
+	auto scrap   = getThreadScratch();
 	TEMPORARY_MEMORY_BLOCK( scrap ) {
 		auto file = readFile( scrap, filename );
 		auto doc  = makeJsonDocument( scrap, file );
@@ -61,61 +123,12 @@ bool loadVoxelCollectionTextureMapping( StackAllocator* allocator, StringView fi
 		auto root = doc.root.getObject();
 
 		*out         = {};
-		out->texture = GlobalPlatformServices->loadTexture( root["texture"].getString() );
-		if( !out->texture ) {
+		auto texture = GlobalPlatformServices->loadTexture( root["texture"].getString() );
+		if( !texture ) {
 			return false;
 		}
-		auto textureInfo = getTextureInfo( out->texture );
-		auto itw         = 1.0f / textureInfo->width;
-		auto ith         = 1.0f / textureInfo->height;
-
-		auto mapping      = root["mapping"].getArray();
-		int32 framesCount = 0;
-		FOR( animationVal : mapping ) {
-			auto animation = animationVal.getObject();
-			framesCount += animation["frames"].getArray().size();
-		}
-
-		out->frames     = makeArray( primary, VoxelCollection::Frame, framesCount );
-		out->frameInfos = makeArray( primary, VoxelCollection::FrameInfo, framesCount );
-		out->animations = makeArray( primary, VoxelCollection::Animation, mapping.size() );
-
-		int32 currentFrame = 0;
-		for( int32 i = 0, count = mapping.size(); i < count; ++i ) {
-			auto animation  = mapping[i].getObject();
-			auto dest       = &out->animations[i];
-			dest->name      = makeString( primary, animation["name"].getString() );
-			dest->range.min = safe_truncate< uint16 >( currentFrame );
-
-			FOR( frameVal : animation["frames"].getArray() ) {
-				auto frame     = frameVal.getObject();
-				auto destFrame = &out->frames[currentFrame];
-				auto destInfo  = &out->frameInfos[currentFrame];
-				++currentFrame;
-
-				*destFrame                    = {};
-				*destInfo                     = {};
-				destInfo->frictionCoefficient = 1;
-
-				for( auto face = 0; face < VF_Count; ++face ) {
-					auto faceObject = frame[VoxelFaceStrings[face]].getObject();
-
-					destInfo->textureMap.texture = out->texture;
-					deserialize( faceObject["rect"], destInfo->textureRegion[face] );
-					deserialize( faceObject["texCoords"],
-					           destInfo->textureMap.entries[face].texCoords );
-					destInfo->frictionCoefficient = faceObject["frictionCoefficient"].getFloat( 1 );
-					FOR( vert : destInfo->textureMap.entries[face].texCoords.elements ) {
-						vert.x *= itw;
-						vert.y *= ith;
-					}
-				}
-				deserialize( frame["offset"], destFrame->offset );
-			}
-
-			dest->range.max = safe_truncate< uint16 >( currentFrame );
-		}
-		out->voxelsFilename = makeString( primary, root["voxels"].getString() );
+		auto textureInfo = getTextureInfo( texture );
+		parseVoxelCollection( primary, root, texture, textureInfo->dim, out );
 	}
 	out->filename = makeString( primary, filename );
 	guard.commit();
@@ -162,6 +175,67 @@ aabb getBoundsFromVoxelGrid( const VoxelGrid* grid )
 	        right * CELL_WIDTH, top * CELL_HEIGHT,    far * CELL_DEPTH};
 }
 
+// meshes the frames of collection from grids on all workers and computes the bounds of the frame
+// infos in the same pass
+// every worker meshes into a stream in its own scratch memory and only the copy of the finished
+// mesh into output is synchronized, output must not be the scratch allocator of any thread and
+// keeps the meshes until the caller uploads them
+// returns false if not every frame could be meshed
+bool generateVoxelCollectionMeshes( JobSystem* jobs, StackAllocator* output,
+                                    VoxelCollection* collection, Array< VoxelGrid > grids,
+                                    Array< Mesh > meshes )
+{
+	PROFILE_FUNCTION();
+	assert( collection->frameInfos.size() == grids.size() );
+	assert( meshes.size() == grids.size() );
+
+	std::mutex outputMutex;
+	std::atomic< bool > success( true );
+	parallel_for( jobs, grids, 1, [&]( Array< VoxelGrid > range ) {
+		auto scratch = getThreadScratch();
+		FOR( grid : range ) {
+			auto index   = (int32)( &grid - grids.begin() );
+			auto info    = &collection->frameInfos[index];
+			auto dest    = &meshes[index];
+			*dest        = {};
+			info->bounds = getBoundsFromVoxelGrid( &grid );
+			if( !scratch ) {
+				success.store( false, std::memory_order_relaxed );
+				continue;
+			}
+			TEMPORARY_MEMORY_BLOCK( scratch ) {
+				// every face of a voxel becomes at most one quad, merging only reduces the count
+				int32 voxels = 0;
+				for( auto i = 0, count = grid.size(); i < count; ++i ) {
+					voxels += ( grid.data[i] != EmptyCell );
+				}
+				auto quads  = max( voxels, 1 ) * 6;
+				auto stream = makeMeshStream( scratch, quads * 4, quads * 6, nullptr );
+				if( !stream.data.vertices || !stream.data.indices ) {
+					success.store( false, std::memory_order_relaxed );
+					continue;
+				}
+				generateMeshFromVoxelGrid( &stream, &grid, &info->textureMap, VoxelCellSize );
+				auto mesh = toMesh( &stream );
+				{
+					std::lock_guard< std::mutex > lock( outputMutex );
+					dest->vertices = allocateArray( output, Vertex, mesh.verticesCount );
+					dest->indices  = allocateArray( output, uint16, mesh.indicesCount );
+				}
+				if( !dest->vertices || !dest->indices ) {
+					success.store( false, std::memory_order_relaxed );
+					continue;
+				}
+				dest->verticesCount = mesh.verticesCount;
+				dest->indicesCount  = mesh.indicesCount;
+				copy( dest->vertices, mesh.vertices, mesh.verticesCount );
+				copy( dest->indices, mesh.indices, mesh.indicesCount );
+			}
+		}
+	} );
+	return success.load( std::memory_order_relaxed );
+}
+
 void copyVoxelCollection( StackAllocator* allocator, const VoxelCollection& other,
                           VoxelCollection* out )
 {
@@ -246,24 +320,23 @@ bool loadVoxelCollection( StackAllocator* allocator, StringView filename, VoxelC
 		++entry->referenceCount;
 		LOG( INFORMATION, "{}: Loaded cached voxel meshes", filename );
 	} else {
-		TEMPORARY_MEMORY_BLOCK( GlobalScrap ) {
-			auto grids = makeArray( GlobalScrap, VoxelGrid, out->frames.size() );
+		SCRATCH_MEMORY_BLOCK( scratch ) {
+			auto grids = makeArray( scratch, VoxelGrid, out->frames.size() );
 			if( !loadVoxelGridsFromFile( out->voxelsFilename, grids ) ) {
 				return false;
 			}
-			for( auto i = 0; i < grids.size(); ++i ) {
-				auto grid  = &grids[i];
-				auto frame = &out->frames[i];
-				auto info  = &out->frameInfos[i];
-				TEMPORARY_MEMORY_BLOCK( GlobalScrap ) {
-					int32 vertices = (int32)getCapacityFor< Vertex >( GlobalScrap ) / 2;
-					int32 indices  = ( vertices * sizeof( Vertex ) ) / sizeof( uint16 );
-					auto stream    = makeMeshStream( GlobalScrap, vertices, indices, nullptr );
-					generateMeshFromVoxelGrid( &stream, grid, &info->textureMap, VoxelCellSize );
-					frame->mesh = GlobalPlatformServices->uploadMesh( toMesh( &stream ) );
-					assert( frame->mesh );
-					info->bounds = getBoundsFromVoxelGrid( grid );
-				}
+			auto meshes = makeArray( scratch, Mesh, grids.size() );
+			// the primary part keeps the meshes until they are uploaded, the rest is the scratch
+			// memory of this thread while meshing
+			auto partition = StackAllocatorPartition::ratio( scratch, 1 );
+			if( !generateVoxelCollectionMeshes( GlobalPlatformServices->jobs, partition.primary(),
+			                                    out, grids, meshes ) ) {
+				return false;
+			}
+			// uploading isn't thread safe
+			for( auto i = 0; i < meshes.size(); ++i ) {
+				out->frames[i].mesh = GlobalPlatformServices->uploadMesh( meshes[i] );
+				assert( out->frames[i].mesh );
 			}
 		}
 		cacheVoxelCollectionMeshes( *out );
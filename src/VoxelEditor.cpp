@@ -325,11 +325,9 @@ aabb calculateSelectionWorld( VoxelState* voxel )
 static bool processSelectMode( AppData* app, GameInputs* inputs, bool focus, mat4arg invViewProj,
                                float dt )
 {
-	bool processed    = false;
-	auto voxel        = &app->voxelState;
-	auto camera       = &voxel->camera;
-	auto cameraCenter = center( camera );
-	auto grid         = &voxel->voxels;
+	bool processed = false;
+	auto voxel     = &app->voxelState;
+	auto grid      = &voxel->voxels;
 
 	auto ray = pointToWorldSpaceRay( invViewProj, inputs->mouse.position, app->width, app->height );
 
@@ -847,16 +845,14 @@ static void doVoxelGui( AppData* app, GameInputs* inputs, bool focus, float dt )
 		imguiSameLine( 8 );
 		imguiText( faceLabel, 35, 16 );
 
-		auto innerHandle = imguiMakeHandle( &voxel->placingCell, ImGuiControlType::Button );
-		innerHandle.shortIndex = safe_truncate< uint8 >( valueof( face ) );
-		auto cell              = voxel->placingCell;
-		bool inner             = isVoxelFaceInner( cell, face );
-		bool front             = getVoxelFaceTexture( cell, face ) == VF_Front;
-		bool left              = getVoxelFaceTexture( cell, face ) == VF_Left;
-		bool back              = getVoxelFaceTexture( cell, face ) == VF_Back;
-		bool right             = getVoxelFaceTexture( cell, face ) == VF_Right;
-		bool top               = getVoxelFaceTexture( cell, face ) == VF_Top;
-		bool bottom            = getVoxelFaceTexture( cell, face ) == VF_Bottom;
+		auto cell   = voxel->placingCell;
+		bool inner  = isVoxelFaceInner( cell, face );
+		bool front  = getVoxelFaceTexture( cell, face ) == VF_Front;
+		bool left   = getVoxelFaceTexture( cell, face ) == VF_Left;
+		bool back   = getVoxelFaceTexture( cell, face ) == VF_Back;
+		bool right  = getVoxelFaceTexture( cell, face ) == VF_Right;
+		bool top    = getVoxelFaceTexture( cell, face ) == VF_Top;
+		bool bottom = getVoxelFaceTexture( cell, face ) == VF_Bottom;
 		imguiPushButton( "inner", &inner, 16, 16 );
 		int32 index = -1;
 		if( imguiPushButton( "front", &front, 16, 16 ) && front ) {
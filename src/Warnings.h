@@ -5,6 +5,8 @@
 
 // MSVC warnings
 
+#if defined( _MSC_VER )
+
 // warning C4100: 'x': unreferenced formal parameter
 #pragma warning( disable: 4100 )
 
@@ -17,6 +19,8 @@
 // warning C4458: declaration of 'x' hides class member
 #pragma warning( disable: 4458 )
 
+#endif // defined( _MSC_VER )
+
 ///////////////////////////////////
 // clang warnings
 
@@ -36,4 +40,18 @@
 
 #endif // defined( __clang__ )
 
+///////////////////////////////////
+// gcc warnings
+
+#if defined( __GNUC__ ) && !defined( __clang__ )
+
+// warning: enumeration value 'x' not handled in switch [-Wswitch]
+// switches leave out none and count values on purpose, msvc doesn't warn about them at /W4
+#pragma GCC diagnostic ignored "-Wswitch"
+
+// warning: 'stbi__sse2_available' defined but not used [-Wunused-function]
+#pragma GCC diagnostic ignored "-Wunused-function"
+
+#endif // defined( __GNUC__ ) && !defined( __clang__ )
+
 #endif // _WARNINGS_H_INCLUDED_
@@ -69,6 +69,11 @@
 
 #include "Core/IntrusiveLinkedList.h"
 #include "Profiling.cpp"
+#include "ProfilingStatistics.cpp"
+#include "JobSystem.cpp"
+#ifdef GAME_MEMORY_TRACKING
+	#include "MemoryTracking.cpp"
+#endif
 
 #include "QuadTexCoords.cpp"
 #include "Quad.cpp"
@@ -113,6 +118,7 @@ global_var string_logger* GlobalDebugLogger   = nullptr;
 
 #include "JsonWriter.cpp"
 #include "tm_json_wrapper.cpp"
+#include "ProfilingTrace.cpp"
 
 #include "Core/Hash.cpp"
 #include "Core/FixedSizeAllocator.cpp"
@@ -143,7 +149,11 @@ global_var ProfilingTable* GlobalProfilingTable                     = nullptr;
 
 // TODO: GlobalScrapSize can be 1 megabyte once VoxelGrids are dense
 constexpr const size_t GlobalScrapSize = megabytes( 3 );
+// scrap is growable if the platform supports it, only the used part of the reservation is committed
+constexpr const size_t GlobalScrapReserveSize = megabytes( 64 );
 global_var StackAllocator* GlobalScrap = nullptr;
+constexpr const size_t ThreadScratchReserveSize = megabytes( 64 );
+#include "ThreadScratch.cpp"
 
 global_var MeshStream* debug_MeshStream = nullptr;
 global_var bool debug_FillMeshStream    = true;
@@ -194,6 +204,8 @@ GameSettings makeDefaultGameSettings()
 #include "VoxelGrid.cpp"
 #include "VoxelCollection.cpp"
 #include "Room.cpp"
+constexpr const size_t AssetRequestReserveSize = megabytes( 32 );
+#include "AssetLoader.cpp"
 
 #include "Editor/Common/DynamicVoxelCollection.h"
 #include "Editor/Common/EditorView.h"
@@ -365,39 +377,39 @@ struct HitboxSystem {
 };
 
 template < class GenericSystem >
-void removeEntities( GenericSystem* system, Array< EntityHandle > handles )
+void removeEntities( GenericSystem* system, EntityHandleSet handles )
 {
 	unordered_remove_if( system->entries, [handles]( const auto& component ) {
-		return exists( handles, component.entity );
+		return handles.contains( component.entity );
 	} );
 }
-void removeEntities( EntitySystem* system, Array< EntityHandle > handles )
+void removeEntities( EntitySystem* system, EntityHandleSet handles )
 {
 	erase_if( system->entries, [system, handles]( const Entity& component ) {
-		if( exists( handles, component.handle ) ) {
+		if( handles.contains( component.handle ) ) {
 			if( !component.dynamic() ) {
 				--system->entriesCount;
 			}
+			system->indices[component.handle.index()] = -1;
+			freeEntityDetails( system, component.details );
 			return true;
 		}
 		return false;
 	} );
+	updateEntityIndices( system );
 }
-void removeEntities( HitboxSystem* system, Array< EntityHandle > handles )
+void removeEntities( HitboxSystem* system, EntityHandleSet handles )
 {
 	auto pairs = system->hitboxPairs();
 	erase_if( pairs, [handles]( const auto& pair ) {
-		return exists_if( handles, [pair]( const auto& handle ) {
-			return handle == pair.attacker || handle == pair.defender;
-		} );
+		return handles.contains( pair.attacker ) || handles.contains( pair.defender );
 	} );
 	system->setPairsCount( pairs.size() );
 }
-void removeEntities( EntitySystem* entitySystem, SkeletonSystem* system,
-                     Array< EntityHandle > handles )
+void removeEntities( EntitySystem* entitySystem, SkeletonSystem* system, EntityHandleSet handles )
 {
 	FOR( entity : entitySystem->entries ) {
-		if( entity.skeleton && exists( handles, entity.handle ) ) {
+		if( entity.skeleton && handles.contains( entity.handle ) ) {
 			deleteSkeleton( system, entity.skeleton );
 			entity.skeleton = nullptr;
 		}
@@ -446,11 +458,19 @@ void processEntityRemovalQueue( GameState* game )
 {
 	assert( game );
 	if( game->entityRemovalQueue.size() ) {
-		auto handles = makeArrayView( game->entityRemovalQueue );
-		removeEntities( &game->entitySystem, &game->skeletonSystem, handles );
-		removeEntities( &game->controlSystem, handles );
-		removeEntities( &game->entitySystem, handles );
-		removeEntities( &game->hitboxSystem, handles );
+		SCRATCH_MEMORY_BLOCK( scratch ) {
+			auto queue   = makeArrayView( game->entityRemovalQueue );
+			auto handles = makeEntityHandleSet( scratch, &game->entityHandles, queue );
+			removeEntities( &game->entitySystem, &game->skeletonSystem, handles );
+			removeEntities( &game->controlSystem, handles );
+			removeEntities( &game->entitySystem, handles );
+			removeEntities( &game->hitboxSystem, handles );
+			FOR( handle : queue ) {
+				if( isValid( &game->entityHandles, handle ) ) {
+					removeEntityHandle( &game->entityHandles, handle );
+				}
+			}
+		}
 		game->entityRemovalQueue.clear();
 	}
 }
@@ -463,6 +483,10 @@ void clearEntities( GameState* game )
 	}
 	game->entitySystem.entries.clear();
 	game->entitySystem.entriesCount = 0;
+	FOR( index : game->entitySystem.indices ) {
+		index = -1;
+	}
+	clearEntityDetails( &game->entitySystem );
 
 	game->controlSystem.entries.clear();
 
@@ -474,6 +498,10 @@ void clearEntities( GameState* game )
 	game->skeletonSystem.skeletons.clear();
 
 	game->projectileSystem.entries.clear();
+
+	// nothing references handles anymore
+	clearEntityHandles( &game->entityHandles );
+	game->entityRemovalQueue.clear();
 }
 void restartGame( GameState* game )
 {
@@ -517,7 +545,7 @@ void processControlSystem( GameState* game, ControlSystem* controlSystem,
 
 	for( auto& control : controlSystem->entries ) {
 		if( auto entity = findEntity( entitySystem, control.entity ) ) {
-			auto entityControl = &entity->control;
+			auto entityControl = &entity->control();
 			// TODO: do keymapping to actions
 			// TODO: input buffering
 
@@ -590,6 +618,12 @@ struct AppData {
 	string_builder debugPrinter;
 	string_logger debugLogger;
 	ProfilingTable profilingTable;
+	ProfilingStatistics profilingStatistics;
+	ScratchTable scratchTable;
+	AssetLoader assetLoader;
+#ifdef GAME_MEMORY_TRACKING
+	MemoryTrackingTable memoryTrackingTable;
+#endif
 	DebugValues debugValues;
 
 	mat4 perspective;
@@ -598,7 +632,9 @@ struct AppData {
 	StackAllocator stackAllocator;
 	StackAllocator scrapAllocator;
 	MatrixStack matrixStack;
-	RenderCommands renderer;
+	RenderCommands renderer;  // commands of the current frame, recorded into renderFrames
+	RenderCommands renderFrames[RENDER_COMMANDS_BUFFERS_COUNT];
+	int32 renderFrame;  // index into renderFrames of the current frame
 	GameSettings settings;
 	Font font;
 	bool resourcesLoaded;
@@ -619,6 +655,7 @@ struct AppData {
 
 	bool mouseLocked;
 	bool displayDebug;
+	bool displayMemoryTracking;
 };
 
 void fillVoxelGridFromImage( VoxelGrid* grid, ImageData image )
@@ -695,6 +732,12 @@ INITIALIZE_APP( initializeApp )
 	p += sizeof( AppData );
 	size -= sizeof( AppData );
 
+#ifdef GAME_MEMORY_TRACKING
+	// track allocations from the start, allocators are registered in reloadApp
+	clearMemoryTrackingTable( &app->memoryTrackingTable );
+	GlobalMemoryTrackingTable = &app->memoryTrackingTable;
+#endif
+
 	app->platform     = platformServices;
 	app->platformInfo = platformInfo;
 	app->guiState     = defaultImmediateModeGui();
@@ -703,7 +746,10 @@ INITIALIZE_APP( initializeApp )
 	auto allocator              = &app->stackAllocator;
 	auto renderCommandsCapacity = megabytes( 2 );
 	app->matrixStack            = makeMatrixStack( allocator, 16 );
-	app->renderer = makeRenderCommands( allocator, renderCommandsCapacity, &app->matrixStack );
+	for( auto& frame : app->renderFrames ) {
+		frame = makeRenderCommands( allocator, renderCommandsCapacity, &app->matrixStack );
+	}
+	app->renderer = app->renderFrames[0];
 	app->settings = makeDefaultGameSettings();
 	app->width    = 1600;
 	app->height   = 900;
@@ -712,8 +758,19 @@ INITIALIZE_APP( initializeApp )
 	app->textureMap      = {makeUArray( allocator, TextureMapEntry, 100 )};
 	app->debugPrinter    = string_builder( allocateArray( allocator, char, 2048 ), 2048 );
 	app->debugLogger     = string_logger( allocateArray( allocator, char, 2048 ), 2048, 200 );
-	app->scrapAllocator  = makeStackAllocator( &app->stackAllocator, GlobalScrapSize );
-	auto result          = reloadApp( memory, size );
+	if( app->platform.virtualMemory.reserve ) {
+		app->scrapAllocator =
+		    makeGrowableStackAllocator( &app->platform.virtualMemory, GlobalScrapReserveSize );
+	}
+	if( !app->scrapAllocator.ptr ) {
+		app->scrapAllocator = makeStackAllocator( allocator, GlobalScrapSize );
+	}
+	initScratchTable( &app->scratchTable, &app->platform.virtualMemory, ThreadScratchReserveSize );
+	initAssetLoader( &app->assetLoader, &app->platform, AssetRequestReserveSize );
+#ifndef NO_PROFILING
+	initProfilingStatistics( &app->profilingStatistics, allocator, kilobytes( 512 ), 120 );
+#endif
+	auto result = reloadApp( memory, size );
 
 	auto aspect      = app->width / app->height;
 	app->perspective = matrixPerspectiveFovProjection( degreesToRadians( 65 ), aspect, -1, 1 );
@@ -729,7 +786,9 @@ INITIALIZE_APP( initializeApp )
 
 	voxel->meshStream = makeMeshStream( allocator, 4000, 12000, nullptr );
 
-	result.success = result.success && isValid( &app->renderer );
+	FOR( frame : app->renderFrames ) {
+		result.success = result.success && isValid( &frame );
+	}
 	return result;
 }
 
@@ -753,14 +812,34 @@ RELOAD_APP( reloadApp )
 	GlobalDebugPrinter             = &app->debugPrinter;
 	GlobalDebugLogger              = &app->debugLogger;
 	GlobalProfilingTable           = &app->profilingTable;
+	GlobalScratchTable             = &app->scratchTable;
 	debug_Values                   = &app->debugValues;
-	app->profilingTable.infosCount = 0;
+	clearProfilingTable( &app->profilingTable );
+	clearScratchTable( &app->scratchTable );
+	bindThreadScratch( &app->scratchTable, &app->scrapAllocator );
+#ifdef GAME_MEMORY_TRACKING
+	// globals of a reloaded dll start out as nullptr, the call sites of the previous dll are
+	// dangling then
+	if( GlobalMemoryTrackingTable != &app->memoryTrackingTable ) {
+		clearMemoryTrackingTable( &app->memoryTrackingTable );
+		GlobalMemoryTrackingTable = &app->memoryTrackingTable;
+	}
+	trackStackAllocator( GlobalMemoryTrackingTable, "stack", &app->stackAllocator );
+	trackStackAllocator( GlobalMemoryTrackingTable, "scrap", &app->scrapAllocator );
+	trackStackAllocator( GlobalMemoryTrackingTable, "render commands", &app->renderer.allocator );
+	#ifndef NO_PROFILING
+		trackStackAllocator( GlobalMemoryTrackingTable, "profiling statistics",
+		                     &app->profilingStatistics.allocator );
+	#endif
+	result.memoryTrackingTable = GlobalMemoryTrackingTable;
+#endif
 
-	result.success     = true;
-	result.logStorage  = GlobalIngameLog;
-	result.debugLogger = GlobalDebugLogger;
-	result.textureMap  = GlobalTextureMap;
-	ImGui              = &app->guiState;
+	result.success        = true;
+	result.logStorage     = GlobalIngameLog;
+	result.debugLogger    = GlobalDebugLogger;
+	result.textureMap     = GlobalTextureMap;
+	result.profilingTable = GlobalProfilingTable;
+	ImGui                 = &app->guiState;
 	return result;
 }
 
@@ -965,6 +1044,15 @@ static void showGameDebugGui( AppData* app, GameInputs* inputs, bool focus, floa
 			char buffer[1000];
 			imguiText( detailedDebugOutput( app, buffer, countof( buffer ) ) );
 		}
+#ifdef GAME_MEMORY_TRACKING
+		imguiCheckbox( "Memory Tracking", &app->displayMemoryTracking );
+		if( app->displayMemoryTracking ) {
+			char buffer[4096];
+			string_builder builder( buffer, countof( buffer ) );
+			writeMemoryTrackingReport( &builder, &app->memoryTrackingTable, 10 );
+			imguiText( asStringView( builder ) );
+		}
+#endif
 
 		// display held down keys
 		SmallUninitializedArray< VirtualKeyEnumValues, 10 > keys;
@@ -1038,10 +1126,10 @@ static void processGameCamera( AppData* app, float dt )
 	}
 }
 
-void setHeroActionAnimation( SkeletonSystem* system, Entity* entity, float dt )
+void setHeroActionAnimation( const HeroSkeletonDefinition* definition, Entity* entity, float dt )
 {
-	auto hero       = &get_variant( *entity, hero );
-	const auto& ids = system->hero.animationIds;
+	auto hero       = &entity->hero();
+	const auto& ids = definition->animationIds;
 
 	auto skeleton  = entity->skeleton;
 	auto animation = hero->currentAnimationIndex;
@@ -1061,7 +1149,7 @@ void setHeroActionAnimation( SkeletonSystem* system, Entity* entity, float dt )
 				animation = ids.landing;
 				repeating = false;
 			} else {
-				if( !shooting && entity->faceDirection != entity->prevFaceDirection ) {
+				if( !shooting && entity->faceDirection != entity->prevFaceDirection() ) {
 					auto lock = skeleton->definition->animations[ids.turn].duration;
 					hero->animationLockTimer = {lock};
 					animation                = ids.turn;
@@ -1087,7 +1175,7 @@ void setHeroActionAnimation( SkeletonSystem* system, Entity* entity, float dt )
 			hero->currentAnimation = playAnimation( skeleton, animation, repeating );
 		}
 		hero->currentAnimationIndex = animation;
-		entity->prevFaceDirection   = entity->faceDirection;
+		entity->prevFaceDirection() = entity->faceDirection;
 	}
 }
 
@@ -1109,11 +1197,12 @@ void emitEntityParticles( GameState* game, float dt )
 				const recti MapBounds = {0, 0, grid.width, grid.height};
 				auto region =
 				    getSweptTileGridRegion( entry.aab, entry.position, searchDir, MapBounds );
-				auto collisionAtFeet =
-				    findCollision( {-1, -1, 1, 1}, feetPosition, searchDir, grid, region,
-				                   game->entitySystem.dynamicEntries(), 1, false );
+				auto occupancy       = getCollisionOccupancy( &game->room );
+				auto dynamics        = game->entitySystem.dynamicEntries();
+				auto collisionAtFeet = findCollision( {-1, -1, 1, 1}, feetPosition, searchDir, grid,
+				                                      occupancy, region, dynamics, 1, false );
 				if( collisionAtFeet ) {
-					auto hero               = &entry.hero;
+					auto hero               = &entry.hero();
 					hero->particleEmitTimer = processTimer( hero->particleEmitTimer, dt );
 					if( !hero->particleEmitTimer ) {
 						hero->particleEmitTimer = {6};
@@ -1122,8 +1211,8 @@ void emitEntityParticles( GameState* game, float dt )
 					}
 				}
 			} else {
-				if( auto hero = query_variant( entry, hero ) ) {
-					hero->particleEmitTimer = {};
+				if( entry.type == Entity::type_hero ) {
+					entry.hero().particleEmitTimer = {};
 				}
 			}
 
@@ -1131,36 +1220,35 @@ void emitEntityParticles( GameState* game, float dt )
 			if( entry.spatialState == SpatialState::Grounded
 			    && floatEqZero( entry.spatialStateTimer ) ) {
 
-				auto feetPosition = entry.position;
-				auto emitted      = emitParticles( &game->particleSystem, feetPosition,
-				                              ParticleEmitterId::LandingDust );
+				emitParticles( &game->particleSystem, entry.position,
+				               ParticleEmitterId::LandingDust );
 			}
 		}
 	}
 }
 
-typedef void BehaviorFunctionType( GameState*, Entity*, float );
-void processHeroEntity( GameState* game, Entity* entity, float dt )
+void processHeroEntity( GameState* game, const HeroSkeletonDefinition* definition, Entity* entity,
+                        float dt )
 {
 	using namespace GameConstants;
 
 	// process controls
-	auto hero       = &get_variant( *entity, hero );
-	const auto& ids = game->skeletonSystem.hero.animationIds;
+	auto hero       = &entity->hero();
+	const auto& ids = definition->animationIds;
 
 	if( entity->flags.hurt ) {
-		entity->control.responsiveness = EntityResponsiveness::NoControl;
-		auto animation                 = ids.hurt;
+		entity->control().responsiveness = EntityResponsiveness::NoControl;
+		auto animation                   = ids.hurt;
 		stopAnimations( entity->skeleton );
 		hero->currentAnimation      = playAnimation( entity->skeleton, animation, false );
 		hero->currentAnimationIndex = animation;
 	}
 	if( hero->currentAnimationIndex != ids.hurt
 	    || isAnimationFinished( entity->skeleton, hero->currentAnimation ) ) {
-		entity->control.responsiveness = EntityResponsiveness::Responsive;
+		entity->control().responsiveness = EntityResponsiveness::Responsive;
 	}
 
-	auto control    = entity->control;
+	auto control    = entity->control();
 
 	entity->velocity.x = 0;
 	if( control.responsiveness == EntityResponsiveness::Responsive ) {
@@ -1196,7 +1284,7 @@ void processHeroEntity( GameState* game, Entity* entity, float dt )
 			entity->velocity.y = JumpingSpeed;
 			setSpatialState( entity, SpatialState::Airborne );
 
-			entity->control.verticalAction = EntityVerticalAction::ConsumeInput;
+			entity->control().verticalAction = EntityVerticalAction::ConsumeInput;
 		}
 
 		// variable jump height
@@ -1213,10 +1301,10 @@ void processHeroEntity( GameState* game, Entity* entity, float dt )
 		    && isSpatialStateWalljumpable( entity ) && entity->walljumpWindow ) {
 
 			entity->wallslideCollidable.clear();
-			entity->walljumpWindow         = {};
-			entity->velocity.y             = WalljumpingSpeed;
-			entity->walljumpDuration       = {WalljumpMaxDuration};
-			entity->control.verticalAction = EntityVerticalAction::ConsumeInput;
+			entity->walljumpWindow           = {};
+			entity->velocity.y               = WalljumpingSpeed;
+			entity->walljumpDuration         = {WalljumpMaxDuration};
+			entity->control().verticalAction = EntityVerticalAction::ConsumeInput;
 		}
 
 		// shooting
@@ -1225,7 +1313,7 @@ void processHeroEntity( GameState* game, Entity* entity, float dt )
 		}
 
 		// update skeleton
-		setHeroActionAnimation( &game->skeletonSystem, entity, dt );
+		setHeroActionAnimation( definition, entity, dt );
 
 		// emit projectile after skeleton update, since we need correct node positions
 		if( control.action == EntityActionState::Attack ) {
@@ -1233,7 +1321,7 @@ void processHeroEntity( GameState* game, Entity* entity, float dt )
 				setMirrored( entity->skeleton, entity->faceDirection == EntityFaceDirection::Left );
 				update( entity->skeleton, nullptr, 0 );
 			}
-			auto shootPosIndex = game->skeletonSystem.hero.nodeIds.shootPos;
+			auto shootPosIndex = definition->nodeIds.shootPos;
 			auto gunPosition   = getNode( entity->skeleton, shootPosIndex ).xy;
 			gunPosition.y      = -gunPosition.y;
 			vec2 direction     = {1, 0};
@@ -1251,9 +1339,11 @@ void processHeroEntity( GameState* game, Entity* entity, float dt )
 		}
 	}
 }
-void processWheelsEntity( GameState* game, Entity* entity, float dt )
+void processWheelsEntity( GameState* game, const WheelsSkeletonDefinition* definition,
+                          Entity* entity, float dt )
 {
-	auto wheels      = &entity->wheels;
+	auto wheels      = &entity->wheels();
+	const auto& ids  = definition->animationIds;
 	bool stateChange = false;
 
 	if( entity->flags.hurt ) {
@@ -1267,34 +1357,33 @@ void processWheelsEntity( GameState* game, Entity* entity, float dt )
 	auto doHurt = [&]() {
 		if( entity->flags.hurt ) {
 			stopAnimations( entity->skeleton );
-			wheels->currentAnimation = playAnimation(
-			    entity->skeleton, game->skeletonSystem.wheels.animationIds.hurt, false );
+			wheels->currentAnimation = playAnimation( entity->skeleton, ids.hurt, false );
 			entity->acceleration.x = 0;
-			entity->velocity.x     = -entity->hurtNormal.x * 0.1f;
-			if( entity->hurtNormal.x < 0 ) {
+			entity->velocity.x     = -entity->hurtNormal().x * 0.1f;
+			if( entity->hurtNormal().x < 0 ) {
 				entity->faceDirection = EntityFaceDirection::Left;
 			} else {
 				entity->faceDirection = EntityFaceDirection::Right;
 			}
-			entity->wheels.state = Entity::Wheels::Hurt;
-			stateChange          = true;
+			wheels->state = Entity::Wheels::Hurt;
+			stateChange   = true;
 		}
 	};
 	auto doAttack = [&]() {
 		wheels->attackTimer = processTimer( wheels->attackTimer, dt );
 		if( isCountdownTimerExpired( wheels->attackTimer ) ) {
-			wheels->attackTimer  = {120};
-			entity->wheels.state = Entity::Wheels::Attacking;
-			stateChange          = true;
+			wheels->attackTimer = {120};
+			wheels->state       = Entity::Wheels::Attacking;
+			stateChange         = true;
 		}
 	};
 	do {
 		bool stateJustChanged = stateChange;
 		stateChange           = false;
-		switch( entity->wheels.state ) {
+		switch( wheels->state ) {
 			case Entity::Wheels::Idle: {
 				entity->maxSpeed      = {1, 0};
-				entity->wheels.state  = Entity::Wheels::Moving;
+				wheels->state         = Entity::Wheels::Moving;
 				entity->faceDirection = EntityFaceDirection::Right;
 				stateChange           = true;
 				break;
@@ -1302,8 +1391,7 @@ void processWheelsEntity( GameState* game, Entity* entity, float dt )
 			case Entity::Wheels::Moving: {
 				if( stateJustChanged ) {
 					stopAnimations( entity->skeleton );
-					wheels->currentAnimation = playAnimation(
-					    entity->skeleton, game->skeletonSystem.wheels.animationIds.move, true );
+					wheels->currentAnimation = playAnimation( entity->skeleton, ids.move, true );
 				}
 				if( floatEqZero( entity->acceleration.x ) ) {
 					entity->acceleration.x =
@@ -1311,8 +1399,8 @@ void processWheelsEntity( GameState* game, Entity* entity, float dt )
 				}
 				if( entity->lastCollision && entity->lastCollision != entity->grounded ) {
 
-					entity->wheels.state = Entity::Wheels::Turning;
-					stateChange          = true;
+					wheels->state = Entity::Wheels::Turning;
+					stateChange   = true;
 				}
 				doAttack();
 				doHurt();
@@ -1324,8 +1412,7 @@ void processWheelsEntity( GameState* game, Entity* entity, float dt )
 					entity->acceleration.x = 0;
 					entity->velocity.x     = 0;
 					stopAnimations( entity->skeleton );
-					wheels->currentAnimation = playAnimation(
-					    entity->skeleton, game->skeletonSystem.wheels.animationIds.turn );
+					wheels->currentAnimation = playAnimation( entity->skeleton, ids.turn );
 				}
 				if( ( !stateJustChanged
 				      && isAnimationFinished( entity->skeleton, wheels->currentAnimation ) )
@@ -1335,12 +1422,12 @@ void processWheelsEntity( GameState* game, Entity* entity, float dt )
 					} else {
 						entity->faceDirection = EntityFaceDirection::Right;
 					}
-					entity->wheels.state = Entity::Wheels::Moving;
-					stateChange          = true;
+					wheels->state = Entity::Wheels::Moving;
+					stateChange   = true;
 				}
 				if( !entity->grounded ) {
-					entity->wheels.state = Entity::Wheels::Moving;
-					stateChange          = true;
+					wheels->state = Entity::Wheels::Moving;
+					stateChange   = true;
 				}
 				doHurt();
 				break;
@@ -1349,13 +1436,12 @@ void processWheelsEntity( GameState* game, Entity* entity, float dt )
 				if( stateJustChanged ) {
 					entity->acceleration.x = -sign( entity->velocity.x ) * 0.02f;
 					stopAnimations( entity->skeleton );
-					wheels->currentAnimation = playAnimation(
-					    entity->skeleton, game->skeletonSystem.wheels.animationIds.attack );
+					wheels->currentAnimation = playAnimation( entity->skeleton, ids.attack );
 				} else if( isAnimationFinished( entity->skeleton, wheels->currentAnimation ) ) {
 					if( wheels->shouldTurn ) {
-						entity->wheels.state = Entity::Wheels::Turning;
+						wheels->state = Entity::Wheels::Turning;
 					} else {
-						entity->wheels.state = Entity::Wheels::Moving;
+						wheels->state = Entity::Wheels::Moving;
 					}
 					stateChange = true;
 				}
@@ -1367,9 +1453,8 @@ void processWheelsEntity( GameState* game, Entity* entity, float dt )
 						velocity.x    = ( entity->faceDirection == EntityFaceDirection::Left )
 						                 ? ( -1.0f )
 						                 : 1.0f;
-						auto origin = getNode( entity->skeleton,
-						                       game->skeletonSystem.wheels.nodeIds.attackOrigin )
-						                  .xy;
+						auto origin =
+						    getNode( entity->skeleton, definition->nodeIds.attackOrigin ).xy;
 						origin.y = -origin.y;
 						emitProjectile( game, origin, velocity, ProjectileType::Wheels,
 						                entity->team );
@@ -1399,8 +1484,8 @@ void processWheelsEntity( GameState* game, Entity* entity, float dt )
 					doHurt();
 				}
 				if( isAnimationFinished( entity->skeleton, wheels->currentAnimation ) ) {
-					entity->wheels.state = Entity::Wheels::Moving;
-					stateChange          = true;
+					wheels->state = Entity::Wheels::Moving;
+					stateChange   = true;
 				}
 				doAttack();
 				break;
@@ -1410,6 +1495,24 @@ void processWheelsEntity( GameState* game, Entity* entity, float dt )
 	} while( stateChange );
 }
 
+// behaviors run over batches of entities of the same type, so that lookups shared by all entities
+// of a type are done once
+typedef void BehaviorFunctionType( GameState*, Array< Entity* >, float );
+void processHeroEntities( GameState* game, Array< Entity* > entities, float dt )
+{
+	auto definition = &game->skeletonSystem.hero;
+	FOR( entity : entities ) {
+		processHeroEntity( game, definition, entity, dt );
+	}
+}
+void processWheelsEntities( GameState* game, Array< Entity* > entities, float dt )
+{
+	auto definition = &game->skeletonSystem.wheels;
+	FOR( entity : entities ) {
+		processWheelsEntity( game, definition, entity, dt );
+	}
+}
+
 void processEntityBehaviors( GameState* game, float dt )
 {
 	assert( game );
@@ -1417,16 +1520,38 @@ void processEntityBehaviors( GameState* game, float dt )
 	emitEntityParticles( game, dt );
 
 	static BehaviorFunctionType* const EntityBehaviors[] = {
-	    processHeroEntity, processWheelsEntity,
+	    processHeroEntities, processWheelsEntities,
 	};
 	static_assert( Entity::type_hero == 1, "Wrong entity type order" );
 	static_assert( Entity::type_wheels == 2, "Wrong entity type order" );
 	static_assert( countof( EntityBehaviors ) == Entity::type_count - 1,
 	               "Not all behaviors defined" );
 
-	FOR( entry : game->entitySystem.staticEntries() ) {
-		assert( entry.type != Entity::type_none );
-		EntityBehaviors[entry.type - 1]( game, &entry, dt );
+	// entities are bucketed by type every frame instead of keeping entries sorted, so that entries
+	// stay in the order they were added in, which hit detection, collision and game->player rely on
+	// every behavior runs once over all entities of its type, in the order they are stored in
+	// entities don't move while behaviors run, removals are queued and dynamics are appended
+	auto entries = game->entitySystem.staticEntries();
+	SCRATCH_MEMORY_BLOCK( scratch ) {
+		int32 offsets[Entity::type_count + 1] = {};
+		FOR( entry : entries ) {
+			assert( entry.type != Entity::type_none );
+			++offsets[entry.type + 1];
+		}
+		for( auto i = 1; i < countof( offsets ); ++i ) {
+			offsets[i] += offsets[i - 1];
+		}
+		auto batches = makeArray( scratch, Entity*, entries.size() );
+		int32 counts[Entity::type_count] = {};
+		FOR( entry : entries ) {
+			batches[offsets[entry.type] + counts[entry.type]++] = &entry;
+		}
+		for( auto type = Entity::type_none + 1; type < Entity::type_count; ++type ) {
+			if( counts[type] ) {
+				auto batch = makeArrayView( batches.begin() + offsets[type], counts[type] );
+				EntityBehaviors[type - 1]( game, batch, dt );
+			}
+		}
 	}
 }
 
@@ -1461,8 +1586,11 @@ static void updateGame( AppData* app, GameInputs* inputs, bool focus, float dt )
 	}
 	if( isKeyPressed( inputs, KC_1 ) ) {
 		auto handle = addEntityHandle( &game->entityHandles );
-		addEntity( &game->entitySystem, &game->skeletonSystem, handle, Entity::type_wheels,
-		           {16 * 6, 16 * 8} );
+		if( handle
+		    && !addEntity( &game->entitySystem, &game->skeletonSystem, handle,
+		                   Entity::type_wheels, {16 * 6, 16 * 8} ) ) {
+			removeEntityHandle( &game->entityHandles, handle );
+		}
 	}
 
 	// mouse lock
@@ -1476,28 +1604,33 @@ static void updateGame( AppData* app, GameInputs* inputs, bool focus, float dt )
 	game->prevCamera = game->camera;
 	processGameCamera( app, dt );
 	processControlSystem( game, &game->controlSystem, &game->entitySystem, inputs, dt );
-	// update aab's
-	FOR( entity : game->entitySystem.entries ) {
-		if( entity.skeleton ) {
-			auto traits = getEntityTraits( entity.type );
-			if( !traits->flags.noFaceDirection ) {
-				setMirrored( entity.skeleton, entity.faceDirection == EntityFaceDirection::Left );
-				update( entity.skeleton, nullptr, 0 );
-			}
+	// update aab's, entities own their skeletons, so they can be updated in parallel
+	auto entries = makeArrayView( game->entitySystem.entries );
+	parallel_for( app->platform.jobs, entries, 16, [game]( Array< Entity > range ) {
+		FOR( entity : range ) {
+			if( entity.skeleton ) {
+				auto traits = getEntityTraits( entity.type );
+				if( !traits->flags.noFaceDirection ) {
+					setMirrored( entity.skeleton,
+					             entity.faceDirection == EntityFaceDirection::Left );
+					update( entity.skeleton, nullptr, 0 );
+				}
 
-			auto skeletonTraits = getSkeletonTraits( &game->skeletonSystem, entity.type );
-			auto collisionIds = skeletonTraits->collisionIds();
-			if( collisionIds.size() ) {
-				entity.aab = getHitboxRelative( entity.skeleton, collisionIds[0] ).first;
+				auto skeletonTraits = getSkeletonTraits( &game->skeletonSystem, entity.type );
+				auto collisionIds = skeletonTraits->collisionIds();
+				if( collisionIds.size() ) {
+					entity.aab = getHitboxRelative( entity.skeleton, collisionIds[0] ).first;
+				}
 			}
 		}
-	}
-	doCollisionDetection( &game->room, &game->entitySystem, dt );
-	processProjectiles( game, getCollisionLayer( &game->room ), game->entitySystem.dynamicEntries(),
+	} );
+	doCollisionDetection( &game->room, &game->entitySystem, app->platform.jobs, dt );
+	processProjectiles( game, getCollisionLayer( &game->room ),
+	                    getCollisionOccupancy( &game->room ), game->entitySystem.dynamicEntries(),
 	                    dt );
 
 	// hit detection
-	{
+	SCRATCH_MEMORY_BLOCK( scratch ) {
 		auto hitboxSystem = &game->hitboxSystem;
 		auto pairs        = hitboxSystem->hitboxPairs();
 
@@ -1511,8 +1644,8 @@ static void updateGame( AppData* app, GameInputs* inputs, bool focus, float dt )
 		auto hurtEntity = []( EntityHandle attacker, Entity* entity,
 		                      UArray< HitboxSystem::HitboxPair >* pairs, vec2 normal ) {
 			if( !entity->flags.deflects && !entity->flags.invincible ) {
-				entity->flags.hurt = true;
-				entity->hurtNormal = normal;
+				entity->flags.hurt   = true;
+				entity->hurtNormal() = normal;
 				pairs->push_back( {attacker, entity->handle} );
 			}
 		};
@@ -1526,20 +1659,21 @@ static void updateGame( AppData* app, GameInputs* inputs, bool focus, float dt )
 					auto otherSkeletonTraits =
 					    getSkeletonTraits( &game->skeletonSystem, entity->type );
 					auto combinedDelta = delta - entity->positionDelta;
+					AabBatch targets;
+					targets.count = 0;
 					FOR( defendBoundsId : otherSkeletonTraits->hitboxIdsByType( type ) ) {
 						auto defendBounds = getHitboxAbsolute( entity->skeleton, defendBoundsId );
-						if( !defendBounds.second ) {
-							continue;
-						}
-						auto otherBounds = translate( defendBounds.first, -entity->positionDelta );
-						result = testAabVsAab( hitbox, position, combinedDelta, otherBounds, 1 );
-						if( result ) {
-							if( hitBounds ) {
-								*hitBounds = otherBounds;
-							}
-							break;
+						if( defendBounds.second ) {
+							targets.push_back(
+							    translate( defendBounds.first, -entity->positionDelta ) );
 						}
 					}
+					auto any   = []( const CollisionInfo& ) { return true; };
+					auto index = findFirstAabCollision( hitbox, position, combinedDelta, &targets,
+					                                    1, &result, any );
+					if( index >= 0 && hitBounds ) {
+						*hitBounds = targets[index];
+					}
 				}
 			}
 			return result;
@@ -1549,32 +1683,109 @@ static void updateGame( AppData* app, GameInputs* inputs, bool focus, float dt )
 		FOR( entity : staticEntries ) {
 			entity.flags.hurt = false;
 		}
+
+		// broadphase, swept bounds of hitboxes and projectiles are paired with the bounds of hurt-
+		// and deflectboxes, which are swept back to where testHit tests them
+		// only overlapping pairs go through testHit, candidates are visited in the same order as
+		// staticEntries, so that results don't change
+		auto projectiles     = game->projectileSystem.entries;
+		const rectf NoBounds = {FLOAT_MAX, FLOAT_MAX, -FLOAT_MAX, -FLOAT_MAX};
+		auto getHitboxBounds = [&]( const Entity& entity ) {
+			auto result = NoBounds;
+			if( entity.skeleton ) {
+				auto skeletonTraits = getSkeletonTraits( &game->skeletonSystem, entity.type );
+				FOR( hitboxId : skeletonTraits->hitboxIds() ) {
+					auto hitbox = getHitboxRelative( entity.skeleton, hitboxId );
+					if( hitbox.second ) {
+						result = RectBounding( result, hitbox.first );
+					}
+				}
+			}
+			if( result.left > result.right ) {
+				return result;
+			}
+			auto prevPosition = entity.position - entity.positionDelta;
+			return sweep( translate( result, prevPosition ), entity.positionDelta );
+		};
+		auto getDefendBounds = [&]( const Entity& entity ) {
+			auto result = NoBounds;
+			if( entity.skeleton ) {
+				auto skeletonTraits = getSkeletonTraits( &game->skeletonSystem, entity.type );
+				auto addHitboxes    = [&]( Array< const int8 > hitboxIds ) {
+					FOR( hitboxId : hitboxIds ) {
+						auto hitbox = getHitboxAbsolute( entity.skeleton, hitboxId );
+						if( hitbox.second ) {
+							result = RectBounding( result, hitbox.first );
+						}
+					}
+				};
+				addHitboxes( skeletonTraits->hurtboxIds() );
+				addHitboxes( skeletonTraits->deflectIds() );
+			}
+			if( result.left > result.right ) {
+				return result;
+			}
+			return sweep( translate( result, -entity.positionDelta ), entity.positionDelta );
+		};
+		auto getProjectileBounds = [&]( const Projectile& entry ) {
+			auto data         = getProjectileData( &game->projectileSystem, entry.type );
+			auto prevPosition = entry.position - entry.positionDelta;
+			return sweep( translate( data->hitbox, prevPosition ), entry.positionDelta );
+		};
+
+		RectOverlaps entityHits     = {staticEntries.size()};
+		RectOverlaps projectileHits = {staticEntries.size()};
+		auto attackBounds           = makeArray( scratch, rectf, staticEntries.size() );
+		auto defendBounds           = makeArray( scratch, rectf, staticEntries.size() );
+		auto projectileBounds       = makeArray( scratch, rectf, projectiles.size() );
+		if( attackBounds.size() == staticEntries.size()
+		    && defendBounds.size() == staticEntries.size()
+		    && projectileBounds.size() == projectiles.size() ) {
+			FOR( entity : staticEntries ) {
+				auto index          = indexof( staticEntries, entity );
+				attackBounds[index] = getHitboxBounds( entity );
+				defendBounds[index] = getDefendBounds( entity );
+			}
+			FOR( entry : projectiles ) {
+				auto index = indexof( projectiles, entry );
+				if( entry.durability <= 0 || entry.deflected || !entry.aliveCountdown ) {
+					projectileBounds[index] = NoBounds;
+				} else {
+					projectileBounds[index] = getProjectileBounds( entry );
+				}
+			}
+			entityHits     = findRectOverlaps( scratch, attackBounds, defendBounds );
+			projectileHits = findRectOverlaps( scratch, projectileBounds, defendBounds );
+		}
+
 		FOR( entity : staticEntries ) {
 			if( entity.skeleton ) {
 				auto skeletonTraits = getSkeletonTraits( &game->skeletonSystem, entity.type );
 				auto delta          = entity.positionDelta;
 				auto prevPosition   = entity.position - entity.positionDelta;
+				auto index          = indexof( staticEntries, entity );
 				FOR( hitboxId : skeletonTraits->hitboxIds() ) {
 					auto hitbox = getHitboxRelative( entity.skeleton, hitboxId );
 					if( !hitbox.second ) {
 						continue;
 					}
-					FOR( other : staticEntries ) {
+					forEachRectOverlap( &entityHits, index, [&]( int32 otherIndex ) {
+						auto& other = staticEntries[otherIndex];
 						if( &other == &entity || other.team == entity.team
 						    || other.flags.deathFlag ) {
-							continue;
+							return;
 						}
 						auto hit = testHit( &other, SkeletonHitboxState::Hurtbox, entity.handle,
 						                    hitbox.first, prevPosition, delta, nullptr );
 						if( hit ) {
 							hurtEntity( entity.handle, &other, &pairs, hit.normal );
 						}
-					}
+					} );
 				}
 			}
 		}
 
-		FOR( entry : game->projectileSystem.entries ) {
+		FOR( entry : projectiles ) {
 			if( entry.durability <= 0 || entry.deflected || !entry.aliveCountdown ) {
 				continue;
 			}
@@ -1582,6 +1793,7 @@ static void updateGame( AppData* app, GameInputs* inputs, bool focus, float dt )
 			const auto& hitbox = data->hitbox;
 			auto delta         = entry.positionDelta;
 			auto prevPosition  = entry.position - entry.positionDelta;
+			auto index         = indexof( projectiles, entry );
 
 			while( entry.durability > 0 && entry.aliveCountdown && !entry.deflected ) {
 				auto deflect       = false;
@@ -1589,18 +1801,19 @@ static void updateGame( AppData* app, GameInputs* inputs, bool focus, float dt )
 				CollisionInfo info = InvalidCollisionInfo;
 				Entity* hitEntity  = nullptr;
 
-				FOR( other : staticEntries ) {
+				forEachRectOverlap( &projectileHits, index, [&]( int32 otherIndex ) {
+					auto& other = staticEntries[otherIndex];
 					if( other.team == entry.team || other.flags.deathFlag
 					    || other.flags.invincible ) {
-						continue;
+						return;
 					}
 					if( other.flags.hurt ) {
 						// FIXME: find a better solution for not hurting hurt entities multiple
-						// times. If an entity turns invincible after a hit, removing the continue
+						// times. If an entity turns invincible after a hit, removing the return
 						// means they might still get hit multiple times, if the hits all happen on
 						// the exact same frame because invincibility only starts after hit
 						// detection
-						continue;
+						return;
 					}
 					// find a hit with minimal t value
 					{
@@ -1626,7 +1839,7 @@ static void updateGame( AppData* app, GameInputs* inputs, bool focus, float dt )
 							hitEntity = &other;
 						};
 					}
-				}
+				} );
 
 				if( hitEntity ) {
 					if( deflect ) {
@@ -1691,24 +1904,37 @@ static void initializeGame( AppData* app, GameInputs* inputs )
 	if( game->initialized ) {
 		return;
 	}
-	auto allocator               = &app->stackAllocator;
-	game->particleSystem         = makeParticleSystem( allocator, 200 );
-	game->particleSystem.texture = app->platform.loadTexture( "Data/Images/particles.png" );
+	auto allocator       = &app->stackAllocator;
+	auto loader          = &app->assetLoader;
+	game->particleSystem = makeParticleSystem( allocator, 200 );
 
-	game->projectileSystem = makeProjectileSystem( allocator, 200 );
+	// the tile set and textures load on worker threads while the rest is initialized
+	const StringView particlesFilename = "Data/Images/particles.png";
+	const StringView tileSetFilename   = "Data/voxels/default_tileset.json";
+	if( !requestTexture( loader, particlesFilename, &game->particleSystem.texture ) ) {
+		game->particleSystem.texture = app->platform.loadTexture( particlesFilename );
+	}
+	if( !requestTileSet( loader, allocator, tileSetFilename, &game->tileSet ) ) {
+		loadTileSet( allocator, tileSetFilename, &game->tileSet );
+	}
+
+	auto maxProjectiles    = 200;
+	game->projectileSystem = makeProjectileSystem( allocator, maxProjectiles );
 
 	game->outlineShader =
 	    app->platform.loadShader( "Shaders/scale_by_normal.vsh", "Shaders/single_color.fsh" );
 
-	loadTileSet( allocator, "Data/voxels/default_tileset.json", &app->gameState.tileSet );
 	game->skeletonSystem = makeSkeletonSystem();
 
+	// projectiles get handles too, so that they can be part of hitbox pairs
 	auto maxEntities         = 10;
-	game->entityHandles      = makeHandleManager();
-	game->entitySystem       = makeEntitySystem( allocator, maxEntities );
+	auto maxHandles          = maxEntities + maxProjectiles;
+	game->entityHandles      = makeHandleManager( allocator, maxHandles );
+	game->entitySystem       = makeEntitySystem( allocator, maxEntities, maxHandles );
 	game->controlSystem      = makeControlSystem( allocator, maxEntities );
 	game->entityRemovalQueue = makeUArray( allocator, EntityHandle, maxEntities );
 
+	waitForAssets( loader );
 	restartGame( game );
 
 	game->camera             = makeGameCamera( {0, 0, 0}, {0, 0, 1}, {0, 1, 0} );
@@ -1889,39 +2115,105 @@ void processIngameLogs( float dt )
 	GlobalIngameLog->count = array.size();
 }
 
-static void doBlock( Array< ProfilingInfo > infos, ProfilingBlock* block )
+static void doBlock( Array< ProfilingInfo > infos, ProfilingStatistics* statistics,
+                     ProfilingBlock* block )
 {
-	auto info = &infos[block->infoIndex];
-	debugPrintln( "Event: {{{} {:10} {:.2}%}", info->block, block->duration,
-	              block->absRatio * 100 );
+	auto info    = &infos[block->infoIndex];
+	auto summary = getProfilingBlockSummary( statistics, block->infoIndex );
+	debugPrintln( "Event: {{{} {:10} {:.2}% mean {} p95 {} max {}}", info->block, block->duration,
+	              block->absRatio * 100, summary.mean, summary.p95, summary.max );
 }
-static void visitBlock( Array< ProfilingInfo > infos, ProfilingBlock* block,
-                        int32 maxDepth = INT32_MAX );
-static void visitBlockChildren( Array< ProfilingInfo > infos, ProfilingBlock* block,
-                                int32 maxDepth )
+static void visitBlock( Array< ProfilingInfo > infos, ProfilingStatistics* statistics,
+                        ProfilingBlock* block, int32 maxDepth = INT32_MAX );
+static void visitBlockChildren( Array< ProfilingInfo > infos, ProfilingStatistics* statistics,
+                                ProfilingBlock* block, int32 maxDepth )
 {
 	if( maxDepth > 0 ) {
-		doBlock( infos, block );
+		doBlock( infos, statistics, block );
 	}
 	if( maxDepth > 1 ) {
 		for( auto child = block->child; child; child = child->next ) {
-			visitBlock( infos, child, maxDepth - 1 );
+			visitBlock( infos, statistics, child, maxDepth - 1 );
 		}
 	}
 };
-static void visitBlock( Array< ProfilingInfo > infos, ProfilingBlock* block, int32 maxDepth )
+static void visitBlock( Array< ProfilingInfo > infos, ProfilingStatistics* statistics,
+                        ProfilingBlock* block, int32 maxDepth )
 {
 	if( maxDepth <= 0 ) {
 		return;
 	}
 	for( ; block; block = block->next ) {
-		doBlock( infos, block );
+		doBlock( infos, statistics, block );
 		for( auto child = block->child; child; child = child->next ) {
-			visitBlockChildren( infos, child, maxDepth - 1 );
+			visitBlockChildren( infos, statistics, child, maxDepth - 1 );
 		}
 	}
 }
 
+#ifndef NO_PROFILING
+// writes all frames that are still in the profiling buffers as a chrome trace
+static void writeProfilingTraceFile( AppData* app, StringView filename )
+{
+	auto microsecondsPerTick = app->platformInfo->microsecondsPerTick;
+	if( microsecondsPerTick <= 0 ) {
+		LOG( ERROR, "Profiling timestamps can't be converted, platform didn't provide tick rate" );
+		return;
+	}
+
+	// captures are too big for the stack allocator, so we allocate from the platform
+	auto captureSize   = getProfilingCaptureSize();
+	auto captureMemory = GlobalPlatformServices->allocate( captureSize, 16 );
+	if( !captureMemory ) {
+		OutOfMemory();
+		return;
+	}
+	SCOPE_EXIT( & ) { GlobalPlatformServices->deallocate( captureMemory, captureSize, 16 ); };
+
+	auto captureAllocator = makeStackAllocator( captureMemory, captureSize );
+	auto capture =
+	    captureProfilingFrames( &captureAllocator, GlobalProfilingTable, MAX_PROFILING_EVENTS );
+
+	auto traceSize   = getProfilingTraceSize( &capture, GlobalProfilingTable );
+	auto traceMemory = (char*)GlobalPlatformServices->allocate( traceSize, 1 );
+	if( !traceMemory ) {
+		OutOfMemory();
+		return;
+	}
+	SCOPE_EXIT( & ) { GlobalPlatformServices->deallocate( traceMemory, traceSize, 1 ); };
+
+	auto writer    = makeJsonWriter( traceMemory, safe_truncate< int32 >( traceSize ) );
+	writer.minimal = true;
+	writeProfilingTrace( &writer, &capture, GlobalProfilingTable, microsecondsPerTick );
+	GlobalPlatformServices->writeBufferToFile( filename, writer.data(), writer.size() );
+	LOG( INFORMATION, "Wrote {} frames of profiling events to {}", capture.framesCount,
+	     filename );
+	if( capture.droppedEvents ) {
+		LOG( WARNING, "Dropped {} profiling events of threads without a buffer",
+		     capture.droppedEvents );
+	}
+}
+
+// writes the call tree accumulated since the last export as folded stacks
+static void writeProfilingFoldedStacksFile( AppData* app, StringView filename )
+{
+	auto statistics = &app->profilingStatistics;
+	auto size       = getProfilingFoldedStacksSize( statistics, GlobalProfilingTable );
+	auto memory     = (char*)GlobalPlatformServices->allocate( size, 1 );
+	if( !memory ) {
+		OutOfMemory();
+		return;
+	}
+	SCOPE_EXIT( & ) { GlobalPlatformServices->deallocate( memory, size, 1 ); };
+
+	auto builder = string_builder( memory, safe_truncate< int32 >( size ) );
+	writeProfilingFoldedStacks( &builder, statistics, GlobalProfilingTable );
+	GlobalPlatformServices->writeBufferToFile( filename, builder.data(), builder.size() );
+	resetProfilingCallTree( statistics );
+	LOG( INFORMATION, "Wrote folded profiling stacks to {}", filename );
+}
+#endif
+
 void doEasing( AppData* app, GameInputs* inputs, bool focus, float dt )
 {
 	if( !focus ) {
@@ -2094,7 +2386,7 @@ GAME_STORAGE struct RenderCommands* updateAndRender( void* memory, struct GameIn
                                                      int32 stepCount, float blendFactor );
 UPDATE_AND_RENDER( updateAndRender )
 {
-	GlobalProfilingTable->eventsCount = 0;
+	BEGIN_PROFILING_FRAME();
 	BEGIN_PROFILING_BLOCK( "updateAndRender" );
 
 	auto app       = (AppData*)memory;
@@ -2114,8 +2406,19 @@ UPDATE_AND_RENDER( updateAndRender )
 	}
 
 	// beginning of the frame
+	// the platform layer might still be drawing the previous frames, so we record into the next
+	// buffer, render state like wireframe is kept in renderer between frames
 	debugPrintClear();
+	app->renderFrame    = ( app->renderFrame + 1 ) % RENDER_COMMANDS_BUFFERS_COUNT;
+	renderer->allocator = app->renderFrames[app->renderFrame].allocator;
 	clear( renderer );
+#ifdef GAME_MEMORY_TRACKING
+	// after switching buffers, so that the tracked render commands allocator starts a new frame
+	beginMemoryTrackingFrame( GlobalMemoryTrackingTable );
+#endif
+	// assets that finished loading on worker threads are uploaded here
+	processAssetCompletions( &app->assetLoader );
+
 	renderer->ambientStrength = 0.1f;
 	renderer->lightColor      = Color::White;
 	renderer->flashColor      = 0;
@@ -2154,6 +2457,14 @@ UPDATE_AND_RENDER( updateAndRender )
 	if( isHotkeyPressed( inputs, KC_R, KC_Control ) ) {
 		renderer->lightPosition = app->voxelState.camera.position;
 	}
+#ifndef NO_PROFILING
+	if( isHotkeyPressed( inputs, KC_T, KC_Control ) ) {
+		writeProfilingTraceFile( app, "profiling_trace.json" );
+	}
+	if( isHotkeyPressed( inputs, KC_F, KC_Control ) ) {
+		writeProfilingFoldedStacksFile( app, "profiling_folded.txt" );
+	}
+#endif
 
 	// reset mouse lock, locking must be done on each frame, so that on focus change mouse becomes
 	// unlocked automatically
@@ -2175,7 +2486,8 @@ UPDATE_AND_RENDER( updateAndRender )
 	doEasing( app, inputs, app->focus == AppFocus::Easing, dt );
 	RoomEditor::doRoomEditor( app, inputs, app->focus == AppFocus::RoomEditor, dt );
 
-	addRenderCommandMesh( renderer, toMesh( debug_MeshStream ) );
+	// debug_MeshStream is cleared next frame, possibly before this frame is drawn
+	addRenderCommandMeshCopy( renderer, toMesh( debug_MeshStream ) );
 
 	setProjection( renderer, ProjectionType::Orthogonal );
 #if GAME_RENDER_DEBUG_OUTPUT == 1
@@ -2210,12 +2522,22 @@ UPDATE_AND_RENDER( updateAndRender )
 #ifndef NO_PROFILING
 	TEMPORARY_MEMORY_BLOCK( &app->stackAllocator ) {
 		auto state = processProfilingEvents( &app->stackAllocator, GlobalProfilingTable );
+		updateProfilingStatistics( &app->profilingStatistics, &state );
 		debugPrintln( "Infos: {}", state.infos.size() );
-		visitBlock( state.infos, state.blocks.head, 2 );
+		if( state.droppedEvents ) {
+			debugPrintln( "Dropped events: {}", state.droppedEvents );
+		}
+		visitBlock( state.infos, &app->profilingStatistics, state.blocks.head, 2 );
 	}
 #endif
 
 	showGameDebugGui( app, inputs, true, dt );
 
-	return renderer;
+#ifdef GAME_MEMORY_TRACKING
+	endMemoryTrackingFrame( GlobalMemoryTrackingTable );
+#endif
+	// hand the frame over to the platform layer, renderer keeps recording into the next buffer
+	auto frame = &app->renderFrames[app->renderFrame];
+	*frame     = *renderer;
+	return frame;
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+// input recordings that can be persisted to a file and replayed by the headless host
+// persisted recordings always start right after initializeApp, so that they can be replayed without
+// a snapshot of game memory (which contains pointers that are only valid inside one process)
+
+const uint32 InputRecordingMagic   = 0x52504E49;  // "INPR"
+const uint32 InputRecordingVersion = 1;
+
+struct InputRecordingFrame {
+	GameInputs inputs;
+	GameInputs fixedInputs;
+	float elapsedTime;
+	int32 stepCount;
+};
+
+struct InputRecordingHeader {
+	uint32 magic;
+	uint32 version;
+	uint32 frameSize;  // sizeof( InputRecordingFrame ), recordings are only valid for the same layout
+	int32 framesCount;
+};
+
+void saveInputRecording( WriteBufferToFileType* writeBufferToFile, StringView filename,
+                         Array< InputRecordingFrame > frames )
+{
+	assert( writeBufferToFile );
+	auto framesSize = frames.size() * sizeof( InputRecordingFrame );
+	auto size       = sizeof( InputRecordingHeader ) + framesSize;
+	auto buffer     = new char[size];
+
+	InputRecordingHeader header = {};
+	header.magic                = InputRecordingMagic;
+	header.version              = InputRecordingVersion;
+	header.frameSize            = sizeof( InputRecordingFrame );
+	header.framesCount          = frames.size();
+	memcpy( buffer, &header, sizeof( InputRecordingHeader ) );
+	memcpy( buffer + sizeof( InputRecordingHeader ), frames.data(), framesSize );
+
+	writeBufferToFile( filename, buffer, size );
+	delete[] buffer;
+}
+
+// returns frames pointing into data, data needs to outlive the returned array
+Array< InputRecordingFrame > parseInputRecording( StringView data )
+{
+	InputRecordingHeader header = {};
+	if( data.size() < (int32)sizeof( InputRecordingHeader ) ) {
+		LOG( ERROR, "Input recording is too small" );
+		return {};
+	}
+	memcpy( &header, data.data(), sizeof( InputRecordingHeader ) );
+	if( header.magic != InputRecordingMagic ) {
+		LOG( ERROR, "Input recording has invalid magic" );
+		return {};
+	}
+	if( header.version != InputRecordingVersion
+	    || header.frameSize != sizeof( InputRecordingFrame ) ) {
+		LOG( ERROR, "Input recording version mismatch" );
+		return {};
+	}
+	auto framesSize = (size_t)data.size() - sizeof( InputRecordingHeader );
+	if( header.framesCount < 0
+	    || (size_t)header.framesCount * sizeof( InputRecordingFrame ) != framesSize ) {
+		LOG( ERROR, "Input recording is corrupted" );
+		return {};
+	}
+	auto frames = (InputRecordingFrame*)( data.data() + sizeof( InputRecordingHeader ) );
+	return makeArrayView( frames, header.framesCount );
+}
@@ -0,0 +1,91 @@
+// worker threads of the JobSystem, owned by the platform layer
+// workers spin for a while when they run out of jobs and go to sleep afterwards, addJobs wakes them
+// through JobSystem::wakeWorkers
+
+#include <mutex>
+#include <condition_variable>
+
+// attempts to find a job before a worker goes to sleep
+const int32 JobWorkerSpinCount = 1000;
+
+struct JobWorkers {
+	JobSystem system;
+	std::thread threads[MAX_JOB_WORKERS];
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::atomic< bool > running;
+};
+
+static void wakeJobWorkers( JobSystem* system )
+{
+	auto workers = (JobWorkers*)system->platformData;
+	// locking makes sure that a worker that is about to sleep is already waiting
+	std::lock_guard< std::mutex > lock( workers->mutex );
+	workers->condition.notify_all();
+}
+
+static void runJobWorker( JobWorkers* workers, int32 workerIndex )
+{
+	auto system = &workers->system;
+	{
+		// wait until initJobWorkers stored the ids of all workers
+		std::lock_guard< std::mutex > lock( workers->mutex );
+	}
+	while( workers->running.load( std::memory_order_relaxed ) ) {
+		auto found = false;
+		for( auto i = 0; i < JobWorkerSpinCount && !found; ++i ) {
+			found = tryRunJob( system, workerIndex );
+		}
+		if( found ) {
+			continue;
+		}
+
+		std::unique_lock< std::mutex > lock( workers->mutex );
+		system->sleepingCount.fetch_add( 1, std::memory_order_seq_cst );
+		if( !hasPendingJobs( system ) && workers->running.load( std::memory_order_relaxed ) ) {
+			workers->condition.wait( lock );
+		}
+		system->sleepingCount.fetch_sub( 1, std::memory_order_relaxed );
+	}
+}
+
+// the calling thread becomes worker 0, threadsCount - 1 threads are created
+// workers needs to stay at the same address until destroyJobWorkers
+void initJobWorkers( JobWorkers* workers, int32 threadsCount )
+{
+	assert( workers );
+	auto system = &workers->system;
+	for( auto& deque : system->deques ) {
+		deque.top    = 0;
+		deque.bottom = 0;
+	}
+	system->background.top    = 0;
+	system->background.bottom = 0;
+	system->backgroundPending = 0;
+	system->sleepingCount     = 0;
+	system->workersCount  = clamp( threadsCount, 1, MAX_JOB_WORKERS );
+	system->threadIds[0] = std::this_thread::get_id();
+	system->wakeWorkers  = wakeJobWorkers;
+	system->platformData = workers;
+	workers->running     = true;
+	// workers wait for the lock before running jobs, so they see the ids of every worker
+	std::lock_guard< std::mutex > lock( workers->mutex );
+	for( auto i = 1; i < system->workersCount; ++i ) {
+		workers->threads[i]  = std::thread( runJobWorker, workers, i );
+		system->threadIds[i] = workers->threads[i].get_id();
+	}
+}
+
+void destroyJobWorkers( JobWorkers* workers )
+{
+	assert( workers );
+	{
+		std::lock_guard< std::mutex > lock( workers->mutex );
+		workers->running = false;
+		workers->condition.notify_all();
+	}
+	for( auto i = 1; i < workers->system.workersCount; ++i ) {
+		workers->threads[i].join();
+	}
+	workers->system.workersCount = 0;
+}
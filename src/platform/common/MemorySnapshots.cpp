@@ -0,0 +1,263 @@
+// snapshots of a memory block that only store blocks that changed since the previous snapshot
+// memory is split into blocks that are hashed with fnv1a64, blocks with the same hash and contents
+// as in the previous snapshot are shared, so only changed blocks cost memory
+// the first snapshot is always kept, when storage runs out the second oldest snapshot is evicted
+
+const int32 MemorySnapshotBlockSize = 4096;
+const int32 MemorySnapshotZeroBlock = -1;  // block was all zeroes, nothing is stored
+
+struct MemorySnapshot {
+	int32* blocks;    // index into storage for every block of memory or MemorySnapshotZeroBlock
+	uint64* hashes;   // hash of every block when the snapshot was taken
+	int32 tag;        // user data, like the frame the snapshot was taken at
+	int32 newBlocks;  // number of blocks that were stored for this snapshot
+};
+
+struct MemorySnapshots {
+	uint8* memory;
+	size_t memorySize;
+	int32 blocksCount;
+	uint64 zeroHash;
+	uint64* hashes;  // hashes of the snapshot that is currently being taken
+
+	// block storage, blocks are reference counted since unchanged blocks are shared by snapshots
+	uint8* storage;
+	int32* refCounts;
+	int32* freeBlocks;  // stack of unused storage blocks
+	int32 freeBlocksCount;
+	int32 storageCapacity;
+
+	MemorySnapshot* snapshots;  // ordered from oldest to newest
+	int32 snapshotsCount;
+	int32 snapshotsCapacity;
+};
+
+static int32 getMemorySnapshotBlocksCount( size_t memorySize )
+{
+	return safe_truncate< int32 >( ( memorySize + MemorySnapshotBlockSize - 1 )
+	                               / MemorySnapshotBlockSize );
+}
+
+// size of memory needed by makeMemorySnapshots, including alignment padding
+size_t getMemorySnapshotsSize( size_t memorySize, int32 maxSnapshots, int32 maxStoredBlocks )
+{
+	auto blocksCount = (size_t)getMemorySnapshotBlocksCount( memorySize );
+	return (size_t)maxStoredBlocks * ( MemorySnapshotBlockSize + 2 * sizeof( int32 ) )
+	       + (size_t)maxSnapshots
+	             * ( sizeof( MemorySnapshot ) + blocksCount * ( sizeof( int32 ) + sizeof( uint64 ) ) )
+	       + blocksCount * sizeof( uint64 ) + ( 5 + 2 * maxSnapshots ) * 16;
+}
+
+MemorySnapshots makeMemorySnapshots( StackAllocator* allocator, void* memory, size_t memorySize,
+                                     int32 maxSnapshots, int32 maxStoredBlocks )
+{
+	assert( isValid( allocator ) );
+	assert( memory );
+	assert( maxSnapshots > 0 );
+
+	MemorySnapshots result   = {};
+	result.memory            = (uint8*)memory;
+	result.memorySize        = memorySize;
+	result.blocksCount       = getMemorySnapshotBlocksCount( memorySize );
+	result.storageCapacity   = maxStoredBlocks;
+	result.snapshotsCapacity = maxSnapshots;
+
+	result.storage =
+	    (uint8*)allocate( allocator, (size_t)maxStoredBlocks * MemorySnapshotBlockSize, 16 );
+	result.refCounts  = allocateArray( allocator, int32, maxStoredBlocks );
+	result.freeBlocks = allocateArray( allocator, int32, maxStoredBlocks );
+	result.snapshots  = allocateArray( allocator, MemorySnapshot, maxSnapshots );
+	result.hashes     = allocateArray( allocator, uint64, result.blocksCount );
+	if( !result.storage || !result.refCounts || !result.freeBlocks || !result.snapshots
+	    || !result.hashes ) {
+		OutOfMemory();
+		return {};
+	}
+	for( auto i = 0; i < maxSnapshots; ++i ) {
+		auto snapshot    = &result.snapshots[i];
+		*snapshot        = {};
+		snapshot->blocks = allocateArray( allocator, int32, result.blocksCount );
+		snapshot->hashes = allocateArray( allocator, uint64, result.blocksCount );
+		if( !snapshot->blocks || !snapshot->hashes ) {
+			OutOfMemory();
+			return {};
+		}
+	}
+
+	// free blocks are popped from the back, so that storage gets used front to back
+	for( auto i = 0; i < maxStoredBlocks; ++i ) {
+		result.freeBlocks[i] = maxStoredBlocks - i - 1;
+	}
+	result.freeBlocksCount = maxStoredBlocks;
+
+	uint8 zeroes[MemorySnapshotBlockSize] = {};
+	result.zeroHash = fnv1a64( zeroes, zeroes + MemorySnapshotBlockSize );
+	return result;
+}
+bool isValid( MemorySnapshots* snapshots ) { return snapshots && snapshots->snapshots; }
+
+static void releaseMemorySnapshot( MemorySnapshots* snapshots, MemorySnapshot* snapshot )
+{
+	for( auto i = 0; i < snapshots->blocksCount; ++i ) {
+		auto block = snapshot->blocks[i];
+		if( block != MemorySnapshotZeroBlock ) {
+			assert( snapshots->refCounts[block] > 0 );
+			if( --snapshots->refCounts[block] == 0 ) {
+				snapshots->freeBlocks[snapshots->freeBlocksCount++] = block;
+			}
+		}
+	}
+}
+
+// evicts the second oldest snapshot, the oldest one is the one replays start from
+static bool evictMemorySnapshot( MemorySnapshots* snapshots )
+{
+	if( snapshots->snapshotsCount < 3 ) {
+		// the oldest snapshot and the snapshot that is diffed against are needed
+		return false;
+	}
+	auto evicted = snapshots->snapshots[1];
+	releaseMemorySnapshot( snapshots, &evicted );
+	auto first = snapshots->snapshots + 1;
+	auto last  = snapshots->snapshots + snapshots->snapshotsCount;
+	memmove( first, first + 1, ( last - first - 1 ) * sizeof( MemorySnapshot ) );
+	// keep the arrays of the evicted snapshot for reuse
+	snapshots->snapshots[snapshots->snapshotsCount - 1] = evicted;
+	--snapshots->snapshotsCount;
+	return true;
+}
+
+static bool isMemorySnapshotZeroBlock( MemorySnapshots* snapshots, uint64 hash, const uint8* data,
+                                       size_t size )
+{
+	return hash == snapshots->zeroHash && isMemoryZero( (char*)data, size );
+}
+
+// whether block i is unchanged since previous was taken, a matching hash alone isn't enough, since
+// a collision would silently restore the wrong memory
+static bool isMemorySnapshotBlockUnchanged( MemorySnapshots* snapshots, MemorySnapshot* previous,
+                                            int32 i, uint64 hash, const uint8* data, size_t size )
+{
+	if( !previous || previous->hashes[i] != hash ) {
+		return false;
+	}
+	auto block = previous->blocks[i];
+	if( block == MemorySnapshotZeroBlock ) {
+		return isMemoryZero( (char*)data, size );
+	}
+	return memcmp( snapshots->storage + (size_t)block * MemorySnapshotBlockSize, data, size ) == 0;
+}
+
+// returns false if there is not enough storage for the snapshot
+bool takeMemorySnapshot( MemorySnapshots* snapshots, int32 tag )
+{
+	assert( isValid( snapshots ) );
+	if( snapshots->snapshotsCount == snapshots->snapshotsCapacity
+	    && !evictMemorySnapshot( snapshots ) ) {
+		LOG( ERROR, "Too many memory snapshots" );
+		return false;
+	}
+
+	// hash all blocks first to find out how much storage we need, so that we can evict snapshots
+	// before we start storing blocks
+	auto previous = ( snapshots->snapshotsCount )
+	                    ? ( &snapshots->snapshots[snapshots->snapshotsCount - 1] )
+	                    : ( (MemorySnapshot*)nullptr );
+	int32 neededBlocks = 0;
+	for( auto i = 0; i < snapshots->blocksCount; ++i ) {
+		auto offset = (size_t)i * MemorySnapshotBlockSize;
+		auto size   = min( (size_t)MemorySnapshotBlockSize, snapshots->memorySize - offset );
+		auto data   = snapshots->memory + offset;
+		auto hash   = fnv1a64( data, data + size );
+
+		snapshots->hashes[i] = hash;
+		if( !isMemorySnapshotBlockUnchanged( snapshots, previous, i, hash, data, size )
+		    && !isMemorySnapshotZeroBlock( snapshots, hash, data, size ) ) {
+			++neededBlocks;
+		}
+	}
+	while( snapshots->freeBlocksCount < neededBlocks ) {
+		if( !evictMemorySnapshot( snapshots ) ) {
+			LOG( ERROR, "Out of memory snapshot storage" );
+			return false;
+		}
+		// evicting moves snapshots down by one, previous is still the newest snapshot
+		previous = &snapshots->snapshots[snapshots->snapshotsCount - 1];
+	}
+
+	auto snapshot       = &snapshots->snapshots[snapshots->snapshotsCount];
+	snapshot->tag       = tag;
+	snapshot->newBlocks = neededBlocks;
+	swap( snapshot->hashes, snapshots->hashes );
+	for( auto i = 0; i < snapshots->blocksCount; ++i ) {
+		auto offset = (size_t)i * MemorySnapshotBlockSize;
+		auto size   = min( (size_t)MemorySnapshotBlockSize, snapshots->memorySize - offset );
+		auto data   = snapshots->memory + offset;
+		auto hash   = snapshot->hashes[i];
+
+		if( isMemorySnapshotBlockUnchanged( snapshots, previous, i, hash, data, size ) ) {
+			auto block          = previous->blocks[i];
+			snapshot->blocks[i] = block;
+			if( block != MemorySnapshotZeroBlock ) {
+				++snapshots->refCounts[block];
+			}
+		} else if( isMemorySnapshotZeroBlock( snapshots, hash, data, size ) ) {
+			snapshot->blocks[i] = MemorySnapshotZeroBlock;
+		} else {
+			assert( snapshots->freeBlocksCount > 0 );
+			auto block = snapshots->freeBlocks[--snapshots->freeBlocksCount];
+			memcpy( snapshots->storage + (size_t)block * MemorySnapshotBlockSize, data, size );
+			snapshots->refCounts[block] = 1;
+			snapshot->blocks[i]         = block;
+		}
+	}
+	++snapshots->snapshotsCount;
+	return true;
+}
+
+void restoreMemorySnapshot( MemorySnapshots* snapshots, int32 index )
+{
+	assert( isValid( snapshots ) );
+	assert( index >= 0 && index < snapshots->snapshotsCount );
+
+	auto snapshot = &snapshots->snapshots[index];
+	for( auto i = 0; i < snapshots->blocksCount; ++i ) {
+		auto offset = (size_t)i * MemorySnapshotBlockSize;
+		auto size   = min( (size_t)MemorySnapshotBlockSize, snapshots->memorySize - offset );
+		auto block  = snapshot->blocks[i];
+		if( block == MemorySnapshotZeroBlock ) {
+			memset( snapshots->memory + offset, 0, size );
+		} else {
+			memcpy( snapshots->memory + offset,
+			        snapshots->storage + (size_t)block * MemorySnapshotBlockSize, size );
+		}
+	}
+}
+
+// index of the newest snapshot with a tag less or equal to tag, -1 if there is none
+int32 findMemorySnapshot( MemorySnapshots* snapshots, int32 tag )
+{
+	assert( isValid( snapshots ) );
+	for( auto i = snapshots->snapshotsCount - 1; i >= 0; --i ) {
+		if( snapshots->snapshots[i].tag <= tag ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void clearMemorySnapshots( MemorySnapshots* snapshots )
+{
+	assert( isValid( snapshots ) );
+	for( auto i = 0; i < snapshots->snapshotsCount; ++i ) {
+		releaseMemorySnapshot( snapshots, &snapshots->snapshots[i] );
+	}
+	snapshots->snapshotsCount = 0;
+	assert( snapshots->freeBlocksCount == snapshots->storageCapacity );
+}
+
+// number of blocks in storage, multiply by MemorySnapshotBlockSize to get bytes
+int32 getMemorySnapshotsStoredBlocks( MemorySnapshots* snapshots )
+{
+	return snapshots->storageCapacity - snapshots->freeBlocksCount;
+}
@@ -0,0 +1,86 @@
+// render thread that draws the RenderCommands of a frame while the game updates the next one
+// ownership of the commands is handed over with submitRenderFrame and handed back when
+// waitForRenderFrame returns, at most one frame is in flight, which the double buffered
+// RenderCommands of the game allow (see RENDER_COMMANDS_BUFFERS_COUNT)
+// the platform layer needs to call waitForRenderFrame before it changes anything the render
+// callback reads, like textures and meshes, or before game memory is reinitialized
+
+#include <mutex>
+#include <condition_variable>
+
+static_assert( RENDER_COMMANDS_BUFFERS_COUNT >= 2, "pipelining needs a second command buffer" );
+
+typedef void RenderFrameType( void* data, RenderCommands* renderCommands );
+
+struct RenderPipeline {
+	RenderFrameType* render;
+	void* data;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable condition;
+	RenderCommands* pending;  // frame owned by the render thread, nullptr if it is idle
+	bool running;
+};
+
+static void runRenderPipeline( RenderPipeline* pipeline )
+{
+	std::unique_lock< std::mutex > lock( pipeline->mutex );
+	for( ;; ) {
+		pipeline->condition.wait( lock, [pipeline]() {
+			return pipeline->pending || !pipeline->running;
+		} );
+		if( !pipeline->pending ) {
+			break;
+		}
+		auto renderCommands = pipeline->pending;
+		lock.unlock();
+		pipeline->render( pipeline->data, renderCommands );
+		lock.lock();
+		pipeline->pending = nullptr;
+		pipeline->condition.notify_all();
+	}
+}
+
+// pipeline needs to stay at the same address until destroyRenderPipeline
+void initRenderPipeline( RenderPipeline* pipeline, RenderFrameType* render, void* data )
+{
+	assert( pipeline );
+	assert( render );
+	pipeline->render  = render;
+	pipeline->data    = data;
+	pipeline->pending = nullptr;
+	pipeline->running = true;
+	pipeline->thread  = std::thread( runRenderPipeline, pipeline );
+}
+
+// waits until the frame in flight is drawn, afterwards the render thread doesn't touch any data
+void waitForRenderFrame( RenderPipeline* pipeline )
+{
+	assert( pipeline );
+	std::unique_lock< std::mutex > lock( pipeline->mutex );
+	pipeline->condition.wait( lock, [pipeline]() { return !pipeline->pending; } );
+}
+
+// hands renderCommands over to the render thread, waits for the previous frame first
+void submitRenderFrame( RenderPipeline* pipeline, RenderCommands* renderCommands )
+{
+	assert( pipeline );
+	assert( renderCommands );
+	std::unique_lock< std::mutex > lock( pipeline->mutex );
+	pipeline->condition.wait( lock, [pipeline]() { return !pipeline->pending; } );
+	pipeline->pending = renderCommands;
+	pipeline->condition.notify_all();
+}
+
+// draws the frame in flight and joins the render thread
+void destroyRenderPipeline( RenderPipeline* pipeline )
+{
+	assert( pipeline );
+	{
+		std::unique_lock< std::mutex > lock( pipeline->mutex );
+		pipeline->condition.wait( lock, [pipeline]() { return !pipeline->pending; } );
+		pipeline->running = false;
+		pipeline->condition.notify_all();
+	}
+	pipeline->thread.join();
+}
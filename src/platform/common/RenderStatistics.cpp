@@ -0,0 +1,337 @@
+// render backend that consumes RenderCommands on the cpu and only gathers statistics
+// it simulates the batching of the opengl backend (dynamic vertex buffer, flushes on state changes)
+// so that the cost of generating render commands and wasted state changes can be measured on
+// machines without a gpu
+
+enum RenderBatchBreakValues : int32 {
+	RenderBatchBreak_BufferFull,
+	RenderBatchBreak_LineMesh,
+	RenderBatchBreak_Texture,
+	RenderBatchBreak_Shader,
+	RenderBatchBreak_Projection,
+	RenderBatchBreak_ProjectionMatrix,
+	RenderBatchBreak_RenderState,
+
+	RenderBatchBreak_Count
+};
+static const char* const RenderBatchBreakNames[] = {
+    "BufferFull", "LineMesh", "Texture", "Shader", "Projection", "ProjectionMatrix", "RenderState",
+};
+static_assert( countof( RenderBatchBreakNames ) == RenderBatchBreak_Count,
+               "Invalid RenderBatchBreakNames" );
+
+struct RenderStatistics {
+	int64 commands;
+	int64 meshes;
+	int64 lineMeshes;
+	int64 staticMeshes;
+	int64 jumps;
+	int64 drawCalls;
+
+	// vertices and indices copied into the dynamic buffer
+	int64 verticesCopied;
+	int64 indicesCopied;
+	// vertices and indices of static meshes, these are not copied
+	int64 staticVertices;
+	int64 staticIndices;
+
+	// state changes, redundant means the state was set to the value it already had
+	int64 textureChanges;
+	int64 redundantTextureChanges;
+	int64 shaderChanges;
+	int64 redundantShaderChanges;
+	int64 projectionChanges;
+	int64 redundantProjectionChanges;
+	int64 projectionMatrixChanges;
+	int64 renderStateChanges;
+	int64 redundantRenderStateChanges;
+	int64 scissorRects;
+
+	// why the current batch had to be flushed, only counted if the batch wasn't empty
+	int64 batchBreaks[RenderBatchBreak_Count];
+
+	size_t commandBytes;
+	size_t commandCapacity;
+};
+
+struct RenderStatisticsContext {
+	// simulated dynamic vertex buffer
+	int32 verticesCapacity;
+	int32 indicesCapacity;
+	int32 usedVerticesCount;  // vertices already drawn since the buffer was last reset
+	int32 usedIndicesCount;
+	int32 verticesCount;  // vertices of the current batch
+	int32 indicesCount;
+
+	TextureId currentTextures[2];
+	ShaderId currentShader;
+	ProjectionType currentProjectionType;
+	bool8 renderStates[valueof( RenderStateType::Count )];
+
+	UArray< Mesh >* meshes;  // mesh table of the platform layer, indexed by MeshId - 1
+
+	RenderStatistics frame;  // statistics of the last processed frame
+	RenderStatistics total;  // statistics accumulated over all frames
+	int64 framesCount;
+};
+
+// initial state mirrors the opengl backend
+RenderStatisticsContext makeRenderStatisticsContext( UArray< Mesh >* meshes,
+                                                     int32 verticesCapacity = 10000,
+                                                     int32 indicesCapacity  = 60000 )
+{
+	assert( meshes );
+	assert( verticesCapacity > 0 );
+	assert( indicesCapacity > 0 );
+	RenderStatisticsContext result = {};
+	result.verticesCapacity        = verticesCapacity;
+	result.indicesCapacity         = indicesCapacity;
+	result.meshes                  = meshes;
+	result.renderStates[valueof( RenderStateType::DepthTest )]  = true;
+	result.renderStates[valueof( RenderStateType::DepthWrite )] = true;
+	result.renderStates[valueof( RenderStateType::Lighting )]   = true;
+	return result;
+}
+
+static void renderStatisticsDraw( RenderStatisticsContext* context )
+{
+	++context->frame.drawCalls;
+	context->usedVerticesCount += context->verticesCount;
+	context->usedIndicesCount += context->indicesCount;
+	context->verticesCount = 0;
+	context->indicesCount  = 0;
+}
+static void renderStatisticsFlush( RenderStatisticsContext* context, RenderBatchBreakValues reason )
+{
+	if( context->indicesCount ) {
+		++context->frame.batchBreaks[reason];
+		renderStatisticsDraw( context );
+	}
+}
+static void renderStatisticsReset( RenderStatisticsContext* context )
+{
+	++context->frame.batchBreaks[RenderBatchBreak_BufferFull];
+	renderStatisticsDraw( context );
+	context->usedVerticesCount = 0;
+	context->usedIndicesCount  = 0;
+}
+static bool renderStatisticsHasSpace( RenderStatisticsContext* context, int32 verticesCount,
+                                      int32 indicesCount )
+{
+	auto remainingVerticesCount =
+	    context->verticesCapacity - ( context->usedVerticesCount + context->verticesCount );
+	auto remainingIndicesCount =
+	    context->indicesCapacity - ( context->usedIndicesCount + context->indicesCount );
+	return verticesCount <= remainingVerticesCount && indicesCount <= remainingIndicesCount;
+}
+static bool renderStatisticsCopyMesh( RenderStatisticsContext* context, Mesh* mesh,
+                                      bool lineMesh )
+{
+	if( mesh->verticesCount > context->verticesCapacity ) {
+		LOG( ERROR, "Mesh vertices count is bigger than vertex buffer capacity" );
+		return false;
+	}
+	if( !renderStatisticsHasSpace( context, mesh->verticesCount, mesh->indicesCount ) ) {
+		renderStatisticsReset( context );
+	} else if( lineMesh ) {
+		renderStatisticsFlush( context, RenderBatchBreak_LineMesh );
+	}
+	context->verticesCount += mesh->verticesCount;
+	context->indicesCount += mesh->indicesCount;
+	context->frame.verticesCopied += mesh->verticesCount;
+	context->frame.indicesCopied += mesh->indicesCount;
+	return true;
+}
+
+void accumulate( RenderStatistics* total, const RenderStatistics& frame )
+{
+	total->commands += frame.commands;
+	total->meshes += frame.meshes;
+	total->lineMeshes += frame.lineMeshes;
+	total->staticMeshes += frame.staticMeshes;
+	total->jumps += frame.jumps;
+	total->drawCalls += frame.drawCalls;
+	total->verticesCopied += frame.verticesCopied;
+	total->indicesCopied += frame.indicesCopied;
+	total->staticVertices += frame.staticVertices;
+	total->staticIndices += frame.staticIndices;
+	total->textureChanges += frame.textureChanges;
+	total->redundantTextureChanges += frame.redundantTextureChanges;
+	total->shaderChanges += frame.shaderChanges;
+	total->redundantShaderChanges += frame.redundantShaderChanges;
+	total->projectionChanges += frame.projectionChanges;
+	total->redundantProjectionChanges += frame.redundantProjectionChanges;
+	total->projectionMatrixChanges += frame.projectionMatrixChanges;
+	total->renderStateChanges += frame.renderStateChanges;
+	total->redundantRenderStateChanges += frame.redundantRenderStateChanges;
+	total->scissorRects += frame.scissorRects;
+	for( auto i = 0; i < RenderBatchBreak_Count; ++i ) {
+		total->batchBreaks[i] += frame.batchBreaks[i];
+	}
+	total->commandBytes += frame.commandBytes;
+	total->commandCapacity = max( total->commandCapacity, frame.commandCapacity );
+}
+
+void processRenderCommandsStatistics( RenderStatisticsContext* context,
+                                      RenderCommands* renderCommands )
+{
+	assert( context );
+	assert( isValid( renderCommands ) );
+
+	auto frame             = &context->frame;
+	*frame                 = {};
+	frame->commandBytes    = renderCommands->allocator.size;
+	frame->commandCapacity = renderCommands->allocator.capacity;
+
+	// the opengl backend maps the whole dynamic buffer at the start of every frame
+	context->usedVerticesCount = 0;
+	context->usedIndicesCount  = 0;
+	context->verticesCount     = 0;
+	context->indicesCount      = 0;
+	context->currentShader     = {};
+
+	auto stream = getRenderCommandsStream( renderCommands );
+	while( stream.size ) {
+		auto header = getRenderCommandsHeader( &stream );
+		++frame->commands;
+		switch( header->type ) {
+			case RenderCommandEntryType::Mesh: {
+				auto body = getRenderCommandMesh( &stream, header );
+				++frame->meshes;
+				renderStatisticsCopyMesh( context, &body->mesh, false );
+				break;
+			}
+			case RenderCommandEntryType::LineMesh: {
+				auto body = getRenderCommandLineMesh( &stream, header );
+				++frame->lineMeshes;
+				if( renderStatisticsCopyMesh( context, &body->mesh, true ) ) {
+					// line meshes are drawn immediately with a different primitive type
+					renderStatisticsDraw( context );
+				}
+				break;
+			}
+			case RenderCommandEntryType::StaticMesh: {
+				auto body = getRenderCommandBody( &stream, header, RenderCommandStaticMesh );
+				if( body->meshId ) {
+					++frame->staticMeshes;
+					++frame->drawCalls;
+					auto mesh = &( *context->meshes )[body->meshId.id - 1];
+					assert( mesh->verticesCount > 0 );
+					frame->staticVertices += mesh->verticesCount;
+					frame->staticIndices += mesh->indicesCount;
+				}
+				break;
+			}
+			case RenderCommandEntryType::SetTexture: {
+				auto body = getRenderCommandBody( &stream, header, RenderCommandSetTexture );
+				assert( body->stage >= 0 && body->stage < 2 );
+				if( context->currentTextures[body->stage] != body->id ) {
+					++frame->textureChanges;
+					renderStatisticsFlush( context, RenderBatchBreak_Texture );
+					context->currentTextures[body->stage] = body->id;
+				} else {
+					++frame->redundantTextureChanges;
+				}
+				break;
+			}
+			case RenderCommandEntryType::SetShader: {
+				auto body = getRenderCommandBody( &stream, header, RenderCommandSetShader );
+				if( context->currentShader != body->id ) {
+					++frame->shaderChanges;
+					renderStatisticsFlush( context, RenderBatchBreak_Shader );
+					context->currentShader = body->id;
+				} else {
+					++frame->redundantShaderChanges;
+				}
+				break;
+			}
+			case RenderCommandEntryType::SetProjection: {
+				auto body = getRenderCommandBody( &stream, header, RenderCommandSetProjection );
+				assert( valueof( body->projectionType ) >= 0
+				        && valueof( body->projectionType ) < 2 );
+				if( context->currentProjectionType != body->projectionType ) {
+					++frame->projectionChanges;
+					renderStatisticsFlush( context, RenderBatchBreak_Projection );
+					context->currentProjectionType = body->projectionType;
+				} else {
+					++frame->redundantProjectionChanges;
+				}
+				break;
+			}
+			case RenderCommandEntryType::SetProjectionMatrix: {
+				auto body =
+				    getRenderCommandBody( &stream, header, RenderCommandSetProjectionMatrix );
+				++frame->projectionMatrixChanges;
+				if( context->currentProjectionType == body->projectionType ) {
+					renderStatisticsFlush( context, RenderBatchBreak_ProjectionMatrix );
+				}
+				break;
+			}
+			case RenderCommandEntryType::SetScissorRect: {
+				getRenderCommandBody( &stream, header, RenderCommandSetScissorRect );
+				++frame->scissorRects;
+				break;
+			}
+			case RenderCommandEntryType::SetRenderState: {
+				auto body = getRenderCommandBody( &stream, header, RenderCommandSetRenderState );
+				auto type = valueof( body->renderStateType );
+				assert( type >= 0 && type < valueof( RenderStateType::Count ) );
+				if( context->renderStates[type] != body->enabled ) {
+					++frame->renderStateChanges;
+					renderStatisticsFlush( context, RenderBatchBreak_RenderState );
+					context->renderStates[type] = body->enabled;
+				} else {
+					++frame->redundantRenderStateChanges;
+				}
+				break;
+			}
+			case RenderCommandEntryType::Jump: {
+				auto body = getRenderCommandBody( &stream, header, RenderCommandJump );
+				++frame->jumps;
+				stream.ptr = body->jumpDestination;
+				break;
+			}
+			InvalidDefaultCase;
+		}
+	}
+
+	if( context->indicesCount ) {
+		renderStatisticsDraw( context );
+	}
+
+	accumulate( &context->total, *frame );
+	++context->framesCount;
+}
+
+void printRenderStatistics( FILE* file, RenderStatisticsContext* context )
+{
+	auto total = &context->total;
+	auto count = (double)max( context->framesCount, (int64)1 );
+	fprintf( file, "render statistics over %lld frames (averages per frame):\n",
+	         (long long)context->framesCount );
+	fprintf( file, "  commands %.1f, command memory %.0f bytes of %zu\n",
+	         total->commands / count, total->commandBytes / count, total->commandCapacity );
+	fprintf( file, "  meshes %.1f, line meshes %.1f, static meshes %.1f, jumps %.1f\n",
+	         total->meshes / count, total->lineMeshes / count, total->staticMeshes / count,
+	         total->jumps / count );
+	fprintf( file, "  draw calls %.1f, vertices copied %.1f, indices copied %.1f\n",
+	         total->drawCalls / count, total->verticesCopied / count,
+	         total->indicesCopied / count );
+	fprintf( file, "  static vertices %.1f, static indices %.1f\n", total->staticVertices / count,
+	         total->staticIndices / count );
+	fprintf( file, "  texture changes %.1f (redundant %.1f)\n", total->textureChanges / count,
+	         total->redundantTextureChanges / count );
+	fprintf( file, "  shader changes %.1f (redundant %.1f)\n", total->shaderChanges / count,
+	         total->redundantShaderChanges / count );
+	fprintf( file, "  projection changes %.1f (redundant %.1f), projection matrices %.1f\n",
+	         total->projectionChanges / count, total->redundantProjectionChanges / count,
+	         total->projectionMatrixChanges / count );
+	fprintf( file, "  render state changes %.1f (redundant %.1f), scissor rects %.1f\n",
+	         total->renderStateChanges / count, total->redundantRenderStateChanges / count,
+	         total->scissorRects / count );
+	fprintf( file, "  batch breaks:" );
+	for( auto i = 0; i < RenderBatchBreak_Count; ++i ) {
+		fprintf( file, " %s %.1f", RenderBatchBreakNames[i], total->batchBreaks[i] / count );
+	}
+	fprintf( file, "\n" );
+}
@@ -0,0 +1,889 @@
+// tile based software rasterizer that executes RenderCommands on the cpu
+// triangles are transformed and binned into screen tiles on the calling thread, the tiles are then
+// rasterized in parallel, every tile is owned by exactly one thread and triangles are rasterized in
+// submission order, so the result is deterministic regardless of the number of threads
+// the threads are created once by the platform layer (see SoftwareRasterizer), the thread that
+// flushes rasterizes tiles together with them
+// this is not an exact reproduction of the opengl backend (lighting is per vertex, there is no
+// near plane clipping), it is meant for benchmarking and golden image comparisons
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <emmintrin.h>
+
+#define STBIW_ASSERT( x ) assert( x )
+#define STBI_WRITE_NO_STDIO
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+const int32 SoftwareTileSize = 64;
+
+struct SoftwareRenderState {
+	ImageData texture;  // texture.data == nullptr means plain white texture
+	recti scissor;      // already clipped to framebuffer
+	vec4 flashColor;
+	bool8 depthTest;
+	bool8 depthWrite;
+};
+
+// vertex after projection in framebuffer space
+struct SoftwareVertex {
+	float x;
+	float y;
+	float z;     // depth in [0, 1]
+	float invW;  // 0 if vertex is behind the camera
+	vec4 color;  // divided by w for perspective correct interpolation
+	vec2 texCoords;
+};
+
+struct SoftwareTriangle {
+	// edge functions e(x, y) = a * x + b * y + c, pixel is inside if all three are positive
+	float a[3];
+	float b[3];
+	float c[3];
+	uint32 topLeftMask;  // bit i is set if edge i is a top or left edge (fill rule)
+	float oneOverArea;
+
+	SoftwareVertex vertices[3];
+	recti bounds;  // pixel bounds clipped to scissor
+	int32 state;
+};
+
+// bins are linked lists into binEntries, so that triangles keep their submission order
+struct SoftwareBinEntry {
+	int32 triangle;
+	int32 next;
+};
+struct SoftwareBin {
+	int32 first;
+	int32 last;
+};
+
+// threads that help rasterizing the tiles of a flush, sleep while no flush is in progress
+// only one renderer can flush at a time
+struct SoftwareRasterizer {
+	std::thread threads[MAX_JOB_WORKERS];
+	int32 threadsCount;
+	std::mutex mutex;
+	std::condition_variable condition;
+	struct SoftwareRenderer* renderer;  // renderer of the flush in progress
+	std::atomic< int32 > nextTile;
+	int32 generation;  // incremented by every flush, so that threads join every flush exactly once
+	int32 busyCount;   // threads that didn't finish the current flush yet
+	bool running;
+};
+
+struct SoftwareRenderer {
+	int32 width;
+	int32 height;
+	uint32* color;  // rgba8, first row is the top of the screen
+	float* depth;
+	int32 tilesX;
+	int32 tilesY;
+	SoftwareBin* bins;
+	SoftwareRasterizer* rasterizer;  // nullptr if tiles are rasterized by the flushing thread alone
+
+	UArray< SoftwareTriangle > triangles;
+	UArray< SoftwareBinEntry > binEntries;
+	UArray< SoftwareRenderState > states;
+	UArray< SoftwareVertex > vertices;  // scratch space for transformed vertices of one mesh
+
+	UArray< Mesh >* meshes;         // mesh table of the platform layer, indexed by MeshId - 1
+	UArray< ImageData >* textures;  // texture table of the platform layer, indexed by TextureId - 1
+
+	// current command state
+	ImageData texture;
+	ShaderId shader;
+	ProjectionType projectionType;
+	mat4 defaultProjections[2];
+	mat4 projections[2];
+	recti scissor;
+	bool8 renderStates[valueof( RenderStateType::Count )];
+	bool8 cullFace;
+	bool8 cullFront;
+	bool8 stateDirty;
+
+	float ambientStrength;
+	vec4 lightColor;
+	vec3 lightPosition;
+};
+
+const int32 SoftwareMaxStates   = 1024;
+const int32 SoftwareMaxVertices = 0x10000;
+
+// size of memory needed by makeSoftwareRenderer, including alignment padding
+size_t getSoftwareRendererMemorySize( int32 width, int32 height, int32 maxTriangles )
+{
+	auto tilesCount = ( ( width + SoftwareTileSize - 1 ) / SoftwareTileSize )
+	                  * ( ( height + SoftwareTileSize - 1 ) / SoftwareTileSize );
+	size_t result = (size_t)width * height * ( sizeof( uint32 ) + sizeof( float ) )
+	                + tilesCount * sizeof( SoftwareBin )
+	                + maxTriangles * ( sizeof( SoftwareTriangle ) + 4 * sizeof( SoftwareBinEntry ) )
+	                + SoftwareMaxStates * sizeof( SoftwareRenderState )
+	                + SoftwareMaxVertices * sizeof( SoftwareVertex );
+	return result + 7 * 16;
+}
+
+SoftwareRenderer makeSoftwareRenderer( StackAllocator* allocator, int32 width, int32 height,
+                                       UArray< Mesh >* meshes, UArray< ImageData >* textures,
+                                       int32 maxTriangles, SoftwareRasterizer* rasterizer )
+{
+	assert( isValid( allocator ) );
+	assert( width > 0 && height > 0 );
+	assert( maxTriangles > 0 );
+	assert( meshes );
+	assert( textures );
+
+	SoftwareRenderer result = {};
+	result.width            = width;
+	result.height           = height;
+	result.tilesX           = ( width + SoftwareTileSize - 1 ) / SoftwareTileSize;
+	result.tilesY           = ( height + SoftwareTileSize - 1 ) / SoftwareTileSize;
+	result.rasterizer       = rasterizer;
+	result.meshes           = meshes;
+	result.textures         = textures;
+
+	result.color      = allocateArray( allocator, uint32, width * height );
+	result.depth      = allocateArray( allocator, float, width * height );
+	result.bins       = allocateArray( allocator, SoftwareBin, result.tilesX * result.tilesY );
+	result.triangles  = makeUArray( allocator, SoftwareTriangle, maxTriangles );
+	result.binEntries = makeUArray( allocator, SoftwareBinEntry, maxTriangles * 4 );
+	result.states     = makeUArray( allocator, SoftwareRenderState, SoftwareMaxStates );
+	result.vertices   = makeUArray( allocator, SoftwareVertex, SoftwareMaxVertices );
+	if( !result.color || !result.depth || !result.bins || !result.triangles.capacity()
+	    || !result.binEntries.capacity() || !result.states.capacity()
+	    || !result.vertices.capacity() ) {
+
+		OutOfMemory();
+		return {};
+	}
+
+	// projections can be changed by the game layer, these are only used until the game sets its own
+	auto aspect = (float)width / (float)height;
+	result.defaultProjections[valueof( ProjectionType::Perspective )] =
+	    matrixPerspectiveFovProjection( degreesToRadians( 65 ), aspect, -1, 1 );
+	result.defaultProjections[valueof( ProjectionType::Orthogonal )] =
+	    matrixOrthogonalProjection( 0, 0, (float)width, (float)height, -1, 1 );
+
+	// initial state mirrors the opengl backend
+	result.renderStates[valueof( RenderStateType::DepthTest )]  = true;
+	result.renderStates[valueof( RenderStateType::DepthWrite )] = true;
+	result.renderStates[valueof( RenderStateType::Lighting )]   = true;
+	result.cullFace                                             = true;
+	return result;
+}
+bool isValid( SoftwareRenderer* renderer ) { return renderer && renderer->color; }
+
+static void softwareResetBins( SoftwareRenderer* renderer )
+{
+	renderer->triangles.clear();
+	renderer->binEntries.clear();
+	renderer->states.clear();
+	renderer->stateDirty = true;
+	for( auto i = 0, count = renderer->tilesX * renderer->tilesY; i < count; ++i ) {
+		renderer->bins[i] = {-1, -1};
+	}
+}
+
+// rasterization
+
+static ImagePixel softwareSample( ImageData texture, vec2 texCoords )
+{
+	if( !texture.data ) {
+		return {0xFF, 0xFF, 0xFF, 0xFF};
+	}
+	// nearest filtering with repeat wrapping
+	auto u = texCoords.x - floor( texCoords.x );
+	auto v = texCoords.y - floor( texCoords.y );
+	auto x = min( (int32)( u * texture.width ), texture.width - 1 );
+	auto y = min( (int32)( v * texture.height ), texture.height - 1 );
+	auto p = texture.data + ( x + y * texture.width ) * 4;
+	return {p[0], p[1], p[2], p[3]};
+}
+
+static void softwareShadePixel( SoftwareRenderer* renderer, SoftwareTriangle* triangle,
+                                SoftwareRenderState* state, int32 x, int32 y, float e0, float e1,
+                                float e2 )
+{
+	auto l0 = e0 * triangle->oneOverArea;
+	auto l1 = e1 * triangle->oneOverArea;
+	auto l2 = e2 * triangle->oneOverArea;
+
+	auto v0 = &triangle->vertices[0];
+	auto v1 = &triangle->vertices[1];
+	auto v2 = &triangle->vertices[2];
+
+	auto z = l0 * v0->z + l1 * v1->z + l2 * v2->z;
+	if( z < 0 || z > 1 ) {
+		return;
+	}
+	auto index = x + y * renderer->width;
+	if( state->depthTest && z < renderer->depth[index] ) {
+		return;
+	}
+
+	auto w         = 1 / ( l0 * v0->invW + l1 * v1->invW + l2 * v2->invW );
+	auto texCoords = ( v0->texCoords * l0 + v1->texCoords * l1 + v2->texCoords * l2 ) * w;
+	auto color     = ( v0->color * l0 + v1->color * l1 + v2->color * l2 ) * w;
+
+	auto texel = softwareSample( state->texture, texCoords );
+	vec4 src;
+	src.r = B2F( texel.r ) * color.r;
+	src.g = B2F( texel.g ) * color.g;
+	src.b = B2F( texel.b ) * color.b;
+	src.a = B2F( texel.a ) * color.a;
+
+	auto flash = state->flashColor.a;
+	if( flash > 0 ) {
+		src.r = lerp( flash, src.r, state->flashColor.r );
+		src.g = lerp( flash, src.g, state->flashColor.g );
+		src.b = lerp( flash, src.b, state->flashColor.b );
+	}
+
+	// alpha test
+	if( src.a <= 0 ) {
+		return;
+	}
+
+	// blending with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+	auto dest    = (uint8*)&renderer->color[index];
+	auto srcA    = min( src.a, 1.0f );
+	auto oneMinA = 1 - srcA;
+	auto blend   = [srcA, oneMinA]( float s, uint8 d ) {
+		auto result = clamp( s, 0.0f, 1.0f ) * srcA + B2F( d ) * oneMinA;
+		return (uint8)( result * 255.0f + 0.5f );
+	};
+	dest[0] = blend( src.r, dest[0] );
+	dest[1] = blend( src.g, dest[1] );
+	dest[2] = blend( src.b, dest[2] );
+	dest[3] = blend( src.a, dest[3] );
+
+	if( state->depthWrite ) {
+		renderer->depth[index] = z;
+	}
+}
+
+static void softwareRasterizeTriangle( SoftwareRenderer* renderer, SoftwareTriangle* triangle,
+                                       recti tile )
+{
+	auto state  = &renderer->states[triangle->state];
+	auto bounds = triangle->bounds;
+	auto left   = max( bounds.left, tile.left );
+	auto top    = max( bounds.top, tile.top );
+	auto right  = min( bounds.right, tile.right );
+	auto bottom = min( bounds.bottom, tile.bottom );
+	if( left >= right || top >= bottom ) {
+		return;
+	}
+
+	const __m128 zero      = _mm_setzero_ps();
+	const __m128 laneSteps = _mm_set_ps( 3.5f, 2.5f, 1.5f, 0.5f );
+	__m128 a[3];
+	__m128 topLeft[3];
+	for( auto i = 0; i < 3; ++i ) {
+		a[i] = _mm_set1_ps( triangle->a[i] );
+		// all bits set if edge is top left, since we use this to mask comparisons
+		topLeft[i] = _mm_castsi128_ps(
+		    _mm_set1_epi32( ( triangle->topLeftMask & ( 1u << i ) ) ? ( -1 ) : ( 0 ) ) );
+	}
+
+	for( auto y = top; y < bottom; ++y ) {
+		auto py = (float)y + 0.5f;
+		// edge values at start of row
+		__m128 rowC[3];
+		for( auto i = 0; i < 3; ++i ) {
+			rowC[i] = _mm_set1_ps( triangle->b[i] * py + triangle->c[i] );
+		}
+		for( auto x = left; x < right; x += 4 ) {
+			auto px = _mm_add_ps( _mm_set1_ps( (float)x ), laneSteps );
+			__m128 e[3];
+			auto inside = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+			for( auto i = 0; i < 3; ++i ) {
+				e[i] = _mm_add_ps( _mm_mul_ps( a[i], px ), rowC[i] );
+				// pixel is inside edge if e > 0 or if e == 0 and it is a top left edge
+				auto edgeInside =
+				    _mm_or_ps( _mm_cmpgt_ps( e[i], zero ),
+				               _mm_and_ps( _mm_cmpeq_ps( e[i], zero ), topLeft[i] ) );
+				inside = _mm_and_ps( inside, edgeInside );
+			}
+			auto mask = _mm_movemask_ps( inside );
+			// mask out lanes past the right edge
+			auto lanes = right - x;
+			if( lanes < 4 ) {
+				mask &= ( 1 << lanes ) - 1;
+			}
+			if( !mask ) {
+				continue;
+			}
+
+			alignas( 16 ) float e0[4];
+			alignas( 16 ) float e1[4];
+			alignas( 16 ) float e2[4];
+			_mm_store_ps( e0, e[1] );  // barycentric of vertex 0 comes from edge 1 (v1 -> v2)
+			_mm_store_ps( e1, e[2] );  // barycentric of vertex 1 comes from edge 2 (v2 -> v0)
+			_mm_store_ps( e2, e[0] );  // barycentric of vertex 2 comes from edge 0 (v0 -> v1)
+			for( auto lane = 0; lane < 4; ++lane ) {
+				if( mask & ( 1 << lane ) ) {
+					softwareShadePixel( renderer, triangle, state, x + lane, y, e0[lane], e1[lane],
+					                    e2[lane] );
+				}
+			}
+		}
+	}
+}
+
+static void softwareRasterizeTile( SoftwareRenderer* renderer, int32 tileIndex )
+{
+	auto tileX = tileIndex % renderer->tilesX;
+	auto tileY = tileIndex / renderer->tilesX;
+	recti tile;
+	tile.left   = tileX * SoftwareTileSize;
+	tile.top    = tileY * SoftwareTileSize;
+	tile.right  = min( tile.left + SoftwareTileSize, renderer->width );
+	tile.bottom = min( tile.top + SoftwareTileSize, renderer->height );
+
+	auto entries = renderer->binEntries.data();
+	for( auto entry = renderer->bins[tileIndex].first; entry >= 0; entry = entries[entry].next ) {
+		softwareRasterizeTriangle( renderer, &renderer->triangles[entries[entry].triangle], tile );
+	}
+}
+
+// rasterizes tiles until every tile of the current flush was taken by some thread
+static void softwareRasterizeTiles( SoftwareRenderer* renderer, std::atomic< int32 >* nextTile )
+{
+	auto tilesCount = renderer->tilesX * renderer->tilesY;
+	for( ;; ) {
+		auto tile = nextTile->fetch_add( 1, std::memory_order_relaxed );
+		if( tile >= tilesCount ) {
+			break;
+		}
+		softwareRasterizeTile( renderer, tile );
+	}
+}
+
+static void runSoftwareRasterizer( SoftwareRasterizer* rasterizer )
+{
+	// initSoftwareRasterizer sets the generation to 0 before any thread runs
+	int32 generation = 0;
+	std::unique_lock< std::mutex > lock( rasterizer->mutex );
+	for( ;; ) {
+		rasterizer->condition.wait( lock, [rasterizer, generation]() {
+			return rasterizer->generation != generation || !rasterizer->running;
+		} );
+		if( !rasterizer->running ) {
+			break;
+		}
+		generation    = rasterizer->generation;
+		auto renderer = rasterizer->renderer;
+		lock.unlock();
+		softwareRasterizeTiles( renderer, &rasterizer->nextTile );
+		lock.lock();
+		if( --rasterizer->busyCount == 0 ) {
+			rasterizer->condition.notify_all();
+		}
+	}
+}
+
+// threadsCount is the number of threads that rasterize, including the thread that flushes, so
+// threadsCount - 1 threads are created
+// rasterizer needs to stay at the same address until destroySoftwareRasterizer
+void initSoftwareRasterizer( SoftwareRasterizer* rasterizer, int32 threadsCount )
+{
+	assert( rasterizer );
+	rasterizer->threadsCount = clamp( threadsCount, 1, MAX_JOB_WORKERS ) - 1;
+	rasterizer->renderer     = nullptr;
+	rasterizer->nextTile     = 0;
+	rasterizer->generation   = 0;
+	rasterizer->busyCount    = 0;
+	rasterizer->running      = true;
+	for( auto i = 0; i < rasterizer->threadsCount; ++i ) {
+		rasterizer->threads[i] = std::thread( runSoftwareRasterizer, rasterizer );
+	}
+}
+
+void destroySoftwareRasterizer( SoftwareRasterizer* rasterizer )
+{
+	assert( rasterizer );
+	{
+		std::lock_guard< std::mutex > lock( rasterizer->mutex );
+		rasterizer->running = false;
+		rasterizer->condition.notify_all();
+	}
+	for( auto i = 0; i < rasterizer->threadsCount; ++i ) {
+		rasterizer->threads[i].join();
+	}
+	rasterizer->threadsCount = 0;
+}
+
+// rasterizes all binned triangles and resets the bins
+static void softwareFlush( SoftwareRenderer* renderer )
+{
+	if( renderer->triangles.size() ) {
+		auto rasterizer = renderer->rasterizer;
+		if( rasterizer && rasterizer->threadsCount ) {
+			{
+				std::lock_guard< std::mutex > lock( rasterizer->mutex );
+				rasterizer->renderer  = renderer;
+				rasterizer->nextTile  = 0;
+				rasterizer->busyCount = rasterizer->threadsCount;
+				++rasterizer->generation;
+				rasterizer->condition.notify_all();
+			}
+			softwareRasterizeTiles( renderer, &rasterizer->nextTile );
+			// the threads might still rasterize the last tiles they took
+			std::unique_lock< std::mutex > lock( rasterizer->mutex );
+			rasterizer->condition.wait( lock, [rasterizer]() { return !rasterizer->busyCount; } );
+		} else {
+			std::atomic< int32 > nextTile( 0 );
+			softwareRasterizeTiles( renderer, &nextTile );
+		}
+	}
+	softwareResetBins( renderer );
+}
+
+// triangle setup and binning
+
+static int32 softwareCurrentState( SoftwareRenderer* renderer, vec4 flashColor )
+{
+	auto perspective = renderer->projectionType == ProjectionType::Perspective;
+
+	SoftwareRenderState state = {};
+	state.texture             = renderer->texture;
+	state.flashColor          = flashColor;
+	state.depthTest =
+	    perspective && (bool)renderer->renderStates[valueof( RenderStateType::DepthTest )];
+	state.depthWrite =
+	    state.depthTest && (bool)renderer->renderStates[valueof( RenderStateType::DepthWrite )];
+	state.scissor = {0, 0, renderer->width, renderer->height};
+	if( renderer->renderStates[valueof( RenderStateType::Scissor )] ) {
+		state.scissor.left   = clamp( renderer->scissor.left, 0, renderer->width );
+		state.scissor.top    = clamp( renderer->scissor.top, 0, renderer->height );
+		state.scissor.right  = clamp( renderer->scissor.right, 0, renderer->width );
+		state.scissor.bottom = clamp( renderer->scissor.bottom, 0, renderer->height );
+	}
+
+	if( !renderer->stateDirty && renderer->states.size() ) {
+		auto last = &renderer->states.back();
+		if( last->texture.data == state.texture.data && last->depthTest == state.depthTest
+		    && last->depthWrite == state.depthWrite
+		    && memcmp( &last->scissor, &state.scissor, sizeof( recti ) ) == 0
+		    && memcmp( &last->flashColor, &state.flashColor, sizeof( vec4 ) ) == 0 ) {
+
+			return renderer->states.size() - 1;
+		}
+	}
+	if( !renderer->states.remaining() ) {
+		softwareFlush( renderer );
+	}
+	renderer->stateDirty = false;
+	renderer->states.push_back( state );
+	return renderer->states.size() - 1;
+}
+
+static bool softwareIsTopLeft( SoftwareVertex* from, SoftwareVertex* to )
+{
+	// triangles are clockwise on screen (y down), top edges go right, left edges go up
+	return ( from->y == to->y && to->x > from->x ) || ( to->y < from->y );
+}
+
+// returns the index of state after the triangle was pushed, it changes when the bins were flushed
+static int32 softwarePushTriangle( SoftwareRenderer* renderer, SoftwareVertex* v0,
+                                   SoftwareVertex* v1, SoftwareVertex* v2, bool cull, int32 state )
+{
+	if( v0->invW <= 0 || v1->invW <= 0 || v2->invW <= 0 ) {
+		// no near plane clipping, reject triangles that are partially behind the camera
+		return state;
+	}
+	auto area = ( v1->x - v0->x ) * ( v2->y - v0->y ) - ( v2->x - v0->x ) * ( v1->y - v0->y );
+	if( area == 0 ) {
+		return state;
+	}
+	if( cull && renderer->cullFace ) {
+		// front faces are clockwise in window space which is y up, so they have a positive area
+		// in our framebuffer space which is y down
+		auto front = area > 0;
+		if( front == (bool)renderer->cullFront ) {
+			return state;
+		}
+	}
+	if( area < 0 ) {
+		std::swap( v1, v2 );
+		area = -area;
+	}
+
+	auto states = &renderer->states[state];
+	recti bounds;
+	bounds.left   = max( (int32)floor( min( v0->x, v1->x, v2->x ) ), states->scissor.left );
+	bounds.top    = max( (int32)floor( min( v0->y, v1->y, v2->y ) ), states->scissor.top );
+	bounds.right  = min( (int32)ceil( max( v0->x, v1->x, v2->x ) ) + 1, states->scissor.right );
+	bounds.bottom = min( (int32)ceil( max( v0->y, v1->y, v2->y ) ) + 1, states->scissor.bottom );
+	if( bounds.left >= bounds.right || bounds.top >= bounds.bottom ) {
+		return state;
+	}
+
+	auto tileLeft   = bounds.left / SoftwareTileSize;
+	auto tileTop    = bounds.top / SoftwareTileSize;
+	auto tileRight  = ( bounds.right - 1 ) / SoftwareTileSize;
+	auto tileBottom = ( bounds.bottom - 1 ) / SoftwareTileSize;
+	auto binsCount  = ( tileRight - tileLeft + 1 ) * ( tileBottom - tileTop + 1 );
+	if( !renderer->triangles.remaining() || renderer->binEntries.remaining() < binsCount ) {
+		// flushing invalidates state indices, so we need to push the state again
+		auto current = renderer->states[state];
+		softwareFlush( renderer );
+		renderer->states.push_back( current );
+		renderer->stateDirty = false;
+		state                = 0;
+		if( renderer->binEntries.remaining() < binsCount ) {
+			LOG( ERROR, "Triangle covers more tiles than there are bin entries" );
+			return state;
+		}
+	}
+
+	auto triangleIndex    = renderer->triangles.size();
+	auto triangle         = renderer->triangles.emplace_back();
+	triangle->vertices[0] = *v0;
+	triangle->vertices[1] = *v1;
+	triangle->vertices[2] = *v2;
+	triangle->bounds      = bounds;
+	triangle->state       = state;
+	triangle->oneOverArea = 1 / area;
+	triangle->topLeftMask = 0;
+	SoftwareVertex* edges[3][2] = {{v0, v1}, {v1, v2}, {v2, v0}};
+	for( auto i = 0; i < 3; ++i ) {
+		auto from       = edges[i][0];
+		auto to         = edges[i][1];
+		triangle->a[i] = -( to->y - from->y );
+		triangle->b[i] = to->x - from->x;
+		triangle->c[i] = -triangle->a[i] * from->x - triangle->b[i] * from->y;
+		if( softwareIsTopLeft( from, to ) ) {
+			triangle->topLeftMask |= 1u << i;
+		}
+	}
+
+	for( auto y = tileTop; y <= tileBottom; ++y ) {
+		for( auto x = tileLeft; x <= tileRight; ++x ) {
+			auto bin        = &renderer->bins[x + y * renderer->tilesX];
+			auto entryIndex = renderer->binEntries.size();
+			renderer->binEntries.push_back( {triangleIndex, -1} );
+			if( bin->last >= 0 ) {
+				renderer->binEntries[bin->last].next = entryIndex;
+			} else {
+				bin->first = entryIndex;
+			}
+			bin->last = entryIndex;
+		}
+	}
+	return state;
+}
+
+// lines are rasterized as screen aligned quads that are one pixel wide
+// returns the index of state after the line was pushed, see softwarePushTriangle
+static int32 softwarePushLine( SoftwareRenderer* renderer, SoftwareVertex* start,
+                               SoftwareVertex* end, int32 state )
+{
+	auto dx  = end->x - start->x;
+	auto dy  = end->y - start->y;
+	auto len = sqrt( dx * dx + dy * dy );
+	if( len <= 0 ) {
+		return state;
+	}
+	auto nx = -dy / len * 0.5f;
+	auto ny = dx / len * 0.5f;
+
+	SoftwareVertex quad[4] = {*start, *start, *end, *end};
+	quad[0].x += nx;
+	quad[0].y += ny;
+	quad[1].x -= nx;
+	quad[1].y -= ny;
+	quad[2].x -= nx;
+	quad[2].y -= ny;
+	quad[3].x += nx;
+	quad[3].y += ny;
+	state = softwarePushTriangle( renderer, &quad[0], &quad[1], &quad[2], false, state );
+	return softwarePushTriangle( renderer, &quad[0], &quad[2], &quad[3], false, state );
+}
+
+static SoftwareVertex softwareTransformVertex( SoftwareRenderer* renderer, Vertex* vertex,
+                                              mat4arg worldViewProj, mat4arg model, bool lighting,
+                                              float screenDepthOffset )
+{
+	SoftwareVertex result = {};
+	auto clip             = transformVector4( worldViewProj, vertex->position );
+	clip.z -= screenDepthOffset;
+	if( clip.w <= 0 ) {
+		return result;
+	}
+
+	auto color = getColorF( vertex->color );
+	if( lighting ) {
+		// same as the ingame fragment shader, but evaluated per vertex
+		auto position = transformVector3( model, vertex->position );
+		auto normal   = unpackNormal( vertex->normal );
+		vec3 transformedNormal;
+		transformedNormal.x =
+		    model.m[0] * normal.x + model.m[4] * normal.y + model.m[8] * normal.z;
+		transformedNormal.y =
+		    model.m[1] * normal.x + model.m[5] * normal.y + model.m[9] * normal.z;
+		transformedNormal.z =
+		    model.m[2] * normal.x + model.m[6] * normal.y + model.m[10] * normal.z;
+		auto lightDir = normalize( renderer->lightPosition - position );
+		auto diff     = max( dot( transformedNormal, lightDir ), 0.0f );
+		color.r *= clamp( diff * renderer->lightColor.r + renderer->ambientStrength, 0.0f, 1.0f );
+		color.g *= clamp( diff * renderer->lightColor.g + renderer->ambientStrength, 0.0f, 1.0f );
+		color.b *= clamp( diff * renderer->lightColor.b + renderer->ambientStrength, 0.0f, 1.0f );
+	}
+
+	auto invW        = 1 / clip.w;
+	result.x         = ( clip.x * invW * 0.5f + 0.5f ) * renderer->width;
+	result.y         = ( 0.5f - clip.y * invW * 0.5f ) * renderer->height;
+	result.z         = clip.z * invW * 0.5f + 0.5f;
+	result.invW      = invW;
+	result.color     = color * invW;
+	result.texCoords = vertex->texCoords * invW;
+	return result;
+}
+
+static void softwareDrawMesh( SoftwareRenderer* renderer, Mesh* mesh, mat4arg worldViewProj,
+                              mat4arg model, float screenDepthOffset, Color flashColor, bool lines )
+{
+	if( mesh->verticesCount > renderer->vertices.capacity() ) {
+		LOG( ERROR, "Mesh vertices count is bigger than vertex buffer capacity" );
+		return;
+	}
+	auto perspective = renderer->projectionType == ProjectionType::Perspective;
+	auto lighting    = perspective && !renderer->shader
+	                && (bool)renderer->renderStates[valueof( RenderStateType::Lighting )];
+
+	// the lighting shader does not support flash colors
+	auto flash = ( lighting ) ? ( vec4{} ) : ( getColorF( flashColor ) );
+	auto state = softwareCurrentState( renderer, flash );
+
+	auto vertices = renderer->vertices.data();
+	for( auto i = 0; i < mesh->verticesCount; ++i ) {
+		vertices[i] = softwareTransformVertex( renderer, &mesh->vertices[i], worldViewProj, model,
+		                                       lighting, screenDepthOffset );
+	}
+
+	auto indices = mesh->indices;
+	if( lines ) {
+		// line strips with primitive restart
+		for( auto i = 1; i < mesh->indicesCount; ++i ) {
+			auto prev = indices[i - 1];
+			auto next = indices[i];
+			if( prev == MeshPrimitiveRestart || next == MeshPrimitiveRestart ) {
+				continue;
+			}
+			state = softwarePushLine( renderer, &vertices[prev], &vertices[next], state );
+		}
+	} else {
+		for( auto i = 0; i + 2 < mesh->indicesCount; i += 3 ) {
+			auto v0 = &vertices[indices[i]];
+			auto v1 = &vertices[indices[i + 1]];
+			auto v2 = &vertices[indices[i + 2]];
+			state   = softwarePushTriangle( renderer, v0, v1, v2, true, state );
+		}
+	}
+}
+
+static void softwareSetRenderState( SoftwareRenderer* renderer, RenderStateType type,
+                                    bool enabled )
+{
+	assert( valueof( type ) >= 0 && valueof( type ) < valueof( RenderStateType::Count ) );
+	if( renderer->renderStates[valueof( type )] != enabled ) {
+		renderer->renderStates[valueof( type )] = enabled;
+		switch( type ) {
+			case RenderStateType::BackFaceCulling: {
+				renderer->cullFace = enabled;
+				break;
+			}
+			case RenderStateType::CullFrontFace: {
+				renderer->cullFront = enabled;
+				break;
+			}
+			default: {
+				break;
+			}
+		}
+	}
+}
+
+void processRenderCommandsSoftware( SoftwareRenderer* renderer, RenderCommands* renderCommands )
+{
+	assert( isValid( renderer ) );
+	assert( isValid( renderCommands ) );
+
+	// clear, depth is cleared to 0 since depth test is GL_GEQUAL
+	{
+		auto c      = renderCommands->clearColor;
+		uint8 rgba[4] = {(uint8)getRed( c ), (uint8)getGreen( c ), (uint8)getBlue( c ),
+		                 (uint8)getAlpha( c )};
+		uint32 clearColor;
+		memcpy( &clearColor, rgba, sizeof( uint32 ) );
+		auto count = renderer->width * renderer->height;
+		fill( renderer->color, clearColor, count );
+		fill( renderer->depth, 0.0f, count );
+	}
+
+	softwareResetBins( renderer );
+	renderer->texture         = {};  // textures might have been deleted since last frame
+	renderer->shader          = {};
+	renderer->ambientStrength = renderCommands->ambientStrength;
+	renderer->lightColor      = getColorF( renderCommands->lightColor );
+	renderer->lightPosition   = renderCommands->lightPosition;
+	renderer->projections[0]  = renderCommands->view * renderer->defaultProjections[0];
+	renderer->projections[1]  = renderer->defaultProjections[1];
+
+	auto identity = matrixIdentity();
+	auto stream   = getRenderCommandsStream( renderCommands );
+	while( stream.size ) {
+		auto header = getRenderCommandsHeader( &stream );
+		switch( header->type ) {
+			case RenderCommandEntryType::Mesh: {
+				auto body = getRenderCommandMesh( &stream, header );
+				softwareDrawMesh( renderer, &body->mesh,
+				                  renderer->projections[valueof( renderer->projectionType )],
+				                  identity, 0, {}, false );
+				break;
+			}
+			case RenderCommandEntryType::LineMesh: {
+				auto body = getRenderCommandLineMesh( &stream, header );
+				softwareDrawMesh( renderer, &body->mesh,
+				                  renderer->projections[valueof( renderer->projectionType )],
+				                  identity, 0, {}, true );
+				break;
+			}
+			case RenderCommandEntryType::StaticMesh: {
+				auto body = getRenderCommandBody( &stream, header, RenderCommandStaticMesh );
+				if( body->meshId ) {
+					auto mesh = &( *renderer->meshes )[body->meshId.id - 1];
+					assert( mesh->verticesCount > 0 );
+					auto& current = renderer->projections[valueof( renderer->projectionType )];
+					auto matrix   = body->matrix * current;
+					softwareDrawMesh( renderer, mesh, matrix, body->matrix,
+					                  body->screenDepthOffset, body->flashColor, false );
+				}
+				break;
+			}
+			case RenderCommandEntryType::SetTexture: {
+				auto body = getRenderCommandBody( &stream, header, RenderCommandSetTexture );
+				assert( body->stage >= 0 && body->stage < 2 );
+				// only the first stage is sampled by the shaders
+				if( body->stage == 0 ) {
+					renderer->texture = {};
+					auto index        = body->id.id - 1;
+					if( index >= 0 && index < renderer->textures->size() ) {
+						renderer->texture = ( *renderer->textures )[index];
+					}
+				}
+				break;
+			}
+			case RenderCommandEntryType::SetShader: {
+				auto body        = getRenderCommandBody( &stream, header, RenderCommandSetShader );
+				renderer->shader = body->id;
+				break;
+			}
+			case RenderCommandEntryType::SetProjection: {
+				auto body = getRenderCommandBody( &stream, header, RenderCommandSetProjection );
+				assert( valueof( body->projectionType ) >= 0
+				        && valueof( body->projectionType ) < 2 );
+				renderer->projectionType = body->projectionType;
+				break;
+			}
+			case RenderCommandEntryType::SetProjectionMatrix: {
+				auto body =
+				    getRenderCommandBody( &stream, header, RenderCommandSetProjectionMatrix );
+				switch( body->projectionType ) {
+					case ProjectionType::Perspective: {
+						renderer->projections[0] = renderCommands->view * body->matrix;
+						break;
+					}
+					case ProjectionType::Orthogonal: {
+						renderer->projections[1] = body->matrix;
+						break;
+					}
+					InvalidDefaultCase;
+				}
+				break;
+			}
+			case RenderCommandEntryType::SetScissorRect: {
+				auto body = getRenderCommandBody( &stream, header, RenderCommandSetScissorRect );
+				renderer->scissor = body->scissor;
+				break;
+			}
+			case RenderCommandEntryType::SetRenderState: {
+				auto body = getRenderCommandBody( &stream, header, RenderCommandSetRenderState );
+				softwareSetRenderState( renderer, body->renderStateType, body->enabled );
+				break;
+			}
+			case RenderCommandEntryType::Jump: {
+				auto body  = getRenderCommandBody( &stream, header, RenderCommandJump );
+				stream.ptr = body->jumpDestination;
+				break;
+			}
+			InvalidDefaultCase;
+		}
+	}
+
+	softwareFlush( renderer );
+}
+
+// output
+
+bool writeSoftwareFramebuffer( SoftwareRenderer* renderer, const char* filename )
+{
+	assert( isValid( renderer ) );
+	auto file = fopen( filename, "wb" );
+	if( !file ) {
+		return false;
+	}
+	struct FileWriter {
+		FILE* file;
+		bool success;
+	};
+	FileWriter writer       = {file, true};
+	auto fileWriterCallback = []( void* context, void* data, int size ) {
+		auto writer = (FileWriter*)context;
+		if( fwrite( data, 1, size, writer->file ) != (size_t)size ) {
+			writer->success = false;
+		}
+	};
+	if( !stbi_write_png_to_func( fileWriterCallback, &writer, renderer->width, renderer->height, 4,
+	                             renderer->color, renderer->width * 4 ) ) {
+		writer.success = false;
+	}
+	if( fclose( file ) != 0 ) {
+		writer.success = false;
+	}
+	return writer.success;
+}
+
+struct SoftwareImageDifference {
+	int32 differentPixels;  // pixels where any channel differs by more than the tolerance
+	int32 maxDifference;    // biggest difference of any channel
+	bool sizeMismatch;
+};
+SoftwareImageDifference compareSoftwareFramebuffer( SoftwareRenderer* renderer, ImageData golden,
+                                                    int32 tolerance )
+{
+	assert( isValid( renderer ) );
+	SoftwareImageDifference result = {};
+	if( golden.width != renderer->width || golden.height != renderer->height ) {
+		result.sizeMismatch = true;
+		return result;
+	}
+	auto a = (const uint8*)renderer->color;
+	auto b = golden.data;
+	for( auto i = 0, count = renderer->width * renderer->height; i < count; ++i, a += 4, b += 4 ) {
+		auto pixelDifference = 0;
+		for( auto c = 0; c < 4; ++c ) {
+			pixelDifference = max( pixelDifference, abs( (int32)a[c] - (int32)b[c] ) );
+		}
+		if( pixelDifference > tolerance ) {
+			++result.differentPixels;
+		}
+		result.maxDifference = max( result.maxDifference, pixelDifference );
+	}
+	return result;
+}
@@ -0,0 +1,210 @@
+// timing distributions for benchmarking, samples are kept so that percentiles can be calculated
+// samples are stored in arbitrary units (ms or cpu ticks), scale is applied when printing
+
+struct TimingSamples {
+	float* samples;
+	int32 count;
+	int32 capacity;
+};
+TimingSamples makeTimingSamples( StackAllocator* allocator, int32 capacity )
+{
+	TimingSamples result = {};
+	result.samples       = allocateArray( allocator, float, capacity );
+	if( result.samples ) {
+		result.capacity = capacity;
+	}
+	return result;
+}
+void push( TimingSamples* timings, float value )
+{
+	if( timings->count < timings->capacity ) {
+		timings->samples[timings->count++] = value;
+	}
+}
+
+struct TimingPercentiles {
+	float p50;
+	float p95;
+	float p99;
+	float max;
+	float average;
+	int32 count;
+};
+// sorts samples in place
+TimingPercentiles getTimingPercentiles( TimingSamples* timings )
+{
+	TimingPercentiles result = {};
+	if( !timings->count ) {
+		return result;
+	}
+	auto first = timings->samples;
+	auto last  = timings->samples + timings->count;
+	sort( first, last );
+
+	// nearest rank method
+	auto percentile = [timings]( int32 p ) {
+		auto rank = ( p * timings->count + 99 ) / 100;
+		return timings->samples[clamp( rank - 1, 0, timings->count - 1 )];
+	};
+	double sum = 0;
+	for( auto it = first; it != last; ++it ) {
+		sum += *it;
+	}
+	result.p50     = percentile( 50 );
+	result.p95     = percentile( 95 );
+	result.p99     = percentile( 99 );
+	result.max     = *( last - 1 );
+	result.average = (float)( sum / timings->count );
+	result.count   = timings->count;
+	return result;
+}
+
+void printTimingPercentiles( FILE* out, const char* name, TimingPercentiles* percentiles,
+                             double scale = 1 )
+{
+	fprintf( out, "%-24s avg %8.3fms p50 %8.3fms p95 %8.3fms p99 %8.3fms max %8.3fms (%d)\n", name,
+	         percentiles->average * scale, percentiles->p50 * scale, percentiles->p95 * scale,
+	         percentiles->p99 * scale, percentiles->max * scale, percentiles->count );
+}
+
+// per PROFILE_FUNCTION timings, collected from the ProfilingTable of the game after each frame
+
+struct ProfilingBlockTimings {
+	const char* file;
+	const char* block;
+	TimingSamples samples;  // in cpu ticks, one sample per frame the block ran in
+#ifdef GAME_PROFILING_COUNTERS
+	uint64 counters[ProfilingCounter_Count];  // summed over all frames the block ran in
+#endif
+};
+struct ProfilingTimings {
+	StackAllocator* allocator;
+	int32 capacity;  // max samples per block
+	ProfilingBlockTimings* blocks[MAX_PROFILING_INFOS];
+	int32 depths[MAX_PROFILING_INFOS];
+	uint64 beginTimestamps[MAX_PROFILING_INFOS];
+	uint64 frameTicks[MAX_PROFILING_INFOS];
+#ifdef GAME_PROFILING_COUNTERS
+	uint64 beginCounters[MAX_PROFILING_INFOS][ProfilingCounter_Count];
+	uint64 frameCounters[MAX_PROFILING_INFOS][ProfilingCounter_Count];
+#endif
+};
+void initProfilingTimings( ProfilingTimings* timings, StackAllocator* allocator,
+                           int32 samplesCapacity )
+{
+	*timings           = {};
+	timings->allocator = allocator;
+	timings->capacity  = samplesCapacity;
+}
+
+// scrap is used to capture the events of the last frame, it is reset before returning
+void collectProfilingTimings( ProfilingTimings* timings, StackAllocator* scrap,
+                              ProfilingTable* table )
+{
+	assert( timings );
+	assert( isValid( scrap ) );
+	if( !table ) {
+		return;
+	}
+
+	TEMPORARY_MEMORY_BLOCK( scrap ) {
+		auto capture = captureProfilingFrames( scrap, table, 1 );
+		FOR( thread : capture.threads ) {
+			// ticks of blocks that ran on multiple threads are summed up
+			fill( timings->depths, 0, MAX_PROFILING_INFOS );
+			FOR( event : thread.events ) {
+				auto index = event.infoIndex;
+				assert( index < MAX_PROFILING_INFOS );
+				switch( event.type ) {
+					case ProfilingEvent::Begin: {
+						// only the outermost block is measured for recursive functions
+						if( timings->depths[index]++ == 0 ) {
+							timings->beginTimestamps[index] = event.timestamp;
+#ifdef GAME_PROFILING_COUNTERS
+							memcpy( timings->beginCounters[index], event.counters,
+							        sizeof( event.counters ) );
+#endif
+						}
+						break;
+					}
+					case ProfilingEvent::End: {
+						// blocks that began before the frame have no begin event
+						if( timings->depths[index] > 0 && --timings->depths[index] == 0 ) {
+							timings->frameTicks[index] +=
+							    event.timestamp - timings->beginTimestamps[index];
+#ifdef GAME_PROFILING_COUNTERS
+							for( auto j = 0; j < ProfilingCounter_Count; ++j ) {
+								auto first = timings->beginCounters[index][j];
+								if( event.counters[j] > first ) {
+									timings->frameCounters[index][j] += event.counters[j] - first;
+								}
+							}
+#endif
+						}
+						break;
+					}
+					case ProfilingEvent::FrameMarker: {
+						break;
+					}
+						InvalidDefaultCase;
+				}
+			}
+		}
+	}
+
+	auto infosCount = table->infosCount.load( std::memory_order_acquire );
+	for( int32 i = 0; i < MAX_PROFILING_INFOS; ++i ) {
+		if( !timings->frameTicks[i] ) {
+			continue;
+		}
+		auto block = timings->blocks[i];
+		if( !block && i < infosCount ) {
+			// infos are only registered once per process, so we keep the names around, info strings
+			// are string literals that live as long as the game dll is loaded
+			block = allocateStruct( timings->allocator, ProfilingBlockTimings );
+			if( block ) {
+				*block         = {};
+				block->file    = table->infos[i].file;
+				block->block   = table->infos[i].block;
+				block->samples = makeTimingSamples( timings->allocator, timings->capacity );
+			}
+			timings->blocks[i] = block;
+		}
+		if( block ) {
+			push( &block->samples, (float)timings->frameTicks[i] );
+#ifdef GAME_PROFILING_COUNTERS
+			for( auto j = 0; j < ProfilingCounter_Count; ++j ) {
+				block->counters[j] += timings->frameCounters[i][j];
+			}
+#endif
+		}
+		timings->frameTicks[i] = 0;
+#ifdef GAME_PROFILING_COUNTERS
+		fill( timings->frameCounters[i], (uint64)0, ProfilingCounter_Count );
+#endif
+	}
+}
+
+void printProfilingTimings( FILE* out, ProfilingTimings* timings, double msPerTick )
+{
+	for( int32 i = 0; i < MAX_PROFILING_INFOS; ++i ) {
+		if( auto block = timings->blocks[i] ) {
+			auto percentiles = getTimingPercentiles( &block->samples );
+			printTimingPercentiles( out, block->block, &percentiles, msPerTick );
+#ifdef GAME_PROFILING_COUNTERS
+			// counters are all zero if perf events couldn't be opened, only ticks are printed then
+			auto instructions = block->counters[ProfilingCounter_Instructions];
+			if( instructions && block->samples.count ) {
+				double ticks = percentiles.average * (double)percentiles.count;
+				fprintf( out,
+				         "%-24s %12.0f instr/frame %6.3f instr/tick %8.3f cache misses/kinstr "
+				         "%8.3f branch misses/kinstr\n",
+				         "", (double)instructions / block->samples.count,
+				         ( ticks > 0 ) ? ( instructions / ticks ) : ( 0.0 ),
+				         block->counters[ProfilingCounter_CacheMisses] * 1000.0 / instructions,
+				         block->counters[ProfilingCounter_BranchMisses] * 1000.0 / instructions );
+			}
+#endif
+		}
+	}
+}
@@ -0,0 +1,139 @@
+enum class ReadWholeFileErrorType {
+	Ok,
+	FileNotFound,
+	IOError,
+	FileTooBig
+};
+struct FileContents {
+	char* data;
+	size_t size;
+	ReadWholeFileErrorType error;
+
+	inline explicit operator bool() const { return error == ReadWholeFileErrorType::Ok; }
+};
+
+// StringView is not nullterminated, so we need to copy it before passing it to fopen
+static FILE* linuxOpenFile( StringView filename, const char* mode )
+{
+	char buffer[PATH_MAX];
+	if( filename.size() >= countof( buffer ) ) {
+		return nullptr;
+	}
+	memcpy( buffer, filename.data(), filename.size() );
+	buffer[filename.size()] = 0;
+	return fopen( buffer, mode );
+}
+
+// returns file size or -1 on error
+static int64 linuxGetFileSize( FILE* file )
+{
+	struct stat fileStat;
+	if( fstat( fileno( file ), &fileStat ) != 0 ) {
+		return -1;
+	}
+	return (int64)fileStat.st_size;
+}
+
+FileContents linuxReadWholeFile( StringView filename, char* buffer, size_t bufferSize )
+{
+	FileContents result = {};
+	auto file           = linuxOpenFile( filename, "rb" );
+	if( !file ) {
+		LOG( ERROR, "Failed to open file: {}", filename );
+		result.error = ReadWholeFileErrorType::FileNotFound;
+	} else {
+		auto size = linuxGetFileSize( file );
+		if( size < 0 ) {
+			LOG( ERROR, "Unknown IO error: {}", filename );
+			result.error = ReadWholeFileErrorType::IOError;
+		} else if( size > UINT32_MAX || (size_t)size > bufferSize ) {
+			LOG( ERROR, "File too big: {}", filename );
+			result.error = ReadWholeFileErrorType::FileTooBig;
+		} else {
+			auto bytesToRead = (size_t)size;
+			auto bytesRead   = fread( buffer, 1, bytesToRead, file );
+			if( bytesRead != bytesToRead ) {
+				LOG( ERROR, "Unknown IO error: {}", filename );
+				result.error = ReadWholeFileErrorType::IOError;
+			} else {
+				result.data = buffer;
+				result.size = bytesToRead;
+			}
+		}
+		fclose( file );
+	}
+	return result;
+}
+
+struct AllocatedFileContents {
+	char* data                   = nullptr;
+	size_t size                  = 0;
+	ReadWholeFileErrorType error = ReadWholeFileErrorType::Ok;
+
+	void allocate( size_t size )
+	{
+		data       = new char[size];
+		this->size = size;
+	}
+	void destroy()
+	{
+		delete[] data;
+		data = nullptr;
+		size = 0;
+	}
+	AllocatedFileContents() = default;
+	AllocatedFileContents( AllocatedFileContents&& other ) : data( other.data ), size( other.size )
+	{
+		other.data = nullptr;
+	}
+	~AllocatedFileContents() { destroy(); }
+	inline explicit operator bool() const { return error == ReadWholeFileErrorType::Ok; }
+	operator StringView() const { return {data, safe_truncate< int32 >( size )}; }
+};
+AllocatedFileContents linuxReadWholeFileInternal( StringView filename )
+{
+	AllocatedFileContents result = {};
+	auto file                    = linuxOpenFile( filename, "rb" );
+	if( !file ) {
+		LOG( ERROR, "Failed to open file: {}", filename );
+		result.error = ReadWholeFileErrorType::FileNotFound;
+	} else {
+		auto size = linuxGetFileSize( file );
+		if( size < 0 ) {
+			LOG( ERROR, "Unknown IO error: {}", filename );
+			result.error = ReadWholeFileErrorType::IOError;
+		} else if( size > UINT32_MAX ) {
+			LOG( ERROR, "File too big: {}", filename );
+			result.error = ReadWholeFileErrorType::FileTooBig;
+		} else {
+			auto bytesToRead = (size_t)size;
+			result.allocate( bytesToRead );
+			auto bytesRead = fread( result.data, 1, bytesToRead, file );
+			if( bytesRead != bytesToRead ) {
+				LOG( ERROR, "Unknown IO error: {}", filename );
+				result.error = ReadWholeFileErrorType::IOError;
+				result.destroy();
+			}
+		}
+		fclose( file );
+	}
+	return result;
+}
+size_t linuxReadFileToBuffer( StringView filename, void* buffer, size_t bufferSize )
+{
+	auto result = linuxReadWholeFile( filename, (char*)buffer, bufferSize );
+	return result.size;
+}
+
+void linuxWriteBufferToFile( StringView filename, void* buffer, size_t bufferSize )
+{
+	auto file = linuxOpenFile( filename, "wb" );
+	if( !file ) {
+		LOG( ERROR, "Failed to create file: {}", filename );
+	} else {
+		if( fwrite( buffer, 1, bufferSize, file ) != bufferSize ) {
+			LOG( ERROR, "Failed to write to file: {}", filename );
+		}
+		fclose( file );
+	}
+}
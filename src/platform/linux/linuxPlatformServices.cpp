@@ -0,0 +1,374 @@
+double linuxPerformanceCounter()
+{
+	timespec counter;
+	clock_gettime( CLOCK_MONOTONIC, &counter );
+	return (double)counter.tv_sec * 1000.0 + (double)counter.tv_nsec / 1000000.0;
+}
+
+// rate of rdtsc, measured once against the monotonic clock
+double linuxGetMicrosecondsPerTick()
+{
+	static double result = []() {
+		auto startTime  = linuxPerformanceCounter();
+		auto startTicks = __rdtsc();
+		while( linuxPerformanceCounter() - startTime < 10 ) {
+		}
+		auto ticks = __rdtsc() - startTicks;
+		return ( linuxPerformanceCounter() - startTime ) * 1000.0 / (double)ticks;
+	}();
+	return result;
+}
+
+int32 linuxGetTimeStampString( char* buffer, int32 size )
+{
+	// elapsed ticks since start
+	static double first = linuxPerformanceCounter();
+	auto ret = snprintf( buffer, size, "%.05ld", (long)( linuxPerformanceCounter() - first ) );
+	if( ret >= size ) {
+		buffer[size - 1] = 0;
+	}
+	return ret;
+}
+
+// textures and meshes are read by the render thread, the frame in flight needs to be drawn before
+// they change
+static void linuxWaitForRenderFrame()
+{
+	if( LinuxAppContext.renderPipeline ) {
+		waitForRenderFrame( LinuxAppContext.renderPipeline );
+	}
+}
+
+// textures
+// there is no gpu to upload to, textures are kept in a texture table in cpu memory so that the
+// software renderer can sample them, the ids are indices into that table
+
+static TextureId linuxAddTexture( ImageData image )
+{
+	linuxWaitForRenderFrame();
+	TextureId result = {};
+	auto textures    = &LinuxAppContext.textures;
+
+	ImageData* dest = nullptr;
+	if( textures->remaining() ) {
+		dest = textures->emplace_back();
+	} else {
+		dest = find_first_where( *textures, !entry.data );
+	}
+	if( dest ) {
+		*dest     = image;
+		result.id = indexof( *textures, *dest ) + 1;
+	} else {
+		LOG( ERROR, "Texture table is full" );
+	}
+	return result;
+}
+
+TextureId linuxLoadTextureFromImage( StringView filename, ImageData image )
+{
+	TextureId result = {};
+	assert( GlobalTextureMap );
+	if( auto chached = getTextureInfo( filename ) ) {
+		// the same texture was requested more than once
+		freeImageData( &image );
+		result = chached->id;
+	} else {
+		bool freeImage = true;
+		if( image ) {
+			LOG( INFORMATION, "loaded texture {}", filename );
+			if( GlobalTextureMap->entries.remaining() ) {
+				result = linuxAddTexture( image );
+			} else {
+				LOG( ERROR, "TextureMap is full" );
+			}
+			if( result ) {
+				// the image is shared between the texture table and the TextureMap entry
+				auto entry    = GlobalTextureMap->entries.emplace_back();
+				entry->id     = result;
+				entry->width  = (float)image.width;
+				entry->height = (float)image.height;
+				auto buffer   = new char[filename.size()];
+				memcpy( buffer, filename.data(), filename.size() );
+				entry->filename = {buffer, filename.size()};
+				entry->image    = image;
+				freeImage       = false;
+			}
+		}
+		if( freeImage ) {
+			freeImageData( &image );
+		}
+	}
+	return result;
+}
+TextureId linuxLoadTexture( StringView filename )
+{
+	assert( GlobalTextureMap );
+	if( auto chached = getTextureInfo( filename ) ) {
+		LOG( INFORMATION, "loaded chached texture {}", filename );
+		return chached->id;
+	}
+	return linuxLoadTextureFromImage( filename, loadImageToMemory( filename ) );
+}
+TextureId linuxLoadTextureFromMemory( ImageData image )
+{
+	TextureId result = {};
+	if( image ) {
+		// the caller owns image, so we need our own copy
+		// allocated with malloc, so that every texture in the table can be freed with freeImageData
+		auto size      = (size_t)image.width * image.height * 4;
+		ImageData copy = {(uint8*)malloc( size ), image.width, image.height};
+		memcpy( copy.data, image.data, size );
+		result = linuxAddTexture( copy );
+		if( result ) {
+			LOG( INFORMATION, "loaded texture from memory" );
+		} else {
+			freeImageData( &copy );
+		}
+	} else {
+		LOG( ERROR, "failed to load texture from memory" );
+	}
+	return result;
+}
+void linuxDeleteTexture( TextureId id )
+{
+	if( !id ) {
+		return;
+	}
+	linuxWaitForRenderFrame();
+	// textures loaded from memory have no TextureMap entry
+	if( auto info = find_first_where( GlobalTextureMap->entries, entry.id == id ) ) {
+		delete[] info->filename.data();
+		deleteTextureInfo( id );
+	}
+	// image data is shared with the TextureMap entry, so we only free it here
+	auto texture = &LinuxAppContext.textures[id.id - 1];
+	freeImageData( texture );
+	*texture = {};
+}
+
+// fonts
+// there is no font rasterizer available, so we generate a font info where every codepoint maps to
+// the default glyph, this way text layout still does the same amount of work
+Font linuxLoadFont( StackAllocator* allocator, StringView utf8Name, int32 size, int32 weight,
+                    bool italic, FontUnicodeRequestRanges ranges )
+{
+	Font result          = {};
+	result.renderOptions = defaultFontRenderOptions();
+
+	assert( isValid( allocator ) );
+	result.normal = allocateStruct( allocator, FontInfo );
+	if( result.normal ) {
+		*result.normal                      = {};
+		result.normal->baseline             = (float)size;
+		result.normal->newLineAdvance       = (float)size;
+		result.normal->averageCharWidth     = (float)size * 0.5f;
+		result.normal->defaultGlyph.advance = (float)size * 0.5f;
+		result.normal->defaultGlyph.ascend  = (float)size;
+	} else {
+		result = {};
+	}
+	return result;
+}
+
+// meshes
+// meshes are copied into cpu memory, so that the software renderer can draw them
+
+MeshId linuxUploadMesh( Mesh mesh )
+{
+	linuxWaitForRenderFrame();
+	MeshId result = {};
+	auto meshes   = &LinuxAppContext.meshes;
+
+	Mesh* dest = nullptr;
+	if( meshes->remaining() ) {
+		dest = meshes->emplace_back();
+	} else {
+		dest = find_first_where( *meshes, entry.verticesCount < 0 );
+	}
+	if( dest ) {
+		++LinuxAppContext.info->uploadedMeshes;
+		result.id           = indexof( *meshes, *dest ) + 1;
+		dest->vertices      = new Vertex[mesh.verticesCount];
+		dest->indices       = new uint16[mesh.indicesCount];
+		dest->verticesCount = mesh.verticesCount;
+		dest->indicesCount  = mesh.indicesCount;
+		memcpy( dest->vertices, mesh.vertices, mesh.verticesCount * sizeof( Vertex ) );
+		memcpy( dest->indices, mesh.indices, mesh.indicesCount * sizeof( uint16 ) );
+	} else {
+		LOG( ERROR, "Mesh table is full" );
+	}
+	return result;
+}
+void linuxDeleteMesh( MeshId id )
+{
+	if( id ) {
+		linuxWaitForRenderFrame();
+		auto mesh = &LinuxAppContext.meshes[id.id - 1];
+		delete[] mesh->vertices;
+		delete[] mesh->indices;
+		*mesh               = {};
+		mesh->verticesCount = -1;
+		mesh->indicesCount  = -1;
+		--LinuxAppContext.info->uploadedMeshes;
+	}
+}
+
+// shaders
+
+ShaderId linuxLoadShader( StringView vertexShader, StringView fragmentShader )
+{
+	return {++LinuxAppContext.shadersCount};
+}
+void linuxDeleteShader( ShaderId id ) {}
+
+// get open/save filename
+// there are no dialogs in a headless environment, behave like the user cancelled
+
+int32 linuxGetOpenFilename( const char* filter, const char* initialDir, bool multiselect,
+                            char* filenameBuffer, int32 filenameBufferSize )
+{
+	return 0;
+}
+
+int32 linuxGetSaveFilename( const char* filter, const char* initialDir, char* filenameBuffer,
+                            int32 filenameBufferSize )
+{
+	return 0;
+}
+
+struct LinuxKeyboardKeyName {
+	char data[20];
+	int32 size;
+};
+global_var LinuxKeyboardKeyName keyboardKeyNames[KC_Count];
+
+void linuxPopulateKeyboardKeyNames()
+{
+	for( auto i = 0; i < KC_Count; ++i ) {
+		auto entry = &keyboardKeyNames[i];
+		if( ( i >= '0' && i <= '9' ) || ( i >= 'A' && i <= 'Z' ) ) {
+			entry->data[0] = (char)i;
+			entry->size    = 1;
+		} else {
+			entry->size = snprintf( entry->data, countof( entry->data ), "0x%02X", i );
+		}
+	}
+}
+StringView linuxGetKeyboardKeyName( VirtualKeyEnumValues key )
+{
+	auto entry = &keyboardKeyNames[(int32)key];
+	return {entry->data, entry->size};
+}
+
+void* linuxDlmallocMalloc( size_t size )
+{
+	auto allocator = LinuxAppContext.dlmallocator;
+	assert( allocator );
+	return mspace_malloc( allocator, size );
+}
+void* linuxDlmallocRealloc( void* ptr, size_t size )
+{
+	auto allocator = LinuxAppContext.dlmallocator;
+	assert( allocator );
+	if( !size ) {
+		if( ptr ) {
+			mspace_free( allocator, ptr );
+		}
+		return nullptr;
+	} else {
+		return mspace_realloc( allocator, ptr, size );
+	}
+}
+void* linuxDlmallocReallocInPlace( void* ptr, size_t size )
+{
+	auto allocator = LinuxAppContext.dlmallocator;
+	assert( allocator );
+	if( !size ) {
+		if( ptr ) {
+			mspace_free( allocator, ptr );
+		}
+		return nullptr;
+	} else {
+		return mspace_realloc_in_place( allocator, ptr, size );
+	}
+}
+void linuxDlmallocMfree( void* ptr )
+{
+	auto allocator = LinuxAppContext.dlmallocator;
+	assert( allocator );
+	mspace_free( allocator, ptr );
+}
+
+void* linuxDlmallocAllocate( size_t size, uint32 alignment )
+{
+	auto allocator = LinuxAppContext.dlmallocator;
+	assert( allocator );
+	auto result = mspace_memalign( allocator, alignment, size );
+	assert_alignment( result, alignment );
+	return result;
+}
+void* linuxDlmallocReallocate( void* ptr, size_t newSize, size_t oldSize, uint32 alignment )
+{
+	assert_alignment( ptr, alignment );
+	auto allocator = LinuxAppContext.dlmallocator;
+	assert( allocator );
+	if( !newSize ) {
+		if( ptr && oldSize ) {
+			mspace_free( allocator, ptr );
+		}
+		return nullptr;
+	} else {
+		auto result = mspace_realloc_in_place( allocator, ptr, newSize );
+		if( !result && newSize ) {
+			result = mspace_memalign( allocator, alignment, newSize );
+			if( result ) {
+				assert_alignment( result, alignment );
+				memcpy( result, ptr, min( newSize, oldSize ) );
+			}
+			mspace_free( allocator, ptr );
+		}
+		return result;
+	}
+}
+void* linuxDlmallocReallocateInPlace( void* ptr, size_t newSize, size_t oldSize, uint32 alignment )
+{
+	assert_alignment( ptr, alignment );
+	auto allocator = LinuxAppContext.dlmallocator;
+	assert( allocator );
+	if( !newSize ) {
+		if( ptr && oldSize ) {
+			mspace_free( allocator, ptr );
+		}
+		return nullptr;
+	}
+	return mspace_realloc_in_place( allocator, ptr, newSize );
+}
+void linuxDlmallocFree( void* ptr, size_t size, uint32 alignment )
+{
+	auto allocator = LinuxAppContext.dlmallocator;
+	assert( allocator );
+	assert_alignment( ptr, alignment );
+	assert( !ptr || size );
+	mspace_free( allocator, ptr );
+}
+
+// debug
+void* linuxReserveMemory( size_t size )
+{
+	auto result =
+	    mmap( nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+	return ( result != MAP_FAILED ) ? ( result ) : ( nullptr );
+}
+bool linuxCommitMemory( void* ptr, size_t size )
+{
+	return mprotect( ptr, size, PROT_READ | PROT_WRITE ) == 0;
+}
+void linuxDiscardMemory( void* ptr, size_t size )
+{
+	// pages read as zero afterwards, uncommitted pages are unaffected
+	madvise( ptr, size, MADV_DONTNEED );
+}
+void linuxReleaseMemory( void* ptr, size_t size ) { munmap( ptr, size ); }
+size_t linuxGetPageSize() { return (size_t)sysconf( _SC_PAGESIZE ); }
+
+void linuxOutputDebugString( const char* str ) { fputs( str, stderr ); }
@@ -0,0 +1,879 @@
+// headless host for running the game dll without a window or gpu, used for benchmarking
+// usage: game_headless [-frames <count>] [-elapsed <ms>] [-realtime] [-verbose] [-dll <path>]
+//                      [-renderer null|software] [-width <pixels>] [-height <pixels>]
+//                      [-threads <count>] [-output <file.png>] [-golden <file.png>]
+//                      [-tolerance <value>] [-replay <file>] [-runs <count>]
+//                      [-trace <file.json>] [-folded <file.txt>] [-memory] [-serial]
+// -output writes the framebuffer of the last frame, -golden compares it against a reference image
+// and exits with 1 if it differs, both require the software renderer
+// -replay runs an input recording made with the -record option of the win32 host, -runs repeats it
+// with the game reinitialized before every run, -frames is ignored when replaying
+// -trace writes the profiling events of every frame as a chrome trace, this needs a game dll built
+// with GAME_PROFILING, -folded writes the profiled call paths of all frames as folded stacks
+// when built with GAME_PROFILING_COUNTERS the block timings include instructions, cache and
+// branch misses per block, if the kernel doesn't allow perf events only ticks are reported
+// -memory prints high-water marks of the game allocators and the allocations of every call site of
+// the last run, both the host and the game dll need to be built with GAME_MEMORY_TRACKING
+// frames are drawn on a render thread while the game updates the next frame, -serial draws them on
+// the main thread after every update instead, when pipelined the render statistics printed by
+// -verbose are the ones of the previous frame
+
+#include "DebugSwitches.h"
+
+#include <type_traits>
+#include <cassert>
+#include <Core/IntegerTypes.h>
+#include <Core/CoreTypes.h>
+#include <Warnings.h>
+#include <cstdarg>
+
+#ifndef GAME_NO_STD
+	#include "GameStl.h"
+#else
+	#define MATH_NO_CRT
+	#define COREFLOAT_NO_CRT
+	#include "Core/StlAlgorithm.h"
+#endif
+
+#include "linuxmalloc.h"
+
+#include <Core/Macros.h>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+
+#include <Core/Math.h>
+#include <tm_utility_wrapper.cpp>
+#include <Core/CoreFloat.h>
+#include <Core/Math.cpp>
+#include <Utility.cpp>
+#include <Core/Log.h>
+
+#ifdef GAME_NO_STD
+	#include "Core/NumericLimits.h"
+#endif
+#include <Core/Truncate.h>
+#include <Core/NullableInt.h>
+#include <Core/Algorithm.h>
+
+#include <Core/StackAllocator.cpp>
+#define VEC3_ARGS_AS_CONST_REF GAME_DEBUG
+#define VEC4_ARGS_AS_CONST_REF GAME_DEBUG
+#include <Core/Vector.cpp>
+#define RECT_ARGS_AS_CONST_REF GAME_DEBUG
+#include <Core/Rect.h>
+#include <Core/Matrix.cpp>
+#define AABB_ARGS_AS_CONST_REF GAME_DEBUG
+#include <Core/AABB.h>
+#define RANGE_ARGS_AS_CONST_REF GAME_DEBUG
+#include <Core/Range.h>
+
+#include <Core/ArrayView.cpp>
+#include <Core/StringView.cpp>
+#include <Core/String.cpp>
+#include <Core/Unicode.cpp>
+#include <Core/Color.cpp>
+#include <tm_conversion_wrapper.cpp>
+
+#include <Core/ScopeGuard.h>
+
+#include <dlfcn.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <Core/Normal.cpp>
+#include <ImageData.h>
+
+#include <VirtualKeys.h>
+#include <Inputs.cpp>
+
+#include <string_logger.cpp>
+global_var string_logger* GlobalDebugLogger   = nullptr;
+#if defined( GAME_DEBUG ) || ( GAME_DEBUG_PRINTING )
+	#define debugLog( ... ) GlobalDebugLogger->log( __VA_ARGS__ );
+	#define debugLogln( ... ) GlobalDebugLogger->logln( __VA_ARGS__ );
+	#define debugLogClear() GlobalDebugLogger->clear()
+	#define debugLogGetString() asStringView( *GlobalDebugLogger )
+#else
+	#define debugLog( ... ) ( (void)0 )
+	#define debugLogln( ... ) ( (void)0 )
+	#define debugLogClear() ( (void)0 )
+	#define debugLogGetString() ( StringView{} )
+#endif
+
+struct TextureMap;
+struct Mesh;
+struct PlatformInfo;
+struct LinuxAppContextData {
+	TextureMap* textureMap;
+	PlatformInfo* info;
+	mspace dlmallocator;
+
+	// meshes and textures are kept in cpu memory, ids are indices + 1 into these tables
+	UArray< Mesh > meshes;
+	UArray< ImageData > textures;
+	int32 shadersCount;
+
+	struct RenderPipeline* renderPipeline;  // nullptr unless frames are drawn on a render thread
+};
+
+extern global_var LinuxAppContextData LinuxAppContext;
+
+#include "linuxFilesystem.cpp"
+#include "linuxTextureLoader.cpp"
+
+#include <Core/IntrusiveLinkedList.h>
+#define NO_PROFILING
+#include <Profiling.cpp>
+#include <ProfilingStatistics.cpp>
+
+#include <QuadTexCoords.cpp>
+#include <Graphics.h>
+#include <Graphics/Font.h>
+#include <TextureMap.cpp>
+#include <JobSystem.cpp>
+#include <GameDeclarations.h>
+
+extern global_var TextureMap* GlobalTextureMap;
+#include <platform/common/RenderPipeline.cpp>
+#include "linuxPlatformServices.cpp"
+#include <platform/common/RenderStatistics.cpp>
+#include <platform/common/SoftwareRenderer.cpp>
+#include <platform/common/InputRecording.cpp>
+#include <platform/common/TimingStatistics.cpp>
+#include <platform/common/JobWorkers.cpp>
+#include <JsonWriter.cpp>
+#include <ProfilingTrace.cpp>
+#ifdef GAME_MEMORY_TRACKING
+	#include <MemoryTracking.cpp>
+#endif
+
+int32 getTimeStampString( char* buffer, int32 size )
+{
+	return linuxGetTimeStampString( buffer, size );
+}
+
+// logging needs some definitions to exists, but those definitions may need to log
+// this could be solved by splitting everything into .h/.cpp pairs, but instead its easier to only
+// split log.h
+#define _LOG_IMPLEMENTATION_
+#include "Core/Log.h"
+
+// globals
+global_var IngameLog* GlobalIngameLog          = nullptr;
+global_var TextureMap* GlobalTextureMap        = nullptr;
+global_var LinuxAppContextData LinuxAppContext = {};
+
+typedef INITIALIZE_APP( InitializeAppType );
+typedef UPDATE_AND_RENDER( UpdateAndRenderType );
+typedef RELOAD_APP( ReloadAppType );
+
+INITIALIZE_APP( InitializeAppStub ) { return {}; }
+UPDATE_AND_RENDER( UpdateAndRenderStub ) { return nullptr; }
+RELOAD_APP( ReloadAppStub ) { return {}; }
+
+InitializeAppType* initializeApp     = InitializeAppStub;
+UpdateAndRenderType* updateAndRender = UpdateAndRenderStub;
+ReloadAppType* reloadApp             = ReloadAppStub;
+
+// there is no hot reloading in the headless host, the dll is loaded once at startup
+bool linuxLoadGameDll( const char* filename )
+{
+	auto library = dlopen( filename, RTLD_NOW | RTLD_LOCAL );
+	if( !library ) {
+		fprintf( stderr, "Failed to load %s: %s\n", filename, dlerror() );
+		return false;
+	}
+	initializeApp   = (InitializeAppType*)dlsym( library, "initializeApp" );
+	updateAndRender = (UpdateAndRenderType*)dlsym( library, "updateAndRender" );
+	reloadApp       = (ReloadAppType*)dlsym( library, "reloadApp" );
+	if( !initializeApp || !updateAndRender || !reloadApp ) {
+		fprintf( stderr, "Failed to find exports in %s\n", filename );
+		dlclose( library );
+		initializeApp   = InitializeAppStub;
+		updateAndRender = UpdateAndRenderStub;
+		reloadApp       = ReloadAppStub;
+		return false;
+	}
+	return true;
+}
+
+// the dll lives next to the executable
+bool linuxGetDefaultGameDllName( char* buffer, size_t bufferSize )
+{
+	const char dllName[] = "libgame_dll.so";
+	auto size            = readlink( "/proc/self/exe", buffer, bufferSize );
+	if( size <= 0 || (size_t)size >= bufferSize ) {
+		return false;
+	}
+	// find dir
+	for( ; size > 0 && buffer[size - 1] != '/'; --size ) {
+	}
+	if( (size_t)size + countof( dllName ) > bufferSize ) {
+		return false;
+	}
+	memcpy( buffer + size, dllName, countof( dllName ) );
+	return true;
+}
+
+void linuxRemap( PlatformRemapInfo* info )
+{
+	GlobalIngameLog   = info->logStorage;
+	GlobalTextureMap  = info->textureMap;
+	GlobalDebugLogger = info->debugLogger;
+}
+
+// frees everything the platform layer allocated on behalf of the game, so that game memory can be
+// initialized again
+void linuxResetPlatformResources()
+{
+	linuxWaitForRenderFrame();
+	if( GlobalTextureMap ) {
+		FOR( entry : GlobalTextureMap->entries ) {
+			delete[] entry.filename.data();
+		}
+	}
+	// image data of TextureMap entries is shared with the texture table
+	FOR( texture : LinuxAppContext.textures ) {
+		freeImageData( &texture );
+	}
+	LinuxAppContext.textures.clear();
+	FOR( mesh : LinuxAppContext.meshes ) {
+		if( mesh.verticesCount >= 0 ) {
+			delete[] mesh.vertices;
+			delete[] mesh.indices;
+		}
+	}
+	LinuxAppContext.meshes.clear();
+	LinuxAppContext.shadersCount = 0;
+}
+
+// draws a frame, runs on the render thread unless -serial is passed
+struct LinuxRenderContext {
+	RenderStatisticsContext* statistics;
+	SoftwareRenderer* softwareRenderer;  // nullptr for the null renderer
+	TimingSamples* timings;
+	double renderTime;  // time the last frame took to draw
+};
+static void linuxRenderFrame( void* data, RenderCommands* renderCommands )
+{
+	auto context   = (LinuxRenderContext*)data;
+	auto startTime = linuxPerformanceCounter();
+	processRenderCommandsStatistics( context->statistics, renderCommands );
+	if( context->softwareRenderer ) {
+		processRenderCommandsSoftware( context->softwareRenderer, renderCommands );
+	}
+	context->renderTime = linuxPerformanceCounter() - startTime;
+	push( context->timings, (float)context->renderTime );
+}
+
+struct LinuxGameMemory {
+	void* memory;
+	size_t memorySize;
+	void* gameMemory;
+	size_t gameMemorySize;
+};
+bool linuxInitializeApp( LinuxGameMemory* memory, PlatformServices platformServices,
+                         PlatformInfo* info, PlatformRemapInfo* initializeResult )
+{
+	// the game dll stays loaded between runs, so profiling info indices that are stored in static
+	// variables of the dll stay valid, which means the infos need to survive the reset
+	auto previousTable           = initializeResult->profilingTable;
+	int32 previousInfosCount     = 0;
+	ProfilingInfo* previousInfos = nullptr;
+	if( previousTable ) {
+		previousInfosCount = previousTable->infosCount;
+		previousInfos      = new ProfilingInfo[MAX_PROFILING_INFOS];
+		memcpy( previousInfos, previousTable->infos, previousInfosCount * sizeof( ProfilingInfo ) );
+	}
+	SCOPE_EXIT( & ) { delete[] previousInfos; };
+
+	// game memory and the dlmalloc mspace are both reset, so that every run starts from the same state
+	memset( memory->memory, 0, memory->memorySize );
+	auto dlmallocMemory     = (void*)( (char*)memory->memory + memory->gameMemorySize );
+	auto dlmallocMemorySize = memory->memorySize - memory->gameMemorySize;
+	LinuxAppContext.dlmallocator =
+	    create_mspace_with_base( dlmallocMemory, dlmallocMemorySize, false );
+	if( !LinuxAppContext.dlmallocator ) {
+		fprintf( stderr, "Could not create dlmallocator\n" );
+		return false;
+	}
+	mspace_track_large_chunks( LinuxAppContext.dlmallocator, true );
+
+	*info                     = {};
+	info->microsecondsPerTick = linuxGetMicrosecondsPerTick();
+	*initializeResult         = initializeApp( memory->gameMemory, memory->gameMemorySize,
+	                                   platformServices, info );
+	if( !initializeResult->success ) {
+		fprintf( stderr, "App initialization failed\n" );
+		return false;
+	}
+	linuxRemap( initializeResult );
+	auto table = initializeResult->profilingTable;
+	if( table && previousInfos ) {
+		memcpy( table->infos, previousInfos, previousInfosCount * sizeof( ProfilingInfo ) );
+		table->infosCount = previousInfosCount;
+	}
+	return true;
+}
+
+// chrome trace that is written frame by frame, so that whole sessions can be traced
+struct LinuxProfilingTrace {
+	FILE* file;
+	char* buffer;
+	size_t bufferSize;
+	uint64 originTimestamp;
+	bool8 isNotFirst;  // whether events were written, so that the next ones need a leading comma
+};
+bool linuxBeginProfilingTrace( LinuxProfilingTrace* trace, const char* filename )
+{
+	*trace      = {};
+	trace->file = fopen( filename, "wb" );
+	if( !trace->file ) {
+		return false;
+	}
+	trace->originTimestamp = __rdtsc();
+	// thread names are only known at the end of the session, they are written last
+	fputs( "{\"traceEvents\":[", trace->file );
+	return true;
+}
+void linuxWriteProfilingTraceFrame( LinuxProfilingTrace* trace, StackAllocator* scrap,
+                                    ProfilingTable* table, double microsecondsPerTick )
+{
+	if( !trace->file || !table ) {
+		return;
+	}
+	TEMPORARY_MEMORY_BLOCK( scrap ) {
+		auto capture = captureProfilingFrames( scrap, table, 1 );
+		auto size    = getProfilingTraceSize( &capture, table );
+		if( size > trace->bufferSize ) {
+			auto buffer = (char*)realloc( trace->buffer, size );
+			if( !buffer ) {
+				fprintf( stderr, "Out of memory\n" );
+				return;
+			}
+			trace->buffer     = buffer;
+			trace->bufferSize = size;
+		}
+
+		auto writer          = makeJsonWriter( trace->buffer, safe_truncate< int32 >( size ) );
+		writer.minimal       = true;
+		writer.isNotFirst    = trace->isNotFirst;
+		writer.isNotProperty = true;
+		writeProfilingTraceEvents( &writer, &capture, table, trace->originTimestamp,
+		                           microsecondsPerTick );
+		fwrite( writer.data(), 1, writer.size(), trace->file );
+		trace->isNotFirst = writer.isNotFirst;
+	}
+}
+void linuxEndProfilingTrace( LinuxProfilingTrace* trace, ProfilingTable* table )
+{
+	if( trace->file ) {
+		char buffer[256 + MAX_PROFILING_THREADS * ProfilingTraceThreadNameSize];
+		auto writer          = makeJsonWriter( buffer, countof( buffer ) );
+		writer.minimal       = true;
+		writer.isNotFirst    = trace->isNotFirst;
+		writer.isNotProperty = true;
+		if( table ) {
+			writeProfilingTraceMetadata( &writer, table );
+		}
+		writeEndArray( &writer );
+		writeProfilingTraceOtherData( &writer,
+		                              ( table ) ? ( table->droppedEvents.load() ) : ( 0 ) );
+		writeEndObject( &writer );
+		fwrite( writer.data(), 1, writer.size(), trace->file );
+		fclose( trace->file );
+	}
+	free( trace->buffer );
+	*trace = {};
+}
+
+int main( int argc, char** argv )
+{
+	const double FixedTargetTime = 1000.0f / 60.0f;
+
+	intmax framesCount     = 600;
+	intmax runsCount       = 1;
+	double frameElapsed    = FixedTargetTime;
+	bool realtime          = false;
+	bool verbose           = false;
+	const char* dllName    = nullptr;
+	bool software          = false;
+	int32 width            = 0;
+	int32 height           = 0;
+	int32 threadsCount     = (int32)std::thread::hardware_concurrency();
+	const char* outputName = nullptr;
+	const char* goldenName = nullptr;
+	const char* replayName = nullptr;
+	const char* traceName  = nullptr;
+	const char* foldedName = nullptr;
+	bool memoryReport      = false;
+	bool serial            = false;
+	int32 tolerance        = 0;
+	char dllNameBuffer[PATH_MAX];
+	for( auto i = 1; i < argc; ++i ) {
+		auto arg      = argv[i];
+		auto hasValue = i + 1 < argc;
+		if( strcmp( arg, "-frames" ) == 0 && hasValue ) {
+			framesCount = (intmax)atoll( argv[++i] );
+		} else if( strcmp( arg, "-elapsed" ) == 0 && hasValue ) {
+			frameElapsed = atof( argv[++i] );
+		} else if( strcmp( arg, "-realtime" ) == 0 ) {
+			realtime = true;
+		} else if( strcmp( arg, "-verbose" ) == 0 ) {
+			verbose = true;
+		} else if( strcmp( arg, "-dll" ) == 0 && hasValue ) {
+			dllName = argv[++i];
+		} else if( strcmp( arg, "-renderer" ) == 0 && hasValue ) {
+			auto renderer = argv[++i];
+			if( strcmp( renderer, "software" ) == 0 ) {
+				software = true;
+			} else if( strcmp( renderer, "null" ) == 0 ) {
+				software = false;
+			} else {
+				fprintf( stderr, "Unknown renderer: %s\n", renderer );
+				return 1;
+			}
+		} else if( strcmp( arg, "-width" ) == 0 && hasValue ) {
+			width = atoi( argv[++i] );
+		} else if( strcmp( arg, "-height" ) == 0 && hasValue ) {
+			height = atoi( argv[++i] );
+		} else if( strcmp( arg, "-threads" ) == 0 && hasValue ) {
+			threadsCount = atoi( argv[++i] );
+		} else if( strcmp( arg, "-output" ) == 0 && hasValue ) {
+			outputName = argv[++i];
+		} else if( strcmp( arg, "-golden" ) == 0 && hasValue ) {
+			goldenName = argv[++i];
+		} else if( strcmp( arg, "-tolerance" ) == 0 && hasValue ) {
+			tolerance = atoi( argv[++i] );
+		} else if( strcmp( arg, "-replay" ) == 0 && hasValue ) {
+			replayName = argv[++i];
+		} else if( strcmp( arg, "-runs" ) == 0 && hasValue ) {
+			runsCount = (intmax)atoll( argv[++i] );
+		} else if( strcmp( arg, "-trace" ) == 0 && hasValue ) {
+			traceName = argv[++i];
+		} else if( strcmp( arg, "-folded" ) == 0 && hasValue ) {
+			foldedName = argv[++i];
+		} else if( strcmp( arg, "-memory" ) == 0 ) {
+			memoryReport = true;
+		} else if( strcmp( arg, "-serial" ) == 0 ) {
+			serial = true;
+		} else {
+			fprintf( stderr, "Unknown argument: %s\n", arg );
+			return 1;
+		}
+	}
+	if( !dllName ) {
+		if( !linuxGetDefaultGameDllName( dllNameBuffer, countof( dllNameBuffer ) ) ) {
+			fprintf( stderr, "Failed to get game dll name\n" );
+			return 1;
+		}
+		dllName = dllNameBuffer;
+	}
+	if( ( outputName || goldenName ) && !software ) {
+		fprintf( stderr, "-output and -golden require -renderer software\n" );
+		return 1;
+	}
+
+	// recording needs to stay alive while replaying, since replay points into it
+	auto replayFile =
+	    ( replayName ) ? ( linuxReadWholeFileInternal( replayName ) ) : ( AllocatedFileContents() );
+	auto replay = Array< InputRecordingFrame >();
+	if( replayName ) {
+		if( !replayFile ) {
+			fprintf( stderr, "Failed to read input recording %s\n", replayName );
+			return 1;
+		}
+		replay = parseInputRecording( replayFile );
+		if( !replay.size() ) {
+			fprintf( stderr, "Input recording %s is invalid or empty\n", replayName );
+			return 1;
+		}
+		framesCount = replay.size();
+	} else {
+		runsCount = 1;
+	}
+	if( framesCount <= 0 || runsCount <= 0 ) {
+		fprintf( stderr, "Nothing to run\n" );
+		return 1;
+	}
+	auto totalFramesCount = framesCount * runsCount;
+
+	const size_t memorySize     = megabytes( 20 );
+	const size_t gameMemorySize = memorySize / 2;
+
+	auto memory = mmap( nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+	                    -1, 0 );
+	if( memory == MAP_FAILED ) {
+		fprintf( stderr, "Out of memory\n" );
+		return 1;
+	}
+	LinuxGameMemory gameMemory = {memory, memorySize, memory, gameMemorySize};
+
+	if( !linuxLoadGameDll( dllName ) ) {
+		return 1;
+	}
+
+	linuxPopulateKeyboardKeyNames();
+
+	auto platformMemorySize = megabytes( 1 );
+	auto platformMemory     = mmap( nullptr, platformMemorySize, PROT_READ | PROT_WRITE,
+	                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if( platformMemory == MAP_FAILED ) {
+		fprintf( stderr, "Out of memory\n" );
+		return 1;
+	}
+	auto platformAllocator   = makeStackAllocator( platformMemory, platformMemorySize );
+	LinuxAppContext.meshes   = makeUArray( &platformAllocator, Mesh, MaxMeshCount );
+	LinuxAppContext.textures = makeUArray( &platformAllocator, ImageData, 256 );
+	auto renderStatistics    = makeRenderStatisticsContext( &LinuxAppContext.meshes );
+
+	// timing samples of every frame, profiling blocks are allocated lazily when they are first seen
+	const int32 maxProfilingBlocks = 256;
+	auto samplesCapacity           = safe_truncate< int32 >( totalFramesCount );
+	auto timingsMemorySize         = ( sizeof( float ) * samplesCapacity + 16 )
+	                                 * ( 3 + maxProfilingBlocks )
+	                             + sizeof( ProfilingBlockTimings ) * maxProfilingBlocks;
+	auto timingsMemory = mmap( nullptr, timingsMemorySize, PROT_READ | PROT_WRITE,
+	                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+	if( timingsMemory == MAP_FAILED ) {
+		fprintf( stderr, "Out of memory\n" );
+		return 1;
+	}
+	auto timingsAllocator = makeStackAllocator( timingsMemory, timingsMemorySize );
+	auto frameTimings     = makeTimingSamples( &timingsAllocator, samplesCapacity );
+	auto gameTimings      = makeTimingSamples( &timingsAllocator, samplesCapacity );
+	auto renderTimings    = makeTimingSamples( &timingsAllocator, samplesCapacity );
+	auto profilingTimings = new ProfilingTimings;
+	initProfilingTimings( profilingTimings, &timingsAllocator, samplesCapacity );
+
+	// profiling events of every frame are captured into scrap memory, processProfilingEvents
+	// splits scrap in half and needs room for the blocks it creates
+	auto profilingScrapSize   = getProfilingCaptureSize() * 3;
+	auto profilingScrapMemory = mmap( nullptr, profilingScrapSize, PROT_READ | PROT_WRITE,
+	                                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+	if( profilingScrapMemory == MAP_FAILED ) {
+		fprintf( stderr, "Out of memory\n" );
+		return 1;
+	}
+	auto profilingScrap = makeStackAllocator( profilingScrapMemory, profilingScrapSize );
+
+	// call paths of every frame for -folded, the rolling window isn't used by the host
+	ProfilingStatistics* profilingStatistics = nullptr;
+	if( foldedName ) {
+		profilingStatistics         = new ProfilingStatistics;
+		const size_t statisticsSize = megabytes( 4 );
+		auto statisticsMemory       = mmap( nullptr, statisticsSize, PROT_READ | PROT_WRITE,
+		                                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+		if( statisticsMemory == MAP_FAILED ) {
+			fprintf( stderr, "Out of memory\n" );
+			return 1;
+		}
+		auto statisticsAllocator = makeStackAllocator( statisticsMemory, statisticsSize );
+		initProfilingStatistics( profilingStatistics, &statisticsAllocator, statisticsSize, 1 );
+	}
+
+	// the game runs its jobs on the same number of threads as the software renderer
+	JobWorkers jobWorkers = {};
+	initJobWorkers( &jobWorkers, threadsCount );
+	SCOPE_EXIT( & ) { destroyJobWorkers( &jobWorkers ); };
+
+	PlatformServices platformServices = {
+	    // graphics
+	    &linuxLoadTexture, &linuxLoadTextureFromMemory, &linuxLoadTextureFromImage,
+	    &linuxDeleteTexture, &loadImageToMemory,
+	    &freeImageData, &linuxLoadFont, &linuxUploadMesh, &linuxDeleteMesh,
+
+	    // shader
+	    &linuxLoadShader, &linuxDeleteShader,
+
+	    // filesystem
+	    &linuxWriteBufferToFile, &linuxReadFileToBuffer, &linuxGetOpenFilename,
+	    &linuxGetSaveFilename,
+
+	    // utility
+	    &linuxGetKeyboardKeyName, &linuxGetTimeStampString,
+
+	    // malloc
+	    &linuxDlmallocMalloc, &linuxDlmallocRealloc, &linuxDlmallocReallocInPlace,
+	    &linuxDlmallocMfree, &linuxDlmallocAllocate, &linuxDlmallocReallocate,
+	    &linuxDlmallocReallocateInPlace, &linuxDlmallocFree,
+
+	    // virtual memory
+	    {&linuxReserveMemory, &linuxCommitMemory, &linuxDiscardMemory, &linuxReleaseMemory,
+	     linuxGetPageSize()},
+
+	    // jobs
+	    &jobWorkers.system,
+
+	    // debug
+	    &linuxOutputDebugString,
+	};
+	PlatformInfo info                  = {};
+	PlatformRemapInfo initializeResult = {};
+	LinuxAppContext.info               = &info;
+	if( !linuxInitializeApp( &gameMemory, platformServices, &info, &initializeResult ) ) {
+		return 1;
+	}
+
+	SoftwareRasterizer softwareRasterizer = {};
+	if( software ) {
+		initSoftwareRasterizer( &softwareRasterizer, threadsCount );
+	}
+	SCOPE_EXIT( & ) {
+		if( software ) {
+			destroySoftwareRasterizer( &softwareRasterizer );
+		}
+	};
+
+	SoftwareRenderer softwareRenderer = {};
+	if( software ) {
+		if( width <= 0 ) {
+			width = initializeResult.width;
+		}
+		if( height <= 0 ) {
+			height = initializeResult.height;
+		}
+		const int32 maxTriangles = 0x10000;
+		auto rendererMemorySize  = getSoftwareRendererMemorySize( width, height, maxTriangles );
+		auto rendererMemory = mmap( nullptr, rendererMemorySize, PROT_READ | PROT_WRITE,
+		                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+		if( rendererMemory == MAP_FAILED ) {
+			fprintf( stderr, "Out of memory\n" );
+			return 1;
+		}
+		auto rendererAllocator = makeStackAllocator( rendererMemory, rendererMemorySize );
+		softwareRenderer =
+		    makeSoftwareRenderer( &rendererAllocator, width, height, &LinuxAppContext.meshes,
+		                          &LinuxAppContext.textures, maxTriangles, &softwareRasterizer );
+		if( !isValid( &softwareRenderer ) ) {
+			fprintf( stderr, "Failed to create software renderer\n" );
+			return 1;
+		}
+	}
+
+	LinuxRenderContext renderContext = {&renderStatistics, nullptr, &renderTimings};
+	if( software ) {
+		renderContext.softwareRenderer = &softwareRenderer;
+	}
+	RenderPipeline renderPipeline = {};
+	if( !serial ) {
+		initRenderPipeline( &renderPipeline, linuxRenderFrame, &renderContext );
+		LinuxAppContext.renderPipeline = &renderPipeline;
+	}
+	SCOPE_EXIT( & ) {
+		if( LinuxAppContext.renderPipeline ) {
+			destroyRenderPipeline( &renderPipeline );
+			LinuxAppContext.renderPipeline = nullptr;
+		}
+	};
+
+	GameInputs inputs      = {};
+	GameInputs fixedInputs = {};
+
+	intmax stepsCount  = 0;
+	double elapsedTime = frameElapsed;
+
+	// structure for fixed time steps
+	struct {
+		double accumulator;
+	} timing = {};
+
+	LinuxProfilingTrace profilingTrace = {};
+	if( traceName && !linuxBeginProfilingTrace( &profilingTrace, traceName ) ) {
+		fprintf( stderr, "Failed to open %s\n", traceName );
+		return 1;
+	}
+
+	auto benchmarkStartTime  = linuxPerformanceCounter();
+	auto benchmarkStartTicks = __rdtsc();
+	for( intmax run = 0; run < runsCount; ++run ) {
+		if( run > 0 ) {
+			linuxResetPlatformResources();
+			if( !linuxInitializeApp( &gameMemory, platformServices, &info, &initializeResult ) ) {
+				return 1;
+			}
+			timing = {};
+		}
+		resetInputs( &inputs );
+		resetInputs( &fixedInputs );
+
+		for( intmax frame = 0; frame < framesCount; ++frame ) {
+			double startTime = linuxPerformanceCounter();
+
+			// in non realtime mode every frame advances the same amount of time, so that runs are
+			// deterministic regardless of how fast the machine is
+			float clampedElapsedTime =
+			    (float)( ( realtime ) ? ( elapsedTime ) : ( frameElapsed ) );
+			const float maxElapsedTime = (float)( FixedTargetTime * 1.5 );
+			if( clampedElapsedTime > maxElapsedTime ) {
+				clampedElapsedTime = maxElapsedTime;
+			}
+
+			int32 stepCount = 0;
+			if( replay.size() ) {
+				auto currentFrame  = &replay[(int32)frame];
+				inputs             = currentFrame->inputs;
+				fixedInputs        = currentFrame->fixedInputs;
+				clampedElapsedTime = currentFrame->elapsedTime;
+				stepCount          = currentFrame->stepCount;
+				timing.accumulator += clampedElapsedTime;
+				timing.accumulator -= stepCount * FixedTargetTime;
+				if( timing.accumulator < 0 ) {
+					timing.accumulator = 0;
+				}
+			} else {
+				timing.accumulator += clampedElapsedTime;
+				stepCount = ( int32 )( timing.accumulator / FixedTargetTime );
+				timing.accumulator -= stepCount * FixedTargetTime;
+			}
+
+			float blendFactor = (float)( timing.accumulator / FixedTargetTime );
+
+			{
+				auto mallinfo        = mspace_mallinfo( LinuxAppContext.dlmallocator );
+				info.mallocAllocated = mallinfo.uordblks;
+				info.mallocFree      = mallinfo.fordblks;
+				info.mallocFootprint = info.mallocAllocated + info.mallocFree;
+			}
+
+			auto gameStartTime  = linuxPerformanceCounter();
+			auto renderCommands = updateAndRender( gameMemory.gameMemory, &inputs, &fixedInputs,
+			                                       clampedElapsedTime, stepCount, blendFactor );
+			if( stepCount ) {
+				resetInputs( &fixedInputs );
+			}
+			resetInputs( &inputs );
+			auto gameTime = linuxPerformanceCounter() - gameStartTime;
+			info.gameTime = (float)gameTime;
+			collectProfilingTimings( profilingTimings, &profilingScrap,
+			                         initializeResult.profilingTable );
+			linuxWriteProfilingTraceFrame( &profilingTrace, &profilingScrap,
+			                               initializeResult.profilingTable,
+			                               info.microsecondsPerTick );
+			if( foldedName && initializeResult.profilingTable ) {
+				TEMPORARY_MEMORY_BLOCK( &profilingScrap ) {
+					auto state =
+					    processProfilingEvents( &profilingScrap, initializeResult.profilingTable );
+					updateProfilingStatistics( profilingStatistics, &state );
+				}
+			}
+
+			// when pipelined the previous frame was drawn while the game updated this one, the
+			// render thread gets ownership of this frame until the next waitForRenderFrame
+			if( LinuxAppContext.renderPipeline ) {
+				waitForRenderFrame( &renderPipeline );
+			} else if( renderCommands ) {
+				linuxRenderFrame( &renderContext, renderCommands );
+			}
+			// the render thread is idle until the next submit, so the render time and statistics of
+			// the last drawn frame are copied before handing it this one
+			auto renderTime  = renderContext.renderTime;
+			auto renderFrame = renderStatistics.frame;
+			if( LinuxAppContext.renderPipeline && renderCommands ) {
+				submitRenderFrame( &renderPipeline, renderCommands );
+			}
+			double endTime  = linuxPerformanceCounter();
+			info.renderTime = (float)renderTime;
+
+			elapsedTime         = endTime - startTime;
+			info.totalFrameTime = (float)elapsedTime;
+			info.fps            = 1000.0f / info.totalFrameTime;
+
+			push( &frameTimings, (float)elapsedTime );
+			push( &gameTimings, (float)gameTime );
+			stepsCount += stepCount;
+
+			if( verbose ) {
+				printf( "frame %6lld: total %8.3fms game %8.3fms render %8.3fms steps %d "
+				        "commands %lld draw calls %lld\n",
+				        (long long)frame, elapsedTime, gameTime, renderTime, stepCount,
+				        (long long)renderFrame.commands, (long long)renderFrame.drawCalls );
+			}
+		}
+	}
+	if( LinuxAppContext.renderPipeline ) {
+		waitForRenderFrame( &renderPipeline );
+	}
+	auto benchmarkTime  = linuxPerformanceCounter() - benchmarkStartTime;
+	auto benchmarkTicks = __rdtsc() - benchmarkStartTicks;
+	auto msPerTick      = ( benchmarkTicks ) ? ( benchmarkTime / benchmarkTicks ) : ( 0 );
+
+	printf( "runs %lld, frames %lld, steps %lld, total %.3fms\n", (long long)runsCount,
+	        (long long)totalFramesCount, (long long)stepsCount, benchmarkTime );
+	auto framePercentiles  = getTimingPercentiles( &frameTimings );
+	auto gamePercentiles   = getTimingPercentiles( &gameTimings );
+	auto renderPercentiles = getTimingPercentiles( &renderTimings );
+	printTimingPercentiles( stdout, "frame", &framePercentiles );
+	printTimingPercentiles( stdout, "game", &gamePercentiles );
+	printTimingPercentiles( stdout, "render", &renderPercentiles );
+	printProfilingTimings( stdout, profilingTimings, msPerTick );
+	printRenderStatistics( stdout, &renderStatistics );
+	if( auto table = initializeResult.profilingTable ) {
+		if( auto dropped = table->droppedEvents.load() ) {
+			printf( "profiling: dropped %u events of threads without a buffer\n", dropped );
+		}
+	}
+
+	if( traceName ) {
+		linuxEndProfilingTrace( &profilingTrace, initializeResult.profilingTable );
+		printf( "written profiling trace to %s\n", traceName );
+	}
+	if( foldedName && initializeResult.profilingTable ) {
+		auto table  = initializeResult.profilingTable;
+		auto size   = getProfilingFoldedStacksSize( profilingStatistics, table );
+		auto buffer = new char[size];
+		SCOPE_EXIT( & ) { delete[] buffer; };
+		auto builder = string_builder( buffer, safe_truncate< int32 >( size ) );
+		writeProfilingFoldedStacks( &builder, profilingStatistics, table );
+		linuxWriteBufferToFile( foldedName, builder.data(), builder.size() );
+		printf( "written folded stacks to %s\n", foldedName );
+	}
+	if( memoryReport ) {
+#ifdef GAME_MEMORY_TRACKING
+		if( auto table = initializeResult.memoryTrackingTable ) {
+			auto size   = getMemoryTrackingReportSize( table, MAX_ALLOCATION_SITES );
+			auto buffer = new char[size];
+			SCOPE_EXIT( & ) { delete[] buffer; };
+			auto builder = string_builder( buffer, safe_truncate< int32 >( size ) );
+			writeMemoryTrackingReport( &builder, table, MAX_ALLOCATION_SITES );
+			fwrite( builder.data(), 1, builder.size(), stdout );
+		} else {
+			fprintf( stderr, "-memory requires a game dll built with GAME_MEMORY_TRACKING\n" );
+		}
+#else
+		fprintf( stderr, "-memory requires a host built with GAME_MEMORY_TRACKING\n" );
+#endif
+	}
+
+	if( outputName ) {
+		if( !writeSoftwareFramebuffer( &softwareRenderer, outputName ) ) {
+			fprintf( stderr, "Failed to write %s\n", outputName );
+			return 1;
+		}
+		printf( "written framebuffer to %s\n", outputName );
+	}
+	if( goldenName ) {
+		auto golden = loadImageToMemory( goldenName );
+		if( !golden ) {
+			fprintf( stderr, "Failed to load golden image %s\n", goldenName );
+			return 1;
+		}
+		SCOPE_EXIT( & ) { freeImageData( &golden ); };
+		auto difference = compareSoftwareFramebuffer( &softwareRenderer, golden, tolerance );
+		if( difference.sizeMismatch ) {
+			printf( "golden image mismatch: size %dx%d, expected %dx%d\n", width, height,
+			        golden.width, golden.height );
+			return 1;
+		}
+		printf( "golden image: %d pixels differ by more than %d, max difference %d\n",
+		        difference.differentPixels, tolerance, difference.maxDifference );
+		if( difference.differentPixels ) {
+			return 1;
+		}
+	}
+	return 0;
+}
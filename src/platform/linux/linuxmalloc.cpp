@@ -0,0 +1,8 @@
+#include "linuxmalloc.h"
+
+// disable mmap and MORECORE, so that malloc cannot get more system memory
+#define HAVE_MMAP 0
+#define HAVE_MORECORE 0
+#define HAVE_MREMAP 0
+
+#include <dlmalloc.c>
@@ -28,15 +28,15 @@ int32 win32GetTimeStampString( char* buffer, int32 size )
 
 // textures
 
-TextureId win32LoadTexture( StringView filename )
+TextureId win32LoadTextureFromImage( StringView filename, ImageData image )
 {
 	TextureId result = {};
 	assert( GlobalTextureMap );
 	if( auto chached = getTextureInfo( filename ) ) {
-		LOG( INFORMATION, "loaded chached texture {}", filename );
+		// the same texture was requested more than once
+		freeImageData( &image );
 		result = chached->id;
 	} else {
-		auto image = loadImageToMemory( filename );
 		bool freeImage = true;
 		if( image ) {
 			result = toTextureId( win32UploadImageToGpu( image ) );
@@ -65,6 +65,15 @@ TextureId win32LoadTexture( StringView filename )
 	}
 	return result;
 }
+TextureId win32LoadTexture( StringView filename )
+{
+	assert( GlobalTextureMap );
+	if( auto chached = getTextureInfo( filename ) ) {
+		LOG( INFORMATION, "loaded chached texture {}", filename );
+		return chached->id;
+	}
+	return win32LoadTextureFromImage( filename, loadImageToMemory( filename ) );
+}
 TextureId win32LoadTextureFromMemory( ImageData image )
 {
 	TextureId result = toTextureId( win32UploadImageToGpu( image ) );
@@ -328,6 +337,39 @@ void win32DlmallocFree( void* ptr, size_t size, uint32 alignment )
 }
 
 // debug
+void* win32ReserveMemory( size_t size )
+{
+	return VirtualAlloc( nullptr, size, MEM_RESERVE, PAGE_NOACCESS );
+}
+bool win32CommitMemory( void* ptr, size_t size )
+{
+	return VirtualAlloc( ptr, size, MEM_COMMIT, PAGE_READWRITE ) != nullptr;
+}
+void win32DiscardMemory( void* ptr, size_t size )
+{
+	// MEM_RESET fails on ranges that contain uncommitted pages, so only committed regions are reset
+	auto current = (char*)ptr;
+	auto last    = current + size;
+	while( current < last ) {
+		MEMORY_BASIC_INFORMATION info;
+		if( !VirtualQuery( current, &info, sizeof( info ) ) ) {
+			break;
+		}
+		auto regionEnd = min( (char*)info.BaseAddress + info.RegionSize, last );
+		if( info.State == MEM_COMMIT ) {
+			VirtualAlloc( current, regionEnd - current, MEM_RESET, PAGE_READWRITE );
+		}
+		current = regionEnd;
+	}
+}
+void win32ReleaseMemory( void* ptr, size_t size ) { VirtualFree( ptr, 0, MEM_RELEASE ); }
+size_t win32GetPageSize()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo( &info );
+	return (size_t)info.dwPageSize;
+}
+
 void win32OutputDebugString( const char* str )
 {
 	// TODO: utf8?
@@ -51,6 +51,7 @@
 #include <Core/String.cpp>
 #include <Core/Unicode.cpp>
 #include <Core/Color.cpp>
+#include <Core/Hash.cpp>
 #include <tm_conversion_wrapper.cpp>
 
 #include <Core/ScopeGuard.h>
@@ -115,6 +116,7 @@ extern global_var Win32AppContextData Win32AppContext;
 #include <Graphics.h>
 #include <Graphics/Font.h>
 #include <TextureMap.cpp>
+#include <JobSystem.cpp>
 #include <GameDeclarations.h>
 
 #include "win32_opengl.cpp"
@@ -122,6 +124,9 @@ extern global_var Win32AppContextData Win32AppContext;
 
 extern global_var TextureMap* GlobalTextureMap;
 #include "win32PlatformServices.cpp"
+#include <platform/common/InputRecording.cpp>
+#include <platform/common/MemorySnapshots.cpp>
+#include <platform/common/JobWorkers.cpp>
 
 int32 getTimeStampString( char* buffer, int32 size )
 {
@@ -386,7 +391,9 @@ bool win32GetFileWriteTime( const wchar_t* file, FILETIME* outTime )
 	return success;
 }
 // returns whether the dll has been reloaded
-bool win32LoadGameDll( Win32GameDll* dll )
+// background jobs run code of the dll, they are finished before it is unloaded
+// jobs can be null as long as no dll was loaded yet
+bool win32LoadGameDll( Win32GameDll* dll, JobSystem* jobs )
 {
 	bool reloaded = false;
 	// make sure that there is no lockfile, so that when we do LoadLibrary the pdb is also loaded
@@ -397,6 +404,8 @@ bool win32LoadGameDll( Win32GameDll* dll )
 			if( CompareFileTime( &currentTime, &dll->lastWriteTime ) > 0 ) {
 				dll->lastWriteTime = currentTime;
 				if( dll->library ) {
+					assert( jobs );
+					waitForBackgroundJobs( jobs );
 					FreeLibrary( dll->library );
 					initializeApp   = InitializeAppStub;
 					updateAndRender = UpdateAndRenderStub;
@@ -432,21 +441,26 @@ bool win32LoadGameDll( Win32GameDll* dll )
 	return reloaded;
 }
 
-const int32 Win32MaxRecording = 20000;
-struct Win32RecordingFrame {
-	GameInputs inputs;
-	GameInputs fixedInputs;
-	float elapsedTime;
-	int32 stepCount;
-};
+const int32 Win32MaxRecording        = 20000;
+const int32 Win32SnapshotInterval    = 60;  // frames between snapshots while recording
+const int32 Win32MaxSnapshots        = 128;
+const int32 Win32SnapshotStorageSize = megabytes( 64 );
 struct Win32InputRecording {
-	Win32RecordingFrame entries[Win32MaxRecording];
+	InputRecordingFrame entries[Win32MaxRecording];
 	int32 count;
 	int32 currentInput;
-	void* memory;
-	size_t memorySize;
+	MemorySnapshots snapshots;  // snapshot 0 is taken at the start of the recording
 };
 
+// restores a snapshot and continues replaying from the frame it was taken at
+// background jobs write into game memory, they are finished before it is overwritten
+static void win32ReplayFromSnapshot( Win32InputRecording* recording, JobSystem* jobs, int32 index )
+{
+	waitForBackgroundJobs( jobs );
+	restoreMemorySnapshot( &recording->snapshots, index );
+	recording->currentInput = recording->snapshots.snapshots[index].tag;
+}
+
 void win32Remap( PlatformRemapInfo* info )
 {
 	GlobalIngameLog   = info->logStorage;
@@ -454,8 +468,24 @@ void win32Remap( PlatformRemapInfo* info )
 	GlobalDebugLogger = info->debugLogger;
 }
 
+static void win32SaveInputRecording( Win32InputRecording* recording, const char* filename )
+{
+	saveInputRecording( &win32WriteBufferToFile, filename,
+	                    makeArrayView( recording->entries, recording->count ) );
+	LOG( INFORMATION, "saved input recording {} ({} frames)", filename, recording->count );
+}
+
 int CALLBACK WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow )
 {
+	// -record <file> records inputs from startup and saves them to file when recording stops, the
+	// file can be replayed by the headless host
+	const char* recordFilename = nullptr;
+	for( auto i = 1; i < __argc; ++i ) {
+		if( strcmp( __argv[i], "-record" ) == 0 && i + 1 < __argc ) {
+			recordFilename = __argv[++i];
+		}
+	}
+
 	const size_t memorySize         = megabytes( 20 );
 	const size_t gameMemorySize     = memorySize / 2;
 	const size_t dlmallocMemorySize = memorySize - gameMemorySize;
@@ -476,13 +506,18 @@ int CALLBACK WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdL
 	mspace_track_large_chunks( Win32AppContext.dlmallocator, true );
 
 	auto dll = win32MakeGameDllNames( L"game_dll.dll", L"game_copy.dll", L"lock.tmp" );
-	win32LoadGameDll( &dll );
+	win32LoadGameDll( &dll, nullptr );
 
 	win32PopulateKeyboardKeyNames();
 
+	JobWorkers jobWorkers = {};
+	initJobWorkers( &jobWorkers, (int32)std::thread::hardware_concurrency() );
+	SCOPE_EXIT( & ) { destroyJobWorkers( &jobWorkers ); };
+
 	PlatformServices platformServices = {
 	    // graphics
-	    &win32LoadTexture, &win32LoadTextureFromMemory, &win32DeleteTexture, &loadImageToMemory,
+	    &win32LoadTexture, &win32LoadTextureFromMemory, &win32LoadTextureFromImage,
+	    &win32DeleteTexture, &loadImageToMemory,
 	    &freeImageData, &win32LoadFont, &win32UploadMeshToGpu, &win32DeleteMesh,
 
 	    // shader
@@ -500,6 +535,13 @@ int CALLBACK WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdL
 	    &win32DlmallocMfree, &win32DlmallocAllocate, &win32DlmallocReallocate,
 	    &win32DlmallocReallocateInPlace, &win32DlmallocFree,
 
+	    // virtual memory
+	    {&win32ReserveMemory, &win32CommitMemory, &win32DiscardMemory, &win32ReleaseMemory,
+	     win32GetPageSize()},
+
+	    // jobs
+	    &jobWorkers.system,
+
 	    // debug
 	    &win32OutputDebugString,
 	};
@@ -611,14 +653,34 @@ int CALLBACK WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdL
 	bool replayStep                = false;
 	Win32InputRecording* recording = new Win32InputRecording;
 	recording->count               = 0;
-	recording->memory =
-	    VirtualAlloc( nullptr, memorySize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE );
+	{
+		auto snapshotsMaxBlocks = Win32SnapshotStorageSize / MemorySnapshotBlockSize;
+		auto snapshotsSize =
+		    getMemorySnapshotsSize( memorySize, Win32MaxSnapshots, snapshotsMaxBlocks );
+		auto snapshotsMemory =
+		    VirtualAlloc( nullptr, snapshotsSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE );
+		if( !snapshotsMemory ) {
+			LOG( ERROR, "Out of memory" );
+			return 0;
+		}
+		auto snapshotsAllocator = makeStackAllocator( snapshotsMemory, snapshotsSize );
+		recording->snapshots    = makeMemorySnapshots( &snapshotsAllocator, memory, memorySize,
+		                                            Win32MaxSnapshots, snapshotsMaxBlocks );
+	}
+	if( recordFilename ) {
+		recordingInputs = takeMemorySnapshot( &recording->snapshots, 0 );
+	}
 
 	RenderCommands* renderCommands = nullptr;
 
+	// the rate of rdtsc is measured against the performance counter over the whole session, so that
+	// profiling timestamps can be converted to time
+	auto calibrationStartTime  = win32PerformanceCounter();
+	auto calibrationStartTicks = __rdtsc();
+
 	resetInputs( &inputs );
 	while( running ) {
-		if( win32LoadGameDll( &dll ) ) {
+		if( win32LoadGameDll( &dll, &jobWorkers.system ) ) {
 			auto remapInfo = reloadApp( gameMemory, gameMemorySize );
 			win32Remap( &remapInfo );
 		}
@@ -686,19 +748,43 @@ int CALLBACK WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdL
 
 		if( isHotkeyPressed( &platformInputs, KC_P, KC_Control ) ) {
 			recordingInputs = !recordingInputs;
+			if( !recordingInputs && recordFilename ) {
+				// only the first recording starts at initialization, so only that one is saved
+				win32SaveInputRecording( recording, recordFilename );
+				recordFilename = nullptr;
+			}
 			if( recordingInputs ) {
 				// we just started recording, initialize
 				recording->count = 0;
-				memcpy( recording->memory, memory, memorySize );
-				recording->memorySize = memorySize;
+				clearMemorySnapshots( &recording->snapshots );
+				recordingInputs = takeMemorySnapshot( &recording->snapshots, 0 );
 			}
 		}
 
 		if( isHotkeyPressed( &platformInputs, KC_O, KC_Control ) && recording->count ) {
 			replayingInputs = !replayingInputs;
 			if( replayingInputs ) {
-				memcpy( memory, recording->memory, memorySize );
-				recording->currentInput = 0;
+				win32ReplayFromSnapshot( recording, &jobWorkers.system, 0 );
+			}
+		}
+		if( replayingInputs ) {
+			// scrub through the replay, jumping back goes to the previous snapshot if we are close
+			// to the start of the current one
+			auto snapshots = &recording->snapshots;
+			if( isHotkeyPressed( &platformInputs, KC_J, KC_Control ) ) {
+				auto index = findMemorySnapshot( snapshots, recording->currentInput - 1 );
+				if( index > 0
+				    && recording->currentInput - snapshots->snapshots[index].tag
+				           < Win32SnapshotInterval / 2 ) {
+					--index;
+				}
+				win32ReplayFromSnapshot( recording, &jobWorkers.system, max( index, 0 ) );
+			}
+			if( isHotkeyPressed( &platformInputs, KC_K, KC_Control ) ) {
+				auto index = findMemorySnapshot( snapshots, recording->currentInput ) + 1;
+				if( index < snapshots->snapshotsCount ) {
+					win32ReplayFromSnapshot( recording, &jobWorkers.system, index );
+				}
 			}
 		}
 
@@ -710,6 +796,19 @@ int CALLBACK WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdL
 
 			float blendFactor = (float)( timing.accumulator / FixedTargetTime );
 
+			if( recordingInputs && recording->count >= Win32MaxRecording ) {
+				LOG( WARNING, "Input recording is full, stopped recording" );
+				recordingInputs = false;
+				if( recordFilename ) {
+					win32SaveInputRecording( recording, recordFilename );
+					recordFilename = nullptr;
+				}
+			}
+			if( recordingInputs && recording->count
+			    && ( recording->count % Win32SnapshotInterval ) == 0 ) {
+				// recording keeps going even if snapshot fails, only scrubbing is affected
+				takeMemorySnapshot( &recording->snapshots, recording->count );
+			}
 			if( recordingInputs ) {
 				auto currentFrame         = &recording->entries[recording->count];
 				currentFrame->inputs      = inputs;
@@ -723,8 +822,7 @@ int CALLBACK WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdL
 			if( replayingInputs ) {
 				if( recording->currentInput >= recording->count ) {
 					// restart
-					memcpy( memory, recording->memory, memorySize );
-					recording->currentInput = 0;
+					win32ReplayFromSnapshot( recording, &jobWorkers.system, 0 );
 				}
 				auto currentFrame  = &recording->entries[recording->currentInput];
 				inputs             = currentFrame->inputs;
@@ -778,6 +876,11 @@ int CALLBACK WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdL
 
 		elapsedTime = endTime - startTime;
 
+		if( auto calibrationTicks = __rdtsc() - calibrationStartTicks ) {
+			info.microsecondsPerTick =
+			    ( endTime - calibrationStartTime ) * 1000.0 / (double)calibrationTicks;
+		}
+
 		info.totalFrameTime = (float)elapsedTime;
 		info.fps = 1000.0f / info.totalFrameTime;
 
@@ -811,6 +914,9 @@ int CALLBACK WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdL
 			maxFps = 0;
 		}
 	}
+	if( recordingInputs && recordFilename ) {
+		win32SaveInputRecording( recording, recordFilename );
+	}
 	ReleaseDC( hwnd, hdc );
 	if( dll.library ) {
 		FreeLibrary( dll.library );
@@ -39,7 +39,7 @@ template<> int16 getAs< int16 >( const JsonValue& value, int16 def ) { return (i
 template<> uint8 getAs< uint8 >( const JsonValue& value, uint8 def ) { return (uint8)value.getUInt( def ); }
 template<> uint16 getAs< uint16 >( const JsonValue& value, uint16 def ) { return (uint16)value.getUInt( def ); }
 
-template< class T, class = std::enable_if< std::is_enum< T >::value >::type >
+template< class T, class = typename std::enable_if< std::is_enum< T >::value >::type >
 void deserialize( const JsonValue& value, T& out )
 {
 	typename std::underlying_type< T >::type temp = {};
@@ -22,6 +22,10 @@
 	#define strrev _strrev
 	#define strnicmp _strnicmp
 #endif
+#if defined( __GLIBC__ )
+	// glibc already declares memrchr
+	#define TMUT_NO_MEMRCHR
+#endif
 #define TMUT_OWN_TYPES
 #define TMUT_SAFE_COUNTOF
 typedef int32 tmut_size_t;
@@ -44,6 +48,10 @@ using utility::median;
 // c++17 for as macro
 #define FOR( x ) for( auto&& x )
 
+// defined in Core/Truncate.h
+template < class ReturnType, class ValueType >
+inline constexpr ReturnType safe_truncate( ValueType val );
+
 template < class T >
 int32 distance( T a, T b )
 {